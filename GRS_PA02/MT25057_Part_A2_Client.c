@@ -17,92 +17,1549 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/uio.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 #include <signal.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <stdint.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VERIFY_X86 1
+#endif
 
 #define DEFAULT_PORT 8082
 #define DEFAULT_HOST "127.0.0.1"
 #define DEFAULT_DURATION 10
 #define DEFAULT_THREADS 1
 #define DEFAULT_MSG_SIZE 1024
+#define CACHE_LINE 64
 #define NUM_FIELDS 8
 
+/* Event-driven mode (-e) */
+#define MAX_EVENTS 256
+#define RECV_BUDGET 16              /* Reads per readable event before yielding */
+#define CONNECT_WINDOW 64           /* Handshakes in flight per thread while connecting */
+#define LOOPBACK_CONNS_PER_SOURCE 16384 /* Connections per 127.0.0.x source address */
+
 /* Global configuration */
 static char g_host[256] = DEFAULT_HOST;
 static int g_port = DEFAULT_PORT;
 static int g_duration = DEFAULT_DURATION;
 static int g_message_size = DEFAULT_MSG_SIZE;
+static int g_request_response = 0;
+static int g_timestamping = 0;
+static int g_framing = 0;
+static int g_fd_passing = 0;     /* -f: map the server's memfd, records carry the messages */
+static int g_interval_ms = 0;         /* 0 = no live reporting */
+static int g_verify = 0;
+static double g_rate = 0;             /* -R: offered requests/s over all threads, 0 = closed loop */
+static int g_poisson = 0;             /* -R rate:poisson: exponential gaps instead of fixed */
+static int g_conns_per_thread = 0;    /* -e: connections per thread, 0 = one blocking socket */
+static double *g_conn_gbps = NULL;    /* -e: per-connection throughput, -1 if never connected */
+
+/* Data direction (-x) */
+#define DIR_DOWN 0      /* Server sends, client receives (default) */
+#define DIR_UP 1        /* Client sends, server receives */
+#define DIR_BOTH 2      /* Both at once on each connection */
+static int g_direction = DIR_DOWN;
+
+/* AF_UNIX transport (-u) */
+static const char *g_unix_path = NULL;     /* NULL = TCP to -h/-p */
+static int g_unix_type = SOCK_STREAM;      /* or SOCK_SEQPACKET */
 static volatile int g_running = 1;
+static volatile int g_reporter_done = 0;
+
+/* Latency histogram: log-bucketed (HDR-style), 32 linear sub-buckets per power of two */
+#define HIST_SUB_BITS 5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max_ns;
+} LatencyHistogram;
+
+/* Bucket index for a value in nanoseconds: one clz, no loops */
+int hist_index(uint64_t v) {
+    if (v < HIST_SUB_COUNT) return (int)v;
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_COUNT + (int)((v >> shift) - HIST_SUB_COUNT);
+}
+
+/* Midpoint of the value range covered by a bucket, in nanoseconds */
+uint64_t hist_value(int index) {
+    if (index < HIST_SUB_COUNT) return index;
+    int shift = index / HIST_SUB_COUNT - 1;
+    uint64_t low = (uint64_t)(index % HIST_SUB_COUNT + HIST_SUB_COUNT) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+/* Record one latency sample given in microseconds */
+void hist_record(LatencyHistogram *h, double latency_us) {
+    uint64_t ns = latency_us > 0 ? (uint64_t)(latency_us * 1e3) : 0;
+    h->counts[hist_index(ns)]++;
+    h->total++;
+    if (ns > h->max_ns) h->max_ns = ns;
+}
+
+/* Add src into dst (called after the threads are joined, so no locking) */
+void hist_merge(LatencyHistogram *dst, const LatencyHistogram *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    if (src->max_ns > dst->max_ns) dst->max_ns = src->max_ns;
+}
+
+/* Latency at percentile p (0-100) in microseconds */
+double hist_percentile(const LatencyHistogram *h, double p) {
+    if (h->total == 0) return 0;
+    
+    uint64_t target = (uint64_t)(p / 100.0 * h->total + 0.5);
+    if (target < 1) target = 1;
+    
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= target) {
+            uint64_t v = hist_value(i);
+            return (v < h->max_ns ? v : h->max_ns) / 1e3;
+        }
+    }
+    return h->max_ns / 1e3;
+}
+
+/* Request/response mode (-r): the client sends this header as its request */
+/* and the server echoes it at the start of the response */
+typedef struct {
+    uint64_t seq;
+    uint64_t send_ts_ns;    /* CLOCK_MONOTONIC time when the request was sent */
+} RequestHeader;
+
+/* Frame header (-F): the server puts one in front of every streamed message */
+#define FRAME_F_ZEROCOPY 0x1    /* Payload was sent with MSG_ZEROCOPY */
+#define FRAME_F_MEMFD 0x4       /* Payload is in the memfd passed with SCM_RIGHTS (-f) */
+typedef struct {
+    uint32_t length;        /* Payload bytes following the header */
+    uint32_t flags;         /* FRAME_F_* */
+    uint64_t seq;           /* Message number on this connection, from 0 */
+    uint64_t send_ts_ns;    /* Sender CLOCK_MONOTONIC time when the send was issued */
+} FrameHeader;
+
+/* Thread statistics structure */
+/* Aligned to a cache line so no two threads' counters share one */
+typedef struct {
+    /* Updated on every message: kept together in the first cache line */
+    unsigned long long bytes_received;
+    unsigned long long messages_received;
+    double latency_sum;
+    unsigned long long latency_count;
+    int thread_id;
+    double elapsed_time;
+    LatencyHistogram hist;      /* Per-message latency distribution */
+    double rx_stage_sum;        /* -T: RX software timestamp to recvmsg() return */
+    unsigned long long rx_stage_count;
+    unsigned long long frames_lost;         /* -F: sequence numbers skipped */
+    unsigned long long frames_reordered;    /* -F: sequence numbers that went backwards */
+    unsigned long long frames_zerocopy;     /* -F: frames the server sent with MSG_ZEROCOPY */
+    unsigned long long verify_bytes;        /* -V: payload bytes checked */
+    unsigned long long verify_corrupt;      /* -V: messages with a wrong byte */
+    double verify_ns;                       /* -V: time spent checking */
+    unsigned long long requests_sent;       /* -R: requests issued on the schedule */
+    unsigned long long requests_unanswered; /* -R: requests still in flight at the end */
+    unsigned long long requests_unsent;     /* -R: requests due before the end but never issued */
+    double send_lag_sum;                    /* -R: us each request left after its scheduled time */
+    double schedule_behind_us;              /* -R: how far the schedule trailed the clock at the end */
+    int conns_open;                         /* -e: connects that completed */
+    int conns_failed;                       /* -e: connects that failed */
+    int conns_dropped;                      /* -e: connections closed before the end */
+    /* -x up/both: upload counters, in their own line since -x both */
+    /* updates them from a second thread */
+    unsigned long long bytes_sent __attribute__((aligned(CACHE_LINE)));
+    unsigned long long messages_sent;
+} __attribute__((aligned(CACHE_LINE))) ThreadStats;
+
+/* Counters the -i reporter reads while the workers run: each has a single */
+/* writer, so a relaxed store of the new value keeps reads untorn without a */
+/* locked add on the receive path */
+static inline void stat_add(unsigned long long *c, unsigned long long n) {
+    __atomic_store_n(c, *c + n, __ATOMIC_RELAXED);
+}
+
+static inline void stat_add_double(double *c, double n) {
+    double v = *c + n;
+    __atomic_store(c, &v, __ATOMIC_RELAXED);
+}
+
+/* Global statistics */
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ThreadStats *g_thread_stats;
+static int g_num_threads;
+
+/* Pre-registered buffer structure */
+typedef struct {
+    char *buffers[NUM_FIELDS];
+    size_t buffer_sizes[NUM_FIELDS];
+    struct iovec iov[NUM_FIELDS];
+} PreRegisteredBuffers;
+
+/* Payload verification (-V): every field of a message is one repeated byte, */
+/* so checking a range is finding where a run of one byte value ends */
+
+/* Length of the run of byte c at the start of p (len if all of it matches) */
+size_t run_length_scalar(const char *p, size_t len, char c) {
+    uint64_t pattern = 0x0101010101010101ULL * (unsigned char)c;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        if (word != pattern) break;
+    }
+    while (i < len && p[i] == c) i++;
+    return i;
+}
+
+#ifdef VERIFY_X86
+/* 16 bytes per compare; SSE2 is part of the x86-64 baseline */
+__attribute__((target("sse2")))
+size_t run_length_sse2(const char *p, size_t len, char c) {
+    __m128i pattern = _mm_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+        if (mask != 0xffffu) return i + __builtin_ctz(~mask);
+    }
+    return i + run_length_scalar(p + i, len - i, c);
+}
+
+/* 64 bytes per iteration: two 32-byte compares folded into one movemask */
+__attribute__((target("avx2")))
+size_t run_length_avx2(const char *p, size_t len, char c) {
+    __m256i pattern = _mm256_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i)), pattern);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + 32)), pattern);
+        if ((unsigned)_mm256_movemask_epi8(_mm256_and_si256(a, b)) != 0xffffffffu) break;
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+        if (mask != 0xffffffffu) return i + __builtin_ctz(~mask);
+    }
+    return i + run_length_sse2(p + i, len - i, c);
+}
+#endif
+
+/* Kernel picked once in main() from the CPU's feature flags */
+static size_t (*g_run_length)(const char*, size_t, char) = run_length_scalar;
+static const char *g_verify_isa = "scalar";
+
+void init_verify(void) {
+#ifdef VERIFY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        g_run_length = run_length_avx2;
+        g_verify_isa = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        g_run_length = run_length_sse2;
+        g_verify_isa = "sse2";
+    }
+#endif
+}
+
+/* Position in the expected byte stream of one connection */
+typedef struct {
+    size_t msg_size;        /* Length of the messages being checked */
+    size_t offset;          /* Bytes of the current message already checked */
+    int rotation;           /* A3 rotates the field bytes with its slot sequence */
+    int bad;                /* Current message already counted as corrupt */
+} PayloadVerifier;
+
+/* Check the next len bytes of a stream of msg_size messages */
+/* Field i of a message (split like the server's, the first msg_size % NUM_FIELDS */
+/* fields one byte longer) must be all 'A' + (i + rotation) % NUM_FIELDS, where */
+/* the rotation is taken from the message's first byte */
+void verify_payload(PayloadVerifier *v, const char *data, size_t len, ThreadStats *stats) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    stats->verify_bytes += len;
+    
+    size_t field_size = v->msg_size / NUM_FIELDS;
+    size_t remainder = v->msg_size % NUM_FIELDS;
+    size_t long_span = remainder * (field_size + 1);
+    while (len > 0) {
+        if (v->offset == 0) {
+            v->rotation = (unsigned char)(data[0] - 'A') % NUM_FIELDS;
+            v->bad = 0;
+        }
+        
+        int field;
+        size_t field_end;
+        if (v->offset < long_span) {
+            field = v->offset / (field_size + 1);
+            field_end = (field + 1) * (field_size + 1);
+        } else {
+            field = remainder + (v->offset - long_span) / field_size;
+            field_end = long_span + (field - remainder + 1) * field_size;
+        }
+        
+        size_t n = field_end - v->offset < len ? field_end - v->offset : len;
+        char expected = 'A' + (field + v->rotation) % NUM_FIELDS;
+        size_t run = g_run_length(data, n, expected);
+        if (run < n && !v->bad) {
+            v->bad = 1;
+            if (stats->verify_corrupt++ == 0) {
+                fprintf(stderr, "[Thread %d] Corrupt payload: byte %zu of a %zu byte message "
+                        "(field %d) is 0x%02x, expected '%c'\n",
+                        stats->thread_id, v->offset + run, v->msg_size, field,
+                        (unsigned char)data[run], expected);
+            }
+        }
+        
+        data += n;
+        len -= n;
+        v->offset += n;
+        if (v->offset == v->msg_size) v->offset = 0;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stats->verify_ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+}
+
+/* Thread placement (-c / -P / -N) */
+#define PLACE_NONE 0
+#define PLACE_LIST 1        /* CPUs in the order given with -c */
+#define PLACE_SPREAD 2      /* One CPU per physical core before any SMT sibling */
+#define PLACE_PACK 3        /* Fill the SMT siblings of a core before the next core */
+#define MEM_ANY 0
+#define MEM_SAME 1          /* Buffers on the NUMA node of the thread's CPU */
+#define MEM_CROSS 2         /* Buffers on the next NUMA node, across the interconnect */
+#define MAX_NODES 64
+
+static int g_place_policy = PLACE_NONE;
+static int g_mem_policy = MEM_ANY;
+static int g_cpus[CPU_SETSIZE];     /* CPUs in placement order, used round-robin */
+static int g_cpu_count = 0;
+static int g_node_count = 1;
+static char g_placement[64] = "none";
+
+/* Parse a CPU list such as "0-3,8,10-11", returns the number of CPUs or -1 */
+int parse_cpu_list(const char *list, int *cpus, int max) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return -1;
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && count < max; c++) {
+            cpus[count++] = (int)c;
+        }
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+        else break;
+    }
+    return count;
+}
+
+/* Lowest-numbered SMT sibling of a CPU, identifying its physical core */
+int core_of_cpu(int cpu) {
+    char path[128], line[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return cpu;
+    int siblings[CPU_SETSIZE];
+    int n = fgets(line, sizeof(line), f) ? parse_cpu_list(line, siblings, CPU_SETSIZE) : -1;
+    fclose(f);
+    return n > 0 ? siblings[0] : cpu;
+}
+
+/* NUMA node a CPU belongs to (0 if the topology is not exported) */
+int node_of_cpu(int cpu) {
+    char path[128];
+    for (int node = 0; node < g_node_count; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+    return 0;
+}
+
+/* Build the CPU order from -c / -P and count NUMA nodes */
+int setup_placement(const char *cpu_list) {
+    char path[64];
+    g_node_count = 0;
+    while (g_node_count < MAX_NODES) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", g_node_count);
+        if (access(path, F_OK) != 0) break;
+        g_node_count++;
+    }
+    if (g_node_count == 0) g_node_count = 1;
+    
+    if (cpu_list) {
+        g_cpu_count = parse_cpu_list(cpu_list, g_cpus, CPU_SETSIZE);
+        if (g_cpu_count <= 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+            return -1;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    } else if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        /* Default to every CPU this process may run on */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) g_cpus[g_cpu_count++] = c;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    }
+    
+    if (g_place_policy == PLACE_SPREAD || g_place_policy == PLACE_PACK) {
+        /* Sort key: spread = (sibling rank, core), pack = (core, sibling rank) */
+        int core[CPU_SETSIZE], rank[CPU_SETSIZE];
+        for (int i = 0; i < g_cpu_count; i++) {
+            core[i] = core_of_cpu(g_cpus[i]);
+            rank[i] = 0;
+            for (int j = 0; j < i; j++) {
+                if (core[j] == core[i]) rank[i]++;
+            }
+        }
+        for (int i = 1; i < g_cpu_count; i++) {
+            for (int j = i; j > 0; j--) {
+                int a = j - 1, b = j;
+                int swap = g_place_policy == PLACE_SPREAD ?
+                    (rank[a] > rank[b] || (rank[a] == rank[b] && core[a] > core[b])) :
+                    (core[a] > core[b] || (core[a] == core[b] && rank[a] > rank[b]));
+                if (!swap) break;
+                int t;
+                t = g_cpus[a]; g_cpus[a] = g_cpus[b]; g_cpus[b] = t;
+                t = core[a]; core[a] = core[b]; core[b] = t;
+                t = rank[a]; rank[a] = rank[b]; rank[b] = t;
+            }
+        }
+    }
+    
+    if (g_mem_policy == MEM_CROSS && g_node_count < 2) {
+        fprintf(stderr, "Warning: only one NUMA node, -N cross places memory on the same node\n");
+    }
+    
+    static const char *place_names[] = { "none", "list", "spread", "pack" };
+    static const char *mem_names[] = { "any", "same", "cross" };
+    if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        snprintf(g_placement, sizeof(g_placement), "%s-%s",
+                 place_names[g_place_policy], mem_names[g_mem_policy]);
+    }
+    return 0;
+}
+
+/* CPU for the index-th thread, or -1 when placement is off */
+int placement_cpu(int index) {
+    return g_cpu_count > 0 ? g_cpus[index % g_cpu_count] : -1;
+}
+
+/* Prefer the -N node of a CPU for this thread's future page faults (-1 resets) */
+void bind_memory(int cpu) {
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+    memset(mask, 0, sizeof(mask));
+    
+    if (cpu < 0 || g_mem_policy == MEM_ANY) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        return;
+    }
+    
+    int node = node_of_cpu(cpu);
+    if (g_mem_policy == MEM_CROSS) node = (node + 1) % g_node_count;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    
+    /* MPOL_PREFERRED rather than BIND so a full node degrades instead of failing */
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0) {
+        perror("set_mempolicy failed");
+    }
+}
+
+/* Pin the calling thread to its CPU and place its allocations (first touch) */
+void place_thread(int index) {
+    int cpu = placement_cpu(index);
+    if (cpu < 0) return;
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Failed to pin thread %d to CPU %d\n", index, cpu);
+    }
+    bind_memory(cpu);
+}
+
+/* Signal handler */
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* Allocate and initialize pre-registered buffers */
+PreRegisteredBuffers* create_buffers(size_t total_size) {
+    PreRegisteredBuffers *pb = (PreRegisteredBuffers*)malloc(sizeof(PreRegisteredBuffers));
+    if (!pb) return NULL;
+    
+    size_t field_size = total_size / NUM_FIELDS;
+    size_t remainder = total_size % NUM_FIELDS;
+    
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        size_t size = field_size + (i < (int)remainder ? 1 : 0);
+        pb->buffer_sizes[i] = size;
+        pb->buffers[i] = (char*)malloc(size);
+        if (!pb->buffers[i]) {
+            for (int j = 0; j < i; j++) {
+                free(pb->buffers[j]);
+            }
+            free(pb);
+            return NULL;
+        }
+        
+        /* Set up iovec to point to pre-registered buffer */
+        pb->iov[i].iov_base = pb->buffers[i];
+        pb->iov[i].iov_len = size;
+    }
+    
+    return pb;
+}
+
+/* Free pre-registered buffers */
+void destroy_buffers(PreRegisteredBuffers *pb) {
+    if (pb) {
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            free(pb->buffers[i]);
+        }
+        free(pb);
+    }
+}
+
+/* Build an iovec view that skips the first offset bytes */
+int iovec_from_offset(const struct iovec *src, int count, size_t offset,
+                      struct iovec *dst) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (offset >= src[i].iov_len) {
+            offset -= src[i].iov_len;
+            continue;
+        }
+        dst[n].iov_base = (char*)src[i].iov_base + offset;
+        dst[n].iov_len = src[i].iov_len - offset;
+        offset = 0;
+        n++;
+    }
+    return n;
+}
+
+/* Enable RX software timestamps on a connected socket (-T) */
+int enable_rx_timestamps(int fd) {
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+/* Charge the kernel->user stage: RX software timestamp to recvmsg() return */
+void account_rx_timestamp(struct msghdr *mh, ThreadStats *stats) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(mh); cm; cm = CMSG_NXTHDR(mh, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+            struct scm_timestamping *tss = (struct scm_timestamping*)CMSG_DATA(cm);
+            if (tss->ts[0].tv_sec != 0) {
+                stats->rx_stage_sum += (now.tv_sec - tss->ts[0].tv_sec) * 1e6 +
+                                       (now.tv_nsec - tss->ts[0].tv_nsec) / 1e3;
+                stats->rx_stage_count++;
+            }
+        }
+    }
+}
+
+/* xorshift64* mapped to a double in (0, 1), for Poisson gaps (-R rate:poisson) */
+double rng_uniform(uint64_t *s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return (((*s * 0x2545F4914F6CDD1DULL) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* Gap to the next scheduled request (-R): fixed, or exponential with -R rate:poisson */
+double next_gap(uint64_t *rng, double gap_ns) {
+    return g_poisson ? -log(rng_uniform(rng)) * gap_ns : gap_ns;
+}
+
+/* Charge a request that got no response the time it had waited by the end */
+void record_unanswered(ThreadStats *stats, double wait_us) {
+    stat_add_double(&stats->latency_sum, wait_us);
+    stat_add(&stats->latency_count, 1);
+    hist_record(&stats->hist, wait_us);
+}
+
+/* Request/response loop for -r: send a timestamped request, wait for the */
+/* echoed response and record the true round-trip time */
+void run_request_response(int sockfd, ThreadStats *stats, struct timespec *start) {
+    size_t response_size = sizeof(RequestHeader) + g_message_size;
+    PreRegisteredBuffers *pb = create_buffers(g_message_size);
+    if (!pb) {
+        perror("Failed to allocate buffers");
+        return;
+    }
+    
+    /* Echoed header lands in its own iovec, fields in the pre-registered buffers */
+    RequestHeader resp_header;
+    RequestHeader *resp = &resp_header;
+    struct iovec rr_iov[NUM_FIELDS + 1];
+    struct iovec iov[NUM_FIELDS + 1];
+    rr_iov[0].iov_base = resp;
+    rr_iov[0].iov_len = sizeof(RequestHeader);
+    memcpy(&rr_iov[1], pb->iov, NUM_FIELDS * sizeof(struct iovec));
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    
+    uint64_t seq = 0;
+    struct timespec now;
+    while (g_running) {
+        RequestHeader req;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        req.seq = seq++;
+        req.send_ts_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+        if (send(sockfd, &req, sizeof(req), 0) != (ssize_t)sizeof(req)) {
+            if (g_running) perror("request send error");
+            break;
+        }
+        
+        size_t got = 0;
+        while (got < response_size) {
+            mh.msg_iovlen = iovec_from_offset(rr_iov, NUM_FIELDS + 1, got, iov);
+            ssize_t received = recvmsg(sockfd, &mh, 0);
+            if (received <= 0) {
+                if (received < 0 && errno == EINTR) continue;
+                break;
+            }
+            got += received;
+        }
+        if (got < response_size) {
+            if (g_running) perror("response recvmsg error");
+            break;
+        }
+        
+        if (resp->seq != req.seq) {
+            fprintf(stderr, "[Thread %d] Response out of sequence: expected %llu, got %llu\n",
+                    stats->thread_id, (unsigned long long)req.seq,
+                    (unsigned long long)resp->seq);
+            break;
+        }
+        
+        if (g_verify) {
+            /* The field buffers line up with the server's fields */
+            PayloadVerifier verifier = { g_message_size, 0, 0, 0 };
+            for (int i = 0; i < NUM_FIELDS; i++) {
+                verify_payload(&verifier, pb->buffers[i], pb->buffer_sizes[i], stats);
+            }
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+        double latency = (now_ns - resp->send_ts_ns) / 1e3;
+        
+        stat_add(&stats->bytes_received, response_size);
+        stat_add(&stats->messages_received, 1);
+        stat_add_double(&stats->latency_sum, latency);
+        stat_add(&stats->latency_count, 1);
+        hist_record(&stats->hist, latency);
+        
+        /* Check duration */
+        double elapsed = (now.tv_sec - start->tv_sec) +
+                        (now.tv_nsec - start->tv_nsec) / 1e9;
+        if (elapsed >= g_duration) {
+            break;
+        }
+    }
+    
+    destroy_buffers(pb);
+}
+
+/* Open-loop load (-R): requests leave on a fixed-rate or Poisson schedule */
+/* whether or not earlier responses have arrived. Each request carries its */
+/* scheduled time, so a stall is charged to every request queued behind it */
+/* rather than hidden by the sender waiting (coordinated omission) */
+void run_open_loop(int sockfd, ThreadStats *stats, struct timespec *start) {
+    size_t response_size = sizeof(RequestHeader) + g_message_size;
+    PreRegisteredBuffers *pb = create_buffers(g_message_size);
+    if (!pb) {
+        perror("Failed to allocate buffers");
+        return;
+    }
+    
+    /* Echoed header lands in its own iovec, fields in the pre-registered buffers */
+    RequestHeader resp_header;
+    RequestHeader *resp = &resp_header;
+    struct iovec rr_iov[NUM_FIELDS + 1];
+    struct iovec iov[NUM_FIELDS + 1];
+    rr_iov[0].iov_base = resp;
+    rr_iov[0].iov_len = sizeof(RequestHeader);
+    memcpy(&rr_iov[1], pb->iov, NUM_FIELDS * sizeof(struct iovec));
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    
+    /* Sleeps end on the schedule, not up to 50 us later */
+    prctl(PR_SET_TIMERSLACK, 1UL);
+    
+    double gap_ns = 1e9 * g_num_threads / g_rate;     /* Mean gap on this connection */
+    uint64_t rng = 0x9E3779B97F4A7C15ULL * (stats->thread_id + 1);
+    uint64_t start_ns = (uint64_t)start->tv_sec * 1000000000ULL + start->tv_nsec;
+    uint64_t end_ns = start_ns + (uint64_t)g_duration * 1000000000ULL;
+    double next_ns = start_ns;     /* Scheduled time of the next request */
+    
+    /* The same schedule replayed one response behind: at the end it */
+    /* regenerates the scheduled time of every request still unanswered */
+    uint64_t replay_rng = rng;
+    double replay_ns = start_ns;
+    
+    RequestHeader req;
+    size_t req_sent = sizeof(req);  /* Bytes of req already sent; all of it = none pending */
+    uint64_t seq = 0, expected = 0;
+    size_t got = 0;                 /* Bytes of the current response received */
+    struct timespec now;
+    while (g_running) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+        if (now_ns >= end_ns) break;
+        
+        /* Issue every request that is due. A full socket buffer leaves the */
+        /* rest due, to go out with their original times once there is room */
+        int failed = 0;
+        while (1) {
+            if (req_sent == sizeof(req)) {
+                if ((uint64_t)next_ns > now_ns) break;
+                req.seq = seq++;
+                req.send_ts_ns = (uint64_t)next_ns;
+                req_sent = 0;
+                stats->requests_sent++;
+                stats->send_lag_sum += (now_ns - req.send_ts_ns) / 1e3;
+                next_ns += next_gap(&rng, gap_ns);
+            }
+            ssize_t n = send(sockfd, (char*)&req + req_sent, sizeof(req) - req_sent,
+                             MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (g_running) perror("request send error");
+                failed = 1;
+                break;
+            }
+            req_sent += n;
+        }
+        if (failed) break;
+        
+        /* One response per recvmsg(), resuming at its byte offset in the iovec */
+        mh.msg_iovlen = iovec_from_offset(rr_iov, NUM_FIELDS + 1, got, iov);
+        ssize_t received = recvmsg(sockfd, &mh, MSG_DONTWAIT);
+        if (received > 0) {
+            got += received;
+            if (got < response_size) continue;
+            got = 0;
+            
+            if (resp->seq != expected) {
+                fprintf(stderr, "[Thread %d] Response out of sequence: expected %llu, got %llu\n",
+                        stats->thread_id, (unsigned long long)expected,
+                        (unsigned long long)resp->seq);
+                break;
+            }
+            expected++;
+            replay_ns += next_gap(&replay_rng, gap_ns);
+            
+            if (g_verify) {
+                /* The field buffers line up with the server's fields */
+                PayloadVerifier verifier = { g_message_size, 0, 0, 0 };
+                for (int i = 0; i < NUM_FIELDS; i++) {
+                    verify_payload(&verifier, pb->buffers[i], pb->buffer_sizes[i], stats);
+                }
+            }
+            
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            now_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+            double latency = (now_ns - resp->send_ts_ns) / 1e3;
+            
+            stat_add(&stats->bytes_received, response_size);
+            stat_add(&stats->messages_received, 1);
+            stat_add_double(&stats->latency_sum, latency);
+            stat_add(&stats->latency_count, 1);
+            hist_record(&stats->hist, latency);
+            continue;
+        }
+        if (received == 0) {
+            if (g_running) fprintf(stderr, "[Thread %d] Server closed the connection\n", stats->thread_id);
+            break;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            if (g_running) perror("response recv error");
+            break;
+        }
+        
+        /* Nothing to do: sleep until the next request is due, a response */
+        /* arrives or a stuck request can be sent */
+        struct pollfd pfd = { sockfd, POLLIN, 0 };
+        uint64_t wake_ns = end_ns;
+        if (req_sent < sizeof(req)) {
+            pfd.events |= POLLOUT;
+        } else if ((uint64_t)next_ns < wake_ns) {
+            wake_ns = (uint64_t)next_ns;
+        }
+        struct timespec timeout;
+        timeout.tv_sec = (wake_ns - now_ns) / 1000000000ULL;
+        timeout.tv_nsec = (wake_ns - now_ns) % 1000000000ULL;
+        ppoll(&pfd, 1, &timeout, NULL);
+    }
+    
+    /* Responses never seen and requests that never made it out are the */
+    /* tail an overloaded server leaves. Each goes into the latency figures */
+    /* at the time it had waited by the end, instead of being dropped */
+    stats->requests_unanswered = seq - expected;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t stop_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    if (stop_ns > end_ns) stop_ns = end_ns;
+    if (next_ns < stop_ns) stats->schedule_behind_us = (stop_ns - next_ns) / 1e3;
+    for (uint64_t k = expected; k < seq; k++) {
+        record_unanswered(stats, (stop_ns - replay_ns) / 1e3);
+        replay_ns += next_gap(&replay_rng, gap_ns);
+    }
+    for (; next_ns < stop_ns; next_ns += next_gap(&rng, gap_ns)) {
+        record_unanswered(stats, (stop_ns - next_ns) / 1e3);
+        stats->requests_unsent++;
+    }
+    
+    destroy_buffers(pb);
+}
+
+/* Split complete frames off the front of buf and account them */
+/* Returns bytes consumed (a partial frame is left for the next read), or -1 on a bad header */
+ssize_t parse_frames(const char *buf, size_t len, uint64_t *expected, ThreadStats *stats) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    
+    size_t pos = 0;
+    while (len - pos >= sizeof(FrameHeader)) {
+        /* Frames start at any byte offset, so copy the header out before reading it */
+        FrameHeader hdr;
+        memcpy(&hdr, buf + pos, sizeof(hdr));
+        if (hdr.length > (uint32_t)g_message_size) {
+            fprintf(stderr, "[Thread %d] Frame of %u bytes exceeds -s %d "
+                    "(server -s or -D larger than the client's?)\n",
+                    stats->thread_id, hdr.length, g_message_size);
+            return -1;
+        }
+        if (len - pos < sizeof(hdr) + hdr.length) break;
+        
+        if (g_verify) {
+            PayloadVerifier verifier = { hdr.length, 0, 0, 0 };
+            verify_payload(&verifier, buf + pos + sizeof(hdr), hdr.length, stats);
+        }
+        
+        /* Sequence numbers count messages per connection: a jump is loss, a step back reordering */
+        if (hdr.seq < *expected) {
+            stats->frames_reordered++;
+        } else {
+            stats->frames_lost += hdr.seq - *expected;
+            *expected = hdr.seq + 1;
+        }
+        if (hdr.flags & FRAME_F_ZEROCOPY) stats->frames_zerocopy++;
+        
+        /* One-way latency: both ends read CLOCK_MONOTONIC on the same host */
+        double latency = ((int64_t)(now_ns - hdr.send_ts_ns)) / 1e3;
+        stat_add(&stats->messages_received, 1);
+        stat_add_double(&stats->latency_sum, latency);
+        stat_add(&stats->latency_count, 1);
+        hist_record(&stats->hist, latency);
+        
+        pos += sizeof(hdr) + hdr.length;
+    }
+    return pos;
+}
+
+/* Framed streaming loop for -F: read the stream in large chunks and count */
+/* the messages the server framed, however recv() happens to split them */
+void run_framed(int sockfd, ThreadStats *stats, struct timespec *start) {
+    size_t frame_max = sizeof(FrameHeader) + g_message_size;
+    size_t buffer_size = frame_max * 4;
+    if (buffer_size < 256 * 1024) buffer_size = 256 * 1024;
+    char *buffer = (char*)malloc(buffer_size);
+    if (!buffer) {
+        perror("Failed to allocate frame buffer");
+        return;
+    }
+    
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    
+    size_t filled = 0;
+    uint64_t expected = 0;
+    struct timespec now;
+    while (g_running) {
+        /* One flat iovec: frame boundaries don't line up with the field buffers */
+        struct iovec iov = { buffer + filled, buffer_size - filled };
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        if (g_timestamping) {
+            mh.msg_control = control;
+            mh.msg_controllen = sizeof(control);
+        }
+        ssize_t received = recvmsg(sockfd, &mh, 0);
+        if (received > 0 && g_timestamping) account_rx_timestamp(&mh, stats);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) continue;
+            if (received < 0) perror("recv error");
+            break;
+        }
+        stat_add(&stats->bytes_received, received);
+        filled += received;
+        
+        ssize_t consumed = parse_frames(buffer, filled, &expected, stats);
+        if (consumed < 0) break;
+        
+        /* Move the partial frame at the end to the front for the next read */
+        filled -= consumed;
+        if (consumed > 0 && filled > 0) memmove(buffer, buffer + consumed, filled);
+        
+        /* Check duration */
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (now.tv_sec - start->tv_sec) +
+                        (now.tv_nsec - start->tv_nsec) / 1e9;
+        if (elapsed >= g_duration) {
+            break;
+        }
+    }
+    
+    free(buffer);
+}
+
+/* Read one fd-passing record (-f): a FrameHeader, the first one carrying the */
+/* server's memfd in SCM_RIGHTS. Returns 1, 0 on EOF or -1 on error */
+int recv_fd_record(int sockfd, FrameHeader *hdr, int *memfd) {
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    size_t got = 0;
+    while (got < sizeof(*hdr)) {
+        struct iovec iov = { (char*)hdr + got, sizeof(*hdr) - got };
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        mh.msg_control = control.buf;
+        mh.msg_controllen = sizeof(control.buf);
+        
+        ssize_t n = recvmsg(sockfd, &mh, MSG_CMSG_CLOEXEC);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) perror("recvmsg error");
+            return n < 0 ? -1 : 0;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cm), sizeof(fd));
+                if (*memfd < 0) *memfd = fd;
+                else close(fd);
+            }
+        }
+        got += n;
+    }
+    return 1;
+}
+
+/* Fd-passing loop for -f: map the memfd the server passed once, then copy the */
+/* message out of the mapping for every record, the way recv() would deliver it */
+void run_fd_passing(int sockfd, ThreadStats *stats, struct timespec *start) {
+    char *buffer = (char*)malloc(g_message_size);
+    if (!buffer) {
+        perror("Failed to allocate buffer");
+        return;
+    }
+    
+    int memfd = -1;
+    char *map = NULL;
+    size_t map_size = 0;
+    uint64_t expected = 0;
+    struct timespec now;
+    while (g_running) {
+        FrameHeader hdr;
+        if (recv_fd_record(sockfd, &hdr, &memfd) <= 0) break;
+        
+        if (!map && memfd >= 0) {
+            struct stat st;
+            if (fstat(memfd, &st) < 0 || st.st_size == 0) {
+                perror("memfd fstat failed");
+                break;
+            }
+            /* Only a sealed memfd is safe to trust: the server can't shrink or rewrite it */
+            int seals = fcntl(memfd, F_GET_SEALS);
+            if (seals < 0 || !(seals & F_SEAL_SHRINK) || !(seals & F_SEAL_WRITE)) {
+                fprintf(stderr, "[Thread %d] Passed memfd is not sealed\n", stats->thread_id);
+                break;
+            }
+            map_size = st.st_size;
+            map = (char*)mmap(NULL, map_size, PROT_READ, MAP_SHARED, memfd, 0);
+            if (map == MAP_FAILED) {
+                perror("memfd mmap failed");
+                map = NULL;
+                break;
+            }
+        }
+        if (!map || !(hdr.flags & FRAME_F_MEMFD) || hdr.length > map_size ||
+            hdr.length > (uint32_t)g_message_size) {
+            fprintf(stderr, "[Thread %d] Bad fd-passing record (server -f and -s no larger than the client's?)\n",
+                    stats->thread_id);
+            break;
+        }
+        
+        /* Consume the message: one copy out of the shared pages */
+        memcpy(buffer, map, hdr.length);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+        stat_add(&stats->bytes_received, hdr.length);
+        
+        if (g_verify) {
+            PayloadVerifier verifier = { hdr.length, 0, 0, 0 };
+            verify_payload(&verifier, buffer, hdr.length, stats);
+        }
+        
+        if (hdr.seq < expected) {
+            stats->frames_reordered++;
+        } else {
+            stats->frames_lost += hdr.seq - expected;
+            expected = hdr.seq + 1;
+        }
+        
+        /* One-way latency from the record's send timestamp to the copied message */
+        double latency = ((int64_t)(now_ns - hdr.send_ts_ns)) / 1e3;
+        stat_add(&stats->messages_received, 1);
+        stat_add_double(&stats->latency_sum, latency);
+        stat_add(&stats->latency_count, 1);
+        hist_record(&stats->hist, latency);
+        
+        /* Check duration */
+        double elapsed = (now.tv_sec - start->tv_sec) +
+                        (now.tv_nsec - start->tv_nsec) / 1e9;
+        if (elapsed >= g_duration) {
+            break;
+        }
+    }
+    
+    if (map) munmap(map, map_size);
+    if (memfd >= 0) close(memfd);
+    free(buffer);
+}
+
+/* Upload loop (-x up/both): stream -s byte messages to the server with sendmsg() */
+/* With -x up latency is the time to hand a message to the kernel; with -x both */
+/* the receiving thread owns the latency figures and this one only counts bytes */
+void run_upload(int sockfd, ThreadStats *stats, struct timespec *start) {
+    PreRegisteredBuffers *pb = create_buffers(g_message_size);
+    if (!pb) {
+        perror("Failed to allocate upload buffers");
+        return;
+    }
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        memset(pb->buffers[i], 'A' + i, pb->buffer_sizes[i]);
+    }
+    
+    /* Gathered from the field buffers, resuming at the offset after a short send */
+    struct iovec iov[NUM_FIELDS];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    
+    int record_latency = g_direction == DIR_UP;
+    struct timespec msg_start, now;
+    while (g_running) {
+        clock_gettime(CLOCK_MONOTONIC, &msg_start);
+        
+        size_t sent = 0;
+        while (sent < (size_t)g_message_size) {
+            mh.msg_iovlen = iovec_from_offset(pb->iov, NUM_FIELDS, sent, iov);
+            ssize_t n = sendmsg(sockfd, &mh, MSG_NOSIGNAL);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && errno != EPIPE && errno != ECONNRESET) perror("upload sendmsg error");
+                break;
+            }
+            sent += n;
+        }
+        if (sent < (size_t)g_message_size) {
+            stat_add(&stats->bytes_sent, sent);
+            break;
+        }
+        
+        stat_add(&stats->bytes_sent, sent);
+        stat_add(&stats->messages_sent, 1);
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (record_latency) {
+            double latency = (now.tv_sec - msg_start.tv_sec) * 1e6 +
+                           (now.tv_nsec - msg_start.tv_nsec) / 1e3;
+            stat_add_double(&stats->latency_sum, latency);
+            stat_add(&stats->latency_count, 1);
+            hist_record(&stats->hist, latency);
+        }
+        
+        /* Check duration */
+        double elapsed = (now.tv_sec - start->tv_sec) +
+                        (now.tv_nsec - start->tv_nsec) / 1e9;
+        if (elapsed >= g_duration) {
+            break;
+        }
+    }
+    
+    destroy_buffers(pb);
+}
+
+/* Uploading thread for -x both */
+typedef struct {
+    int sockfd;
+    ThreadStats *stats;
+    struct timespec *start;
+} UploadArg;
+
+void* upload_thread(void *arg) {
+    UploadArg *ua = (UploadArg*)arg;
+    run_upload(ua->sockfd, ua->stats, ua->start);
+    return NULL;
+}
+
+/* Live reporter (-i): snapshot every thread's counters each interval and print the delta */
+/* Counters are only read here, so the receive loops stay lock-free */
+void* reporter_thread(void *arg) {
+    (void)arg;
+    struct timespec interval = { g_interval_ms / 1000, (g_interval_ms % 1000) * 1000000L };
+    struct timespec start, last, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    last = start;
+    unsigned long long last_bytes = 0, last_msgs = 0, last_lat_count = 0;
+    double last_lat_sum = 0;
+    
+    while (!g_reporter_done) {
+        nanosleep(&interval, NULL);
+        
+        unsigned long long bytes = 0, msgs = 0, lat_count = 0;
+        double lat_sum = 0;
+        for (int i = 0; i < g_num_threads; i++) {
+            ThreadStats *s = &g_thread_stats[i];
+            bytes += __atomic_load_n(&s->bytes_received, __ATOMIC_RELAXED);
+            bytes += __atomic_load_n(&s->bytes_sent, __ATOMIC_RELAXED);
+            msgs += __atomic_load_n(&s->messages_received, __ATOMIC_RELAXED);
+            msgs += __atomic_load_n(&s->messages_sent, __ATOMIC_RELAXED);
+            lat_count += __atomic_load_n(&s->latency_count, __ATOMIC_RELAXED);
+            double sum;
+            __atomic_load(&s->latency_sum, &sum, __ATOMIC_RELAXED);
+            lat_sum += sum;
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double dt = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9;
+        double t = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+        double avg_latency = lat_count > last_lat_count ?
+            (lat_sum - last_lat_sum) / (lat_count - last_lat_count) : 0;
+        printf("[%7.2fs] %.4f Gbps, %.0f msg/s, avg latency %.2f us\n",
+               t, (bytes - last_bytes) * 8.0 / (dt * 1e9), (msgs - last_msgs) / dt, avg_latency);
+        fflush(stdout);
+        
+        last = now;
+        last_bytes = bytes;
+        last_msgs = msgs;
+        last_lat_count = lat_count;
+        last_lat_sum = lat_sum;
+    }
+    
+    return NULL;
+}
 
-/* Thread statistics structure */
+/* Connect to the server over TCP, or to its AF_UNIX socket with -u */
+/* Returns the connected socket or -1 */
+int connect_server(void) {
+    /* Create socket */
+    int sockfd = socket(g_unix_path ? AF_UNIX : AF_INET, g_unix_path ? g_unix_type : SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        perror("socket creation failed");
+        return -1;
+    }
+    
+    if (g_unix_path) {
+        struct sockaddr_un unix_addr;
+        memset(&unix_addr, 0, sizeof(unix_addr));
+        unix_addr.sun_family = AF_UNIX;
+        strncpy(unix_addr.sun_path, g_unix_path, sizeof(unix_addr.sun_path) - 1);
+        if (connect(sockfd, (struct sockaddr*)&unix_addr, sizeof(unix_addr)) < 0) {
+            perror("Connection failed");
+            close(sockfd);
+            return -1;
+        }
+        return sockfd;
+    }
+    
+    /* Set TCP_NODELAY */
+    int flag = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    
+    /* Connect to server */
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(g_port);
+    
+    if (inet_pton(AF_INET, g_host, &server_addr.sin_addr) <= 0) {
+        perror("Invalid address");
+        close(sockfd);
+        return -1;
+    }
+    
+    if (connect(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("Connection failed");
+        close(sockfd);
+        return -1;
+    }
+    
+    return sockfd;
+}
+
+/* Event-driven mode (-e): one of the many connections a thread drives */
 typedef struct {
-    int thread_id;
-    unsigned long long bytes_received;
-    unsigned long long messages_received;
-    double elapsed_time;
-    double latency_sum;
-    unsigned long long latency_count;
-} ThreadStats;
+    int fd;                     /* -1 when not connected */
+    int opened;                 /* Connect completed */
+    size_t got;                 /* Bytes of the current message received */
+    uint64_t msg_start_ns;      /* End of the previous message on this connection */
+    unsigned long long bytes;
+    PayloadVerifier verifier;
+} EventConn;
 
-/* Global statistics */
-static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
-static ThreadStats *g_thread_stats;
-static int g_num_threads;
+/* -e: threads wait here with their connections open, so the measured */
+/* interval only starts once the whole connection count is established */
+static pthread_mutex_t g_gate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_gate_cond = PTHREAD_COND_INITIALIZER;
+static int g_gate_arrived = 0;
+static int g_gate_open = 0;
 
-/* Pre-registered buffer structure */
-typedef struct {
-    char *buffers[NUM_FIELDS];
-    size_t buffer_sizes[NUM_FIELDS];
-    struct iovec iov[NUM_FIELDS];
-} PreRegisteredBuffers;
+void wait_at_connect_gate(void) {
+    pthread_mutex_lock(&g_gate_mutex);
+    g_gate_arrived++;
+    pthread_cond_broadcast(&g_gate_cond);
+    while (!g_gate_open) pthread_cond_wait(&g_gate_cond, &g_gate_mutex);
+    pthread_mutex_unlock(&g_gate_mutex);
+}
 
-/* Signal handler */
-void signal_handler(int sig) {
-    (void)sig;
-    g_running = 0;
+/* Main thread: release the client threads once all of them have connected */
+void open_connect_gate(int threads) {
+    pthread_mutex_lock(&g_gate_mutex);
+    while (g_gate_arrived < threads) pthread_cond_wait(&g_gate_cond, &g_gate_mutex);
+    g_gate_open = 1;
+    pthread_cond_broadcast(&g_gate_cond);
+    pthread_mutex_unlock(&g_gate_mutex);
 }
 
-/* Allocate and initialize pre-registered buffers */
-PreRegisteredBuffers* create_buffers(size_t total_size) {
-    PreRegisteredBuffers *pb = (PreRegisteredBuffers*)malloc(sizeof(PreRegisteredBuffers));
-    if (!pb) return NULL;
+/* Raise the open file limit so event-driven mode can hold thousands of sockets */
+void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            perror("setrlimit RLIMIT_NOFILE failed");
+        }
+    }
+}
+
+/* Count a failed -e connect; only the first failure per thread is printed */
+void connect_failed(ThreadStats *stats, int index, int err) {
+    if (stats->conns_failed++ == 0) {
+        fprintf(stderr, "[Thread %d] Connection %d failed: %s%s\n",
+                stats->thread_id, index, strerror(err),
+                err == EMFILE ? " (open file limit)" :
+                err == EADDRNOTAVAIL ? " (out of local ports)" : "");
+    }
+}
+
+/* Start a non-blocking connect for -e; epoll reports the socket writable */
+/* once the handshake is done. Returns 0 or an errno value */
+int start_connect(EventConn *c, int epoll_fd, struct sockaddr_in *addr, int index) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) return errno;
     
-    size_t field_size = total_size / NUM_FIELDS;
-    size_t remainder = total_size % NUM_FIELDS;
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
     
-    for (int i = 0; i < NUM_FIELDS; i++) {
-        size_t size = field_size + (i < (int)remainder ? 1 : 0);
-        pb->buffer_sizes[i] = size;
-        pb->buffers[i] = (char*)malloc(size);
-        if (!pb->buffers[i]) {
-            for (int j = 0; j < i; j++) {
-                free(pb->buffers[j]);
+    /* Loopback has one source address with ~28k ephemeral ports towards a */
+    /* destination, so later connections move on to 127.0.0.2, 127.0.0.3, ... */
+    if ((ntohl(addr->sin_addr.s_addr) >> 24) == 127 && index >= LOOPBACK_CONNS_PER_SOURCE) {
+        struct sockaddr_in src;
+        memset(&src, 0, sizeof(src));
+        src.sin_family = AF_INET;
+        src.sin_addr.s_addr = htonl(INADDR_LOOPBACK + index / LOOPBACK_CONNS_PER_SOURCE);
+        /* Leave the port to connect(), which checks it against the whole 4-tuple */
+        setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &flag, sizeof(flag));
+        if (bind(fd, (struct sockaddr*)&src, sizeof(src)) < 0) {
+            int err = errno;
+            close(fd);
+            return err;
+        }
+    }
+    
+    if (connect(fd, (struct sockaddr*)addr, sizeof(*addr)) < 0 && errno != EINPROGRESS) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.ptr = c;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    
+    c->fd = fd;
+    return 0;
+}
+
+/* Event-driven mode (-e): drive g_conns_per_thread non-blocking connections */
+/* through one epoll set and receive on whichever are readable */
+void run_event_client(ThreadStats *stats) {
+    int count = g_conns_per_thread;
+    int base = stats->thread_id * count;
+    EventConn *conns = (EventConn*)calloc(count, sizeof(EventConn));
+    /* One set of field buffers per thread; a read lands at its */
+    /* connection's offset, so partial messages never mix */
+    PreRegisteredBuffers *pb = create_buffers(g_message_size);
+    struct iovec iov[NUM_FIELDS];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    int epoll_fd = epoll_create1(0);
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_port);
+    
+    if (!conns || !pb || epoll_fd < 0 || inet_pton(AF_INET, g_host, &addr.sin_addr) <= 0) {
+        fprintf(stderr, "[Thread %d] Event-driven client setup failed\n", stats->thread_id);
+        count = 0;      /* Still pass the gate so the other threads can start */
+    }
+    for (int i = 0; i < count; i++) {
+        conns[i].fd = -1;
+        conns[i].verifier.msg_size = g_message_size;
+    }
+    
+    /* Connect with at most CONNECT_WINDOW handshakes in flight, so a burst */
+    /* of SYNs does not overflow the server's accept queue */
+    struct epoll_event events[MAX_EVENTS];
+    int next = 0, connecting = 0;
+    while (g_running && (next < count || connecting > 0)) {
+        while (next < count && connecting < CONNECT_WINDOW) {
+            int err = start_connect(&conns[next], epoll_fd, &addr, base + next);
+            if (err != 0) {
+                connect_failed(stats, next, err);
+            } else {
+                connecting++;
             }
-            free(pb);
-            return NULL;
+            next++;
         }
+        if (connecting == 0) break;
         
-        /* Set up iovec to point to pre-registered buffer */
-        pb->iov[i].iov_base = pb->buffers[i];
-        pb->iov[i].iov_len = size;
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            EventConn *c = (EventConn*)events[i].data.ptr;
+            if (c->opened) continue;    /* Hangup of an idle connection: seen on the first read */
+            connecting--;
+            
+            /* Connected sockets stay disarmed until the gate opens, so the */
+            /* data already arriving on them does not spin this loop */
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) err = errno;
+            if (err == 0) {
+                struct epoll_event ev;
+                ev.events = 0;
+                ev.data.ptr = c;
+                if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) < 0) err = errno;
+            }
+            if (err != 0) {
+                close(c->fd);
+                c->fd = -1;
+                connect_failed(stats, c - conns, err);
+                continue;
+            }
+            c->opened = 1;
+            stats->conns_open++;
+        }
     }
     
-    return pb;
+    printf("[Thread %d] %d of %d connections open\n",
+           stats->thread_id, stats->conns_open, g_conns_per_thread);
+    wait_at_connect_gate();
+    
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t start_ns = (uint64_t)start.tv_sec * 1000000000ULL + start.tv_nsec;
+    for (int i = 0; i < count; i++) {
+        conns[i].msg_start_ns = start_ns;
+        if (conns[i].fd < 0) continue;
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = &conns[i];
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conns[i].fd, &ev);
+    }
+    
+    /* A message's latency is the time since the previous one completed on */
+    /* the same connection, as in the blocking loop */
+    int open = stats->conns_open;
+    while (g_running && open > 0) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            EventConn *c = (EventConn*)events[i].data.ptr;
+            
+            /* Level-triggered: a connection with data left is reported again, */
+            /* so capping the reads per event keeps every connection served */
+            for (int r = 0; r < RECV_BUDGET; r++) {
+                mh.msg_iovlen = iovec_from_offset(pb->iov, NUM_FIELDS, c->got, iov);
+                ssize_t received = recvmsg(c->fd, &mh, 0);
+                if (received < 0 && errno == EINTR) continue;
+                if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                if (received <= 0) {
+                    if (received < 0 && stats->conns_dropped == 0) {
+                        fprintf(stderr, "[Thread %d] Connection %d: %s\n",
+                                stats->thread_id, (int)(c - conns), strerror(errno));
+                    }
+                    close(c->fd);
+                    c->fd = -1;
+                    stats->conns_dropped++;
+                    open--;
+                    break;
+                }
+                
+                if (g_verify) {
+                    /* The bytes just read start at iov[0] */
+                    size_t left = received;
+                    for (size_t k = 0; k < mh.msg_iovlen && left > 0; k++) {
+                        size_t len = iov[k].iov_len < left ? iov[k].iov_len : left;
+                        verify_payload(&c->verifier, (char*)iov[k].iov_base, len, stats);
+                        left -= len;
+                    }
+                }
+                c->got += received;
+                c->bytes += received;
+                stat_add(&stats->bytes_received, received);
+                if (c->got < (size_t)g_message_size) continue;
+                
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+                double latency = (now_ns - c->msg_start_ns) / 1e3;
+                c->msg_start_ns = now_ns;
+                c->got = 0;
+                
+                stat_add(&stats->messages_received, 1);
+                stat_add_double(&stats->latency_sum, latency);
+                stat_add(&stats->latency_count, 1);
+                hist_record(&stats->hist, latency);
+            }
+        }
+        
+        /* Check duration */
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (now.tv_sec - start.tv_sec) +
+                        (now.tv_nsec - start.tv_nsec) / 1e9;
+        if (elapsed >= g_duration) {
+            break;
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    stats->elapsed_time = (now.tv_sec - start.tv_sec) +
+                         (now.tv_nsec - start.tv_nsec) / 1e9;
+    
+    for (int i = 0; i < count; i++) {
+        if (conns[i].opened) {
+            g_conn_gbps[base + i] = conns[i].bytes * 8.0 / (stats->elapsed_time * 1e9);
+        }
+        if (conns[i].fd >= 0) close(conns[i].fd);
+    }
+    
+    if (epoll_fd >= 0) close(epoll_fd);
+    if (pb) destroy_buffers(pb);
+    free(conns);
 }
 
-/* Free pre-registered buffers */
-void destroy_buffers(PreRegisteredBuffers *pb) {
-    if (pb) {
-        for (int i = 0; i < NUM_FIELDS; i++) {
-            free(pb->buffers[i]);
-        }
-        free(pb);
+/* -e: spread of per-connection throughput, which the aggregate can hide: */
+/* min, median and max, and Jain's fairness index (1 = all equal) */
+int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void print_connection_stats(void) {
+    int total = g_num_threads * g_conns_per_thread;
+    double *rates = (double*)malloc(total * sizeof(double));
+    if (!rates) return;
+    
+    int n = 0;
+    double sum = 0, sum_sq = 0;
+    for (int i = 0; i < total; i++) {
+        if (g_conn_gbps[i] < 0) continue;
+        rates[n++] = g_conn_gbps[i];
+        sum += g_conn_gbps[i];
+        sum_sq += g_conn_gbps[i] * g_conn_gbps[i];
+    }
+    
+    if (n > 0) {
+        qsort(rates, n, sizeof(double), compare_double);
+        printf("Per-connection throughput: min %.3f Mbps, p50 %.3f Mbps, max %.3f Mbps, "
+               "Jain fairness %.3f\n",
+               rates[0] * 1e3, rates[n / 2] * 1e3, rates[n - 1] * 1e3,
+               sum_sq > 0 ? sum * sum / (n * sum_sq) : 1.0);
     }
+    free(rates);
 }
 
 /* Client thread function */
@@ -110,43 +1567,79 @@ void* client_thread(void *arg) {
     int thread_id = *(int*)arg;
     free(arg);
     
+    /* Pin before allocating so receive buffers are first touched on the chosen node */
+    place_thread(thread_id);
+    
     ThreadStats *stats = &g_thread_stats[thread_id];
     stats->thread_id = thread_id;
     stats->bytes_received = 0;
     stats->messages_received = 0;
     stats->latency_sum = 0;
     stats->latency_count = 0;
+    memset(&stats->hist, 0, sizeof(stats->hist));
     
-    /* Create socket */
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        perror("socket creation failed");
+    if (g_conns_per_thread > 0) {
+        run_event_client(stats);
         return NULL;
     }
     
-    /* Set TCP_NODELAY */
-    int flag = 1;
-    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    int sockfd = connect_server();
+    if (sockfd < 0) return NULL;
     
-    /* Connect to server */
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(g_port);
+    printf("[Thread %d] Connected to server\n", thread_id);
     
-    if (inet_pton(AF_INET, g_host, &server_addr.sin_addr) <= 0) {
-        perror("Invalid address");
+    if (g_timestamping && enable_rx_timestamps(sockfd) < 0) {
+        perror("SO_TIMESTAMPING failed - continuing without RX timestamps");
+    }
+    
+    /* Upload (-x up): this thread only sends */
+    if (g_direction == DIR_UP) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run_upload(sockfd, stats, &start);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stats->elapsed_time = (end.tv_sec - start.tv_sec) +
+                             (end.tv_nsec - start.tv_nsec) / 1e9;
         close(sockfd);
         return NULL;
     }
     
-    if (connect(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Connection failed");
+    if (g_request_response) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (g_rate > 0) {
+            run_open_loop(sockfd, stats, &start);
+        } else {
+            run_request_response(sockfd, stats, &start);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stats->elapsed_time = (end.tv_sec - start.tv_sec) +
+                             (end.tv_nsec - start.tv_nsec) / 1e9;
         close(sockfd);
         return NULL;
     }
     
-    printf("[Thread %d] Connected to server\n", thread_id);
+    if (g_framing) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run_framed(sockfd, stats, &start);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stats->elapsed_time = (end.tv_sec - start.tv_sec) +
+                             (end.tv_nsec - start.tv_nsec) / 1e9;
+        close(sockfd);
+        return NULL;
+    }
+    
+    if (g_fd_passing) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        run_fd_passing(sockfd, stats, &start);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stats->elapsed_time = (end.tv_sec - start.tv_sec) +
+                             (end.tv_nsec - start.tv_nsec) / 1e9;
+        close(sockfd);
+        return NULL;
+    }
     
     /* Allocate pre-registered buffers */
     PreRegisteredBuffers *pb = create_buffers(g_message_size);
@@ -156,44 +1649,70 @@ void* client_thread(void *arg) {
         return NULL;
     }
     
-    /* Prepare msghdr structure */
+    /* Prepare msghdr structure: a short read resumes at its offset in the buffers */
+    struct iovec iov[NUM_FIELDS];
     struct msghdr mh;
     memset(&mh, 0, sizeof(mh));
-    mh.msg_iov = pb->iov;
-    mh.msg_iovlen = NUM_FIELDS;
+    mh.msg_iov = iov;
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
     
     struct timespec start, end, msg_start, msg_end;
     clock_gettime(CLOCK_MONOTONIC, &start);
     
+    /* Bidirectional (-x both): a second thread uploads while this one receives */
+    UploadArg upload = { sockfd, stats, &start };
+    pthread_t uploader;
+    int uploading = g_direction == DIR_BOTH &&
+                    pthread_create(&uploader, NULL, upload_thread, &upload) == 0;
+    
     /* Receive data for specified duration */
     while (g_running) {
         clock_gettime(CLOCK_MONOTONIC, &msg_start);
         
-        /* Reset iovec lengths before each receive */
-        for (int i = 0; i < NUM_FIELDS; i++) {
-            pb->iov[i].iov_len = pb->buffer_sizes[i];
-        }
-        
-        /* Use recvmsg with scatter-gather I/O */
-        ssize_t received = recvmsg(sockfd, &mh, 0);
-        
-        if (received <= 0) {
-            if (received < 0 && errno != EINTR) {
-                perror("recvmsg error");
+        /* Use recvmsg with scatter-gather I/O until the whole message is in */
+        size_t total_received = 0;
+        while (total_received < (size_t)g_message_size && g_running) {
+            mh.msg_iovlen = iovec_from_offset(pb->iov, NUM_FIELDS, total_received, iov);
+            if (g_timestamping) {
+                mh.msg_control = control;
+                mh.msg_controllen = sizeof(control);
+            }
+            ssize_t received = recvmsg(sockfd, &mh, 0);
+            if (received > 0 && g_timestamping) account_rx_timestamp(&mh, stats);
+            
+            if (received <= 0) {
+                if (received < 0 && errno != EINTR) {
+                    perror("recvmsg error");
+                }
+                g_running = 0;
+                break;
             }
+            total_received += received;
+        }
+        if (total_received < (size_t)g_message_size) {
+            stat_add(&stats->bytes_received, total_received);
             break;
         }
         
         clock_gettime(CLOCK_MONOTONIC, &msg_end);
         
-        stats->bytes_received += received;
-        stats->messages_received++;
+        stat_add(&stats->bytes_received, total_received);
+        stat_add(&stats->messages_received, 1);
+        
+        if (g_verify) {
+            /* The field buffers line up with the server's fields */
+            PayloadVerifier verifier = { g_message_size, 0, 0, 0 };
+            for (int i = 0; i < NUM_FIELDS; i++) {
+                verify_payload(&verifier, pb->buffers[i], pb->buffer_sizes[i], stats);
+            }
+        }
         
         /* Calculate latency for this message */
         double latency = (msg_end.tv_sec - msg_start.tv_sec) * 1e6 +
                        (msg_end.tv_nsec - msg_start.tv_nsec) / 1e3;
-        stats->latency_sum += latency;
-        stats->latency_count++;
+        stat_add_double(&stats->latency_sum, latency);
+        stat_add(&stats->latency_count, 1);
+        hist_record(&stats->hist, latency);
         
         /* Check duration */
         clock_gettime(CLOCK_MONOTONIC, &end);
@@ -204,6 +1723,8 @@ void* client_thread(void *arg) {
         }
     }
     
+    if (uploading) pthread_join(uploader, NULL);
+    
     clock_gettime(CLOCK_MONOTONIC, &end);
     stats->elapsed_time = (end.tv_sec - start.tv_sec) +
                          (end.tv_nsec - start.tv_nsec) / 1e9;
@@ -215,19 +1736,42 @@ void* client_thread(void *arg) {
 }
 
 void print_usage(const char *prog) {
-    fprintf(stderr, "Usage: %s [-h host] [-p port] [-t threads] [-d duration] [-s msg_size]\n", prog);
+    fprintf(stderr, "Usage: %s [-h host] [-p port] [-u [seqpacket:]path] [-t threads] [-e conns] [-d duration] [-s msg_size] [-i interval_ms] [-r] [-R rate[:poisson]] [-T] [-F] [-f] [-V] [-x down|up|both] [-c cpus] [-P spread|pack] [-N same|cross]\n", prog);
     fprintf(stderr, "  -h host     : Server host (default: %s)\n", DEFAULT_HOST);
     fprintf(stderr, "  -p port     : Server port (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -u path     : Connect to the server's AF_UNIX socket at path instead of\n");
+    fprintf(stderr, "                -h/-p (seqpacket: prefix for SOCK_SEQPACKET, server -u)\n");
     fprintf(stderr, "  -t threads  : Number of client threads (default: %d)\n", DEFAULT_THREADS);
+    fprintf(stderr, "  -e conns    : Event-driven: each thread drives conns non-blocking TCP\n");
+    fprintf(stderr, "                connections through epoll (streaming mode; server -e)\n");
     fprintf(stderr, "  -d duration : Test duration in seconds (default: %d)\n", DEFAULT_DURATION);
     fprintf(stderr, "  -s msg_size : Message size in bytes (default: %d)\n", DEFAULT_MSG_SIZE);
+    fprintf(stderr, "  -i interval : Print throughput/latency every interval ms (default: off)\n");
+    fprintf(stderr, "  -r          : Request/response mode: measure round-trip time per message\n");
+    fprintf(stderr, "  -R rate     : Open-loop -r: send rate requests/s over all threads on a fixed\n");
+    fprintf(stderr, "                (rate:poisson for exponential gaps) schedule, without waiting\n");
+    fprintf(stderr, "                for responses; latency counts from the scheduled send time\n");
+    fprintf(stderr, "  -T          : SO_TIMESTAMPING kernel->user stage (streaming mode)\n");
+    fprintf(stderr, "  -F          : Server frames messages (server -F): count real messages,\n");
+    fprintf(stderr, "                one-way latency and sequence gaps; -s must cover the largest\n");
+    fprintf(stderr, "  -f          : Server passes a memfd (server -f, needs -u): map it and copy\n");
+    fprintf(stderr, "                each message out of it per record, with one-way latency\n");
+    fprintf(stderr, "  -V          : Verify every received payload byte against the servers'\n");
+    fprintf(stderr, "                field pattern (AVX2/SSE2 when available), timed separately\n");
+    fprintf(stderr, "  -x dir      : down (receive), up (upload with sendmsg(), server -x up)\n");
+    fprintf(stderr, "                or both at once (default: down)\n");
+    fprintf(stderr, "  -c cpus     : Pin client threads round-robin to a CPU list such as 0-3,8\n");
+    fprintf(stderr, "  -P policy   : spread (one per physical core first) or pack (SMT siblings)\n");
+    fprintf(stderr, "  -N node     : same or cross: receive buffers on the thread's NUMA node\n");
+    fprintf(stderr, "                or on the next node\n");
 }
 
 int main(int argc, char *argv[]) {
     g_num_threads = DEFAULT_THREADS;
     int opt;
+    const char *cpu_list = NULL;
     
-    while ((opt = getopt(argc, argv, "h:p:t:d:s:H")) != -1) {
+    while ((opt = getopt(argc, argv, "h:p:u:t:e:d:s:rR:TFfi:Vx:c:P:N:H")) != -1) {
         switch (opt) {
             case 'h':
                 strncpy(g_host, optarg, sizeof(g_host) - 1);
@@ -235,15 +1779,96 @@ int main(int argc, char *argv[]) {
             case 'p':
                 g_port = atoi(optarg);
                 break;
+            case 'u':
+                /* [stream:|seqpacket:]PATH */
+                if (strncmp(optarg, "seqpacket:", 10) == 0) {
+                    g_unix_type = SOCK_SEQPACKET;
+                    g_unix_path = optarg + 10;
+                } else {
+                    g_unix_path = strncmp(optarg, "stream:", 7) == 0 ? optarg + 7 : optarg;
+                }
+                break;
             case 't':
                 g_num_threads = atoi(optarg);
                 break;
+            case 'e':
+                g_conns_per_thread = atoi(optarg);
+                break;
             case 'd':
                 g_duration = atoi(optarg);
                 break;
             case 's':
                 g_message_size = atoi(optarg);
                 break;
+            case 'i':
+                g_interval_ms = atoi(optarg);
+                break;
+            case 'r':
+                g_request_response = 1;
+                break;
+            case 'R': {
+                /* RATE[:fixed|:poisson] */
+                char *mode = strchr(optarg, ':');
+                g_rate = atof(optarg);
+                if (mode && strcmp(mode + 1, "poisson") == 0) {
+                    g_poisson = 1;
+                } else if (mode && strcmp(mode + 1, "fixed") != 0) {
+                    fprintf(stderr, "Unknown rate schedule: %s\n", mode + 1);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
+            case 'T':
+                g_timestamping = 1;
+                break;
+            case 'F':
+                g_framing = 1;
+                break;
+            case 'f':
+                g_fd_passing = 1;
+                break;
+            case 'V':
+                g_verify = 1;
+                break;
+            case 'x':
+                if (strcmp(optarg, "down") == 0) {
+                    g_direction = DIR_DOWN;
+                } else if (strcmp(optarg, "up") == 0) {
+                    g_direction = DIR_UP;
+                } else if (strcmp(optarg, "both") == 0) {
+                    g_direction = DIR_BOTH;
+                } else {
+                    fprintf(stderr, "Unknown direction: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'c':
+                cpu_list = optarg;
+                break;
+            case 'P':
+                if (strcmp(optarg, "spread") == 0) {
+                    g_place_policy = PLACE_SPREAD;
+                } else if (strcmp(optarg, "pack") == 0) {
+                    g_place_policy = PLACE_PACK;
+                } else {
+                    fprintf(stderr, "Unknown placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'N':
+                if (strcmp(optarg, "same") == 0) {
+                    g_mem_policy = MEM_SAME;
+                } else if (strcmp(optarg, "cross") == 0) {
+                    g_mem_policy = MEM_CROSS;
+                } else {
+                    fprintf(stderr, "Unknown memory placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
             case 'H':
             default:
                 print_usage(argv[0]);
@@ -251,19 +1876,105 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if (setup_placement(cpu_list) < 0) return 1;
+    if (g_verify) init_verify();
+    
+    if (g_direction != DIR_DOWN && (g_request_response || g_framing)) {
+        fprintf(stderr, "-x up/both cannot be combined with -r or -F\n");
+        return 1;
+    }
+    
+    if (g_conns_per_thread < 0 || (g_conns_per_thread > 0 &&
+        (g_unix_path || g_request_response || g_framing || g_fd_passing ||
+         g_timestamping || g_direction != DIR_DOWN))) {
+        fprintf(stderr, "-e drives streaming TCP connections and cannot be combined with "
+                "-u, -r, -F, -f, -T or -x up/both\n");
+        return 1;
+    }
+    
+    if (g_rate < 0 || (g_rate > 0 && !g_request_response)) {
+        fprintf(stderr, "-R needs -r and a positive rate\n");
+        return 1;
+    }
+    
+    if (g_framing && g_request_response) {
+        fprintf(stderr, "-F is a streaming mode and cannot be combined with -r\n");
+        return 1;
+    }
+    
+    if (g_timestamping && g_request_response) {
+        fprintf(stderr, "-T measures the streaming receive path and cannot be combined with -r\n");
+        return 1;
+    }
+    
+    if (g_unix_path && strlen(g_unix_path) >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", g_unix_path);
+        return 1;
+    }
+    
+    if (g_unix_path && g_timestamping) {
+        fprintf(stderr, "-T needs TCP: AF_UNIX sockets have no RX timestamps\n");
+        return 1;
+    }
+    
+    if (g_fd_passing && (!g_unix_path || g_request_response || g_framing || g_direction != DIR_DOWN)) {
+        fprintf(stderr, "-f needs -u and cannot be combined with -r, -F or -x up/both\n");
+        return 1;
+    }
+    
     signal(SIGINT, signal_handler);
     
     printf("A2 One-Copy Client\n");
     printf("Configuration: host=%s, port=%d, threads=%d, duration=%ds, msg_size=%d\n",
            g_host, g_port, g_num_threads, g_duration, g_message_size);
+    if (g_request_response) {
+        printf("Request/response mode: round-trip time per message\n");
+    }
+    if (g_conns_per_thread > 0) {
+        printf("Event-driven: %d connections per thread through epoll, %d in total\n",
+               g_conns_per_thread, g_num_threads * g_conns_per_thread);
+    }
+    if (g_rate > 0) {
+        printf("Open loop: %.0f requests/s on a %s schedule, latency from the scheduled send time\n",
+               g_rate, g_poisson ? "Poisson" : "fixed-rate");
+    }
+    if (g_direction != DIR_DOWN) {
+        printf("Direction: %s, uploading with sendmsg()\n", g_direction == DIR_UP ? "up" : "both");
+    }
+    if (g_unix_path) {
+        printf("Transport: AF_UNIX %s at %s\n",
+               g_unix_type == SOCK_SEQPACKET ? "SOCK_SEQPACKET" : "SOCK_STREAM", g_unix_path);
+    }
+    if (g_framing) {
+        printf("Framed stream: one-way latency from the server's send timestamp\n");
+    }
+    if (g_fd_passing) {
+        printf("Fd passing: messages copied out of the server's sealed memfd, one-way latency\n");
+    }
     printf("Using recvmsg() with pre-registered buffers\n\n");
     
-    /* Allocate thread statistics array */
-    g_thread_stats = (ThreadStats*)calloc(g_num_threads, sizeof(ThreadStats));
+    if (g_cpu_count > 0) {
+        printf("Placement: %s over %d CPUs, %d NUMA node(s)\n",
+               g_placement, g_cpu_count, g_node_count);
+    }
+    
+    /* Allocate thread statistics array, one cache-line-aligned slot per thread */
+    g_thread_stats = (ThreadStats*)aligned_alloc(CACHE_LINE, g_num_threads * sizeof(ThreadStats));
     if (!g_thread_stats) {
         perror("Failed to allocate thread stats");
         return 1;
     }
+    memset(g_thread_stats, 0, g_num_threads * sizeof(ThreadStats));
+    
+    if (g_conns_per_thread > 0) {
+        raise_fd_limit();
+        g_conn_gbps = (double*)malloc((size_t)g_num_threads * g_conns_per_thread * sizeof(double));
+        if (!g_conn_gbps) {
+            perror("Failed to allocate connection stats");
+            return 1;
+        }
+        for (int i = 0; i < g_num_threads * g_conns_per_thread; i++) g_conn_gbps[i] = -1;
+    }
     
     /* Create threads */
     pthread_t *threads = (pthread_t*)malloc(g_num_threads * sizeof(pthread_t));
@@ -276,21 +1987,42 @@ int main(int argc, char *argv[]) {
     struct timespec global_start, global_end;
     clock_gettime(CLOCK_MONOTONIC, &global_start);
     
+    int created = 0;
     for (int i = 0; i < g_num_threads; i++) {
         int *tid = (int*)malloc(sizeof(int));
         *tid = i;
         if (pthread_create(&threads[i], NULL, client_thread, tid) != 0) {
             perror("Failed to create thread");
             free(tid);
+        } else {
+            created++;
         }
     }
     
+    /* -e: the clock starts once every thread has its connections open */
+    if (g_conns_per_thread > 0) {
+        open_connect_gate(created);
+        clock_gettime(CLOCK_MONOTONIC, &global_start);
+    }
+    
+    pthread_t reporter;
+    int reporting = 0;
+    if (g_interval_ms > 0) {
+        printf("\n--- Live Statistics (every %d ms) ---\n", g_interval_ms);
+        reporting = pthread_create(&reporter, NULL, reporter_thread, NULL) == 0;
+    }
+    
     /* Wait for all threads to complete */
     for (int i = 0; i < g_num_threads; i++) {
         pthread_join(threads[i], NULL);
     }
     
     clock_gettime(CLOCK_MONOTONIC, &global_end);
+    
+    if (reporting) {
+        g_reporter_done = 1;
+        pthread_join(reporter, NULL);
+    }
     double global_elapsed = (global_end.tv_sec - global_start.tv_sec) +
                            (global_end.tv_nsec - global_start.tv_nsec) / 1e9;
     
@@ -299,6 +2031,17 @@ int main(int argc, char *argv[]) {
     unsigned long long total_messages = 0;
     double total_latency = 0;
     unsigned long long total_latency_count = 0;
+    double total_rx_stage = 0;
+    unsigned long long total_rx_stage_count = 0;
+    unsigned long long total_lost = 0, total_reordered = 0, total_zerocopy = 0;
+    LatencyHistogram total_hist;
+    memset(&total_hist, 0, sizeof(total_hist));
+    unsigned long long total_verify_bytes = 0, total_corrupt = 0;
+    unsigned long long total_sent = 0, total_sent_messages = 0;
+    double total_verify_ns = 0, total_thread_time = 0, unchecked_gbps = 0;
+    unsigned long long total_requests = 0, total_unanswered = 0, total_unsent = 0;
+    double total_send_lag = 0, max_behind_us = 0;
+    int total_open = 0, total_failed = 0, total_dropped = 0;
     
     printf("\n--- Per-Thread Statistics ---\n");
     for (int i = 0; i < g_num_threads; i++) {
@@ -306,34 +2049,123 @@ int main(int argc, char *argv[]) {
         double throughput = (s->bytes_received * 8.0) / (s->elapsed_time * 1e9);
         double avg_latency = s->latency_count > 0 ? s->latency_sum / s->latency_count : 0;
         
-        printf("[Thread %d] Received: %.2f MB, Throughput: %.2f Gbps, Avg Latency: %.2f us\n",
-               i, s->bytes_received / 1e6, throughput, avg_latency);
+        printf("[Thread %d] Received: %.2f MB, Throughput: %.2f Gbps, Avg Latency: %.2f us, p99: %.2f us\n",
+               i, s->bytes_received / 1e6, throughput, avg_latency, hist_percentile(&s->hist, 99.0));
         
         total_bytes += s->bytes_received;
         total_messages += s->messages_received;
         total_latency += s->latency_sum;
         total_latency_count += s->latency_count;
+        hist_merge(&total_hist, &s->hist);
+        if (g_direction != DIR_DOWN) {
+            printf("[Thread %d] Sent: %.2f MB, Throughput: %.2f Gbps, %llu messages\n",
+                   i, s->bytes_sent / 1e6, (s->bytes_sent * 8.0) / (s->elapsed_time * 1e9),
+                   s->messages_sent);
+        }
+        total_sent += s->bytes_sent;
+        total_sent_messages += s->messages_sent;
+        total_verify_bytes += s->verify_bytes;
+        total_corrupt += s->verify_corrupt;
+        total_verify_ns += s->verify_ns;
+        if (g_conns_per_thread > 0) {
+            printf("[Thread %d] Connections: %d open, %d failed, %d closed before the end\n",
+                   i, s->conns_open, s->conns_failed, s->conns_dropped);
+        }
+        total_open += s->conns_open;
+        total_failed += s->conns_failed;
+        total_dropped += s->conns_dropped;
+        total_requests += s->requests_sent;
+        total_unanswered += s->requests_unanswered;
+        total_unsent += s->requests_unsent;
+        total_send_lag += s->send_lag_sum;
+        if (s->schedule_behind_us > max_behind_us) max_behind_us = s->schedule_behind_us;
+        total_thread_time += s->elapsed_time;
+        if (s->elapsed_time > s->verify_ns / 1e9) {
+            unchecked_gbps += s->bytes_received * 8.0 / ((s->elapsed_time - s->verify_ns / 1e9) * 1e9);
+        }
+        total_rx_stage += s->rx_stage_sum;
+        total_rx_stage_count += s->rx_stage_count;
+        total_lost += s->frames_lost;
+        total_reordered += s->frames_reordered;
+        total_zerocopy += s->frames_zerocopy;
     }
     
     /* Print aggregate statistics */
-    double total_throughput = (total_bytes * 8.0) / (global_elapsed * 1e9);
+    /* Both directions count towards throughput */
+    double total_throughput = ((total_bytes + total_sent) * 8.0) / (global_elapsed * 1e9);
     double avg_latency = total_latency_count > 0 ? total_latency / total_latency_count : 0;
+    double p50 = hist_percentile(&total_hist, 50.0);
+    double p99 = hist_percentile(&total_hist, 99.0);
+    double p999 = hist_percentile(&total_hist, 99.9);
+    double max_latency = total_hist.max_ns / 1e3;
     
     printf("\n--- Aggregate Statistics ---\n");
     printf("Total bytes received: %.2f MB\n", total_bytes / 1e6);
-    printf("Total messages: %llu\n", total_messages);
+    if (g_direction != DIR_DOWN) {
+        printf("Total bytes sent: %.2f MB, %llu messages (%.4f Gbps)\n",
+               total_sent / 1e6, total_sent_messages, (total_sent * 8.0) / (global_elapsed * 1e9));
+    }
+    printf("Total messages: %llu\n", total_messages + total_sent_messages);
     printf("Total throughput: %.4f Gbps\n", total_throughput);
     printf("Average latency: %.2f us\n", avg_latency);
+    printf("Latency percentiles: p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us\n",
+           p50, p99, p999, max_latency);
     printf("Elapsed time: %.2f seconds\n", global_elapsed);
+    if (g_timestamping) {
+        printf("Kernel->user (RX timestamp to recvmsg return): %.2f us avg over %llu reads\n",
+               total_rx_stage_count > 0 ? total_rx_stage / total_rx_stage_count : 0,
+               total_rx_stage_count);
+    }
+    if (g_framing || g_fd_passing) {
+        printf("Frames: %llu received, %llu lost, %llu reordered, %llu sent zero-copy\n",
+               total_messages, total_lost, total_reordered, total_zerocopy);
+    }
+    if (g_conns_per_thread > 0) {
+        printf("Connections: %d of %d open, %d failed, %d closed before the end\n",
+               total_open, g_num_threads * g_conns_per_thread, total_failed, total_dropped);
+        print_connection_stats();
+    }
+    if (g_rate > 0) {
+        /* An achieved rate below the offered one means the server saturated */
+        printf("Open loop: offered %.0f req/s, achieved %.0f responses/s; %llu requests sent "
+               "%.2f us after their scheduled time on average, %llu unanswered and "
+               "%llu due but never sent at the end (both in the latency figures at "
+               "their wait so far), schedule %.2f ms behind at the end\n",
+               g_rate, total_messages / global_elapsed, total_requests,
+               total_requests > 0 ? total_send_lag / total_requests : 0,
+               total_unanswered, total_unsent, max_behind_us / 1e3);
+    }
+    
+    if (g_verify) {
+        /* Checks run inline, so also show the rate with their time taken out */
+        printf("Verification (%s): %.2f MB checked, %llu corrupt messages, %.3f s in checks "
+               "(%.1f%% of receive time, %.2f GB/s), %.4f Gbps excluding checks\n",
+               g_verify_isa, total_verify_bytes / 1e6, total_corrupt, total_verify_ns / 1e9,
+               total_thread_time > 0 ? 100.0 * total_verify_ns / 1e9 / total_thread_time : 0,
+               total_verify_ns > 0 ? total_verify_bytes / total_verify_ns : 0,
+               unchecked_gbps);
+    }
     
-    /* Output CSV-friendly format */
+    /* Output CSV-friendly format; -e rows carry the connection count */
+    char conn_label[32] = "";
+    if (g_conns_per_thread > 0) {
+        snprintf(conn_label, sizeof(conn_label), "_c%d", g_num_threads * g_conns_per_thread);
+    }
     printf("\n--- CSV Output ---\n");
-    printf("implementation,threads,msg_size,throughput_gbps,latency_us,bytes_total,elapsed_s\n");
-    printf("one_copy,%d,%d,%.4f,%.2f,%llu,%.2f\n",
-           g_num_threads, g_message_size, total_throughput, avg_latency, total_bytes, global_elapsed);
+    printf("implementation,threads,msg_size,throughput_gbps,latency_us,bytes_total,elapsed_s,p50_us,p99_us,p999_us,max_us,placement\n");
+    printf("%s%s%s%s%s%s,%d,%d,%.4f,%.2f,%llu,%.2f,%.2f,%.2f,%.2f,%.2f,%s\n",
+           g_request_response ? "one_copy_rr" : g_framing ? "one_copy_framed" : g_fd_passing ? "one_copy_fdpass" : "one_copy",
+           conn_label,
+           g_rate > 0 ? (g_poisson ? "_poisson" : "_fixed") : "",
+           g_direction == DIR_UP ? "_up" : g_direction == DIR_BOTH ? "_bidir" : "",
+           g_unix_path ? (g_unix_type == SOCK_SEQPACKET ? "_seqpacket" : "_unix") : "",
+           g_verify ? "_verified" : "", g_num_threads, g_message_size, total_throughput, avg_latency,
+           total_bytes + total_sent, global_elapsed,
+           p50, p99, p999, max_latency, g_placement);
     
     free(threads);
     free(g_thread_stats);
+    free(g_conn_gbps);
     
     return 0;
 }
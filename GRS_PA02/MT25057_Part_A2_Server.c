@@ -21,20 +21,57 @@
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <time.h>
 #include <signal.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <linux/filter.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 
 #define DEFAULT_PORT 8082
 #define NUM_FIELDS 8
 #define DEFAULT_MSG_SIZE 1024
 #define BACKLOG 128
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+/* Error queue control buffer: IP_RECVERR (with offender address) plus SCM_TIMESTAMPING */
+#define TS_CONTROL_SIZE (CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in)) + \
+                         CMSG_SPACE(sizeof(struct scm_timestamping)))
+#define MAX_EVENTS 256
+#define SEND_BUDGET 16      /* Messages sent per writable event before yielding */
 
 /* Global configuration */
 static int g_message_size = DEFAULT_MSG_SIZE;
+static int g_event_workers = 0;    /* 0 = thread-per-connection mode */
+static int g_request_response = 0;
+static int g_timestamping = 0;
+static int g_shards = 0;          /* 0 = single listener, accept() in main() */
+static int g_shard_workers = 1;   /* Workers accepting on each shard's listener */
+static int g_steer_cpu = 0;       /* -b: steer connections to the shard on the SYN's CPU */
+static int g_framing = 0;
+static int g_fd_passing = 0;     /* -f: pass a memfd of the message, then send records */
+
+/* Data direction (-x) */
+#define DIR_DOWN 0      /* Server sends, client receives (default) */
+#define DIR_UP 1        /* Client sends, server receives */
+#define DIR_BOTH 2      /* Both at once on each connection */
+static int g_direction = DIR_DOWN;
+
+/* AF_UNIX transport (-u) */
+static const char *g_unix_path = NULL;     /* NULL = TCP on -p port */
+static int g_unix_type = SOCK_STREAM;      /* or SOCK_SEQPACKET */
 static volatile int g_running = 1;
 
 /* Message structure with 8 dynamically allocated string fields */
@@ -43,6 +80,19 @@ typedef struct {
     size_t field_sizes[NUM_FIELDS];
 } Message;
 
+/* Shared message store (-S): one immutable copy of the message, built once at */
+/* startup on 2 MB pages, that every connection sends from */
+typedef struct {
+    Message msg;            /* fields[] point into base, back to back */
+    struct iovec iov[NUM_FIELDS];   /* Shared scatter-gather view of the fields */
+    char *base;
+    size_t size;            /* Message bytes */
+    size_t map_size;        /* Mapping size, a multiple of HUGE_PAGE_SIZE */
+    const char *backing;    /* "hugetlb", "thp" or "4k" */
+} MessageStore;
+
+static MessageStore *g_store = NULL;
+
 /* Thread argument structure */
 typedef struct {
     int client_fd;
@@ -50,6 +100,47 @@ typedef struct {
     struct sockaddr_in client_addr;
 } ThreadArg;
 
+/* Sharded listener worker (-w) */
+typedef struct {
+    pthread_t thread;
+    int worker_id;
+    int shard_id;
+    int listen_fd;      /* The shard's own SO_REUSEPORT listener */
+} ShardWorker;
+
+/* Request/response mode (-r): the client sends this header as its request */
+/* and the server echoes it at the start of the response */
+typedef struct {
+    uint64_t seq;
+    uint64_t send_ts_ns;    /* Client CLOCK_MONOTONIC time when the request was sent */
+} RequestHeader;
+
+/* Frame header (-F): precedes every streamed message, same layout in every binary */
+#define FRAME_F_ZEROCOPY 0x1    /* Payload was sent with MSG_ZEROCOPY */
+#define FRAME_F_MEMFD 0x4       /* Payload is in the memfd passed with SCM_RIGHTS (-f) */
+typedef struct {
+    uint32_t length;        /* Payload bytes following the header */
+    uint32_t flags;         /* FRAME_F_* */
+    uint64_t seq;           /* Message number on this connection, from 0 */
+    uint64_t send_ts_ns;    /* Sender CLOCK_MONOTONIC time when the send was issued */
+} FrameHeader;
+
+/* TX timestamp stages reported by SO_TIMESTAMPING (-T) */
+#define STAGE_USER_QDISC 0  /* send() call -> SCHED (entered the qdisc) */
+#define STAGE_QDISC_WIRE 1  /* SCHED -> SND (handed to the driver) */
+#define STAGE_WIRE_ACK 2    /* SND -> ACK (peer acknowledged the last byte) */
+#define NUM_STAGES 3
+#define TS_PENDING 4096     /* Sends awaiting their TX timestamps */
+
+/* Sends awaiting TX timestamps, keyed by the OPT_ID byte offset of their last byte */
+typedef struct {
+    uint32_t id[TS_PENDING];
+    struct timespec stamp[TS_PENDING][NUM_STAGES];  /* user, sched, snd (CLOCK_REALTIME) */
+    unsigned long long head, tail;
+    double stage_sum[NUM_STAGES];
+    unsigned long long stage_count[NUM_STAGES];
+} TxTimestamps;
+
 /* Statistics structure */
 typedef struct {
     unsigned long long bytes_sent;
@@ -57,6 +148,391 @@ typedef struct {
     double elapsed_time;
 } Stats;
 
+/* Per-connection state for event-loop mode */
+typedef struct {
+    int fd;
+    int conn_id;
+    size_t offset;          /* Bytes of the current message already sent */
+    Stats stats;
+    struct timespec start;
+    struct sockaddr_in client_addr;
+} Connection;
+
+/* Event-loop worker: owns one epoll set and one message/iovec pair */
+typedef struct {
+    int worker_id;
+    int epoll_fd;
+    pthread_t thread;
+    Message *msg;
+    struct iovec *iov;
+    size_t total_size;
+} EventWorker;
+
+/* Thread placement (-c / -P / -N) */
+#define PLACE_NONE 0
+#define PLACE_LIST 1        /* CPUs in the order given with -c */
+#define PLACE_SPREAD 2      /* One CPU per physical core before any SMT sibling */
+#define PLACE_PACK 3        /* Fill the SMT siblings of a core before the next core */
+#define MEM_ANY 0
+#define MEM_SAME 1          /* Buffers on the NUMA node of the thread's CPU */
+#define MEM_CROSS 2         /* Buffers on the next NUMA node, across the interconnect */
+#define MAX_NODES 64
+
+static int g_place_policy = PLACE_NONE;
+static int g_mem_policy = MEM_ANY;
+static int g_cpus[CPU_SETSIZE];     /* CPUs in placement order, used round-robin */
+static int g_cpu_count = 0;
+static int g_node_count = 1;
+static char g_placement[64] = "none";
+
+/* Parse a CPU list such as "0-3,8,10-11", returns the number of CPUs or -1 */
+int parse_cpu_list(const char *list, int *cpus, int max) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return -1;
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && count < max; c++) {
+            cpus[count++] = (int)c;
+        }
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+        else break;
+    }
+    return count;
+}
+
+/* Lowest-numbered SMT sibling of a CPU, identifying its physical core */
+int core_of_cpu(int cpu) {
+    char path[128], line[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return cpu;
+    int siblings[CPU_SETSIZE];
+    int n = fgets(line, sizeof(line), f) ? parse_cpu_list(line, siblings, CPU_SETSIZE) : -1;
+    fclose(f);
+    return n > 0 ? siblings[0] : cpu;
+}
+
+/* NUMA node a CPU belongs to (0 if the topology is not exported) */
+int node_of_cpu(int cpu) {
+    char path[128];
+    for (int node = 0; node < g_node_count; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+    return 0;
+}
+
+/* Build the CPU order from -c / -P and count NUMA nodes */
+int setup_placement(const char *cpu_list) {
+    char path[64];
+    g_node_count = 0;
+    while (g_node_count < MAX_NODES) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", g_node_count);
+        if (access(path, F_OK) != 0) break;
+        g_node_count++;
+    }
+    if (g_node_count == 0) g_node_count = 1;
+    
+    if (cpu_list) {
+        g_cpu_count = parse_cpu_list(cpu_list, g_cpus, CPU_SETSIZE);
+        if (g_cpu_count <= 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+            return -1;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    } else if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        /* Default to every CPU this process may run on */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) g_cpus[g_cpu_count++] = c;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    }
+    
+    if (g_place_policy == PLACE_SPREAD || g_place_policy == PLACE_PACK) {
+        /* Sort key: spread = (sibling rank, core), pack = (core, sibling rank) */
+        int core[CPU_SETSIZE], rank[CPU_SETSIZE];
+        for (int i = 0; i < g_cpu_count; i++) {
+            core[i] = core_of_cpu(g_cpus[i]);
+            rank[i] = 0;
+            for (int j = 0; j < i; j++) {
+                if (core[j] == core[i]) rank[i]++;
+            }
+        }
+        for (int i = 1; i < g_cpu_count; i++) {
+            for (int j = i; j > 0; j--) {
+                int a = j - 1, b = j;
+                int swap = g_place_policy == PLACE_SPREAD ?
+                    (rank[a] > rank[b] || (rank[a] == rank[b] && core[a] > core[b])) :
+                    (core[a] > core[b] || (core[a] == core[b] && rank[a] > rank[b]));
+                if (!swap) break;
+                int t;
+                t = g_cpus[a]; g_cpus[a] = g_cpus[b]; g_cpus[b] = t;
+                t = core[a]; core[a] = core[b]; core[b] = t;
+                t = rank[a]; rank[a] = rank[b]; rank[b] = t;
+            }
+        }
+    }
+    
+    if (g_mem_policy == MEM_CROSS && g_node_count < 2) {
+        fprintf(stderr, "Warning: only one NUMA node, -N cross places memory on the same node\n");
+    }
+    
+    static const char *place_names[] = { "none", "list", "spread", "pack" };
+    static const char *mem_names[] = { "any", "same", "cross" };
+    if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        snprintf(g_placement, sizeof(g_placement), "%s-%s",
+                 place_names[g_place_policy], mem_names[g_mem_policy]);
+    }
+    return 0;
+}
+
+/* CPU for the index-th thread, or -1 when placement is off */
+int placement_cpu(int index) {
+    return g_cpu_count > 0 ? g_cpus[index % g_cpu_count] : -1;
+}
+
+/* Prefer the -N node of a CPU for this thread's future page faults (-1 resets) */
+void bind_memory(int cpu) {
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+    memset(mask, 0, sizeof(mask));
+    
+    if (cpu < 0 || g_mem_policy == MEM_ANY) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        return;
+    }
+    
+    int node = node_of_cpu(cpu);
+    if (g_mem_policy == MEM_CROSS) node = (node + 1) % g_node_count;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    
+    /* MPOL_PREFERRED rather than BIND so a full node degrades instead of failing */
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0) {
+        perror("set_mempolicy failed");
+    }
+}
+
+/* Pin the calling thread to its CPU and place its allocations (first touch) */
+void place_thread(int index) {
+    int cpu = placement_cpu(index);
+    if (cpu < 0) return;
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Failed to pin thread %d to CPU %d\n", index, cpu);
+    }
+    bind_memory(cpu);
+}
+
+/* Message-size workload (-D) */
+#define DIST_FIXED 0        /* Every message is -s bytes */
+#define DIST_UNIFORM 1      /* uniform:MIN:MAX */
+#define DIST_BIMODAL 2      /* bimodal:SMALL:LARGE:P_LARGE */
+#define DIST_LOGNORMAL 3    /* lognormal:MEDIAN:SIGMA */
+#define DIST_PARETO 4       /* pareto:MIN:ALPHA */
+#define DIST_TRACE 5        /* trace:FILE, replays sizes and inter-arrival gaps */
+#define SIZE_CLASSES 32     /* log2 message-size classes for per-size reporting */
+static int g_dist = DIST_FIXED;
+static double g_dist_param[3];
+static char g_dist_name[64] = "fixed";
+static size_t *g_trace_sizes = NULL;
+static unsigned int *g_trace_gaps_us = NULL;   /* Gap before each message */
+static size_t g_trace_len = 0;
+
+/* Per-connection workload state */
+typedef struct {
+    uint64_t rng;
+    size_t trace_pos;
+    struct timespec next_send;      /* Trace replay schedule */
+} Workload;
+
+/* Sends per log2 size class, timed from message build to the last byte queued */
+typedef struct {
+    unsigned long long messages[SIZE_CLASSES];
+    unsigned long long bytes[SIZE_CLASSES];
+    double send_ns[SIZE_CLASSES];
+} SizeStats;
+
+/* log2 size class of a message */
+int size_class(size_t size) {
+    int cls = 0;
+    while (size > 1 && cls < SIZE_CLASSES - 1) {
+        size >>= 1;
+        cls++;
+    }
+    return cls;
+}
+/* Load a size trace: one "size_bytes [gap_us]" pair per line, '#' starts a comment */
+int load_trace(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    
+    size_t cap = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+        
+        unsigned long size, gap = 0;
+        if (sscanf(p, "%lu %lu", &size, &gap) < 1 || size == 0) {
+            fprintf(stderr, "Invalid trace line: %s", line);
+            fclose(f);
+            return -1;
+        }
+        if (g_trace_len == cap) {
+            cap = cap ? cap * 2 : 1024;
+            g_trace_sizes = (size_t*)realloc(g_trace_sizes, cap * sizeof(size_t));
+            g_trace_gaps_us = (unsigned int*)realloc(g_trace_gaps_us, cap * sizeof(unsigned int));
+            if (!g_trace_sizes || !g_trace_gaps_us) {
+                perror("Failed to allocate trace");
+                fclose(f);
+                return -1;
+            }
+        }
+        g_trace_sizes[g_trace_len] = size;
+        g_trace_gaps_us[g_trace_len] = (unsigned int)gap;
+        g_trace_len++;
+        
+        /* Buffers are sized for the largest message in the trace */
+        if (size > (unsigned long)g_message_size) g_message_size = (int)size;
+    }
+    fclose(f);
+    
+    if (g_trace_len == 0) {
+        fprintf(stderr, "Empty trace: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Parse a -D workload specification */
+int parse_dist(const char *spec) {
+    snprintf(g_dist_name, sizeof(g_dist_name), "%s", spec);
+    if (strncmp(spec, "trace:", 6) == 0) {
+        g_dist = DIST_TRACE;
+        return load_trace(spec + 6);
+    }
+    
+    char name[16] = "";
+    double *a = g_dist_param;
+    int n = sscanf(spec, "%15[a-z]:%lf:%lf:%lf", name, &a[0], &a[1], &a[2]);
+    if (strcmp(name, "fixed") == 0 && n == 1) {
+        g_dist = DIST_FIXED;
+    } else if (strcmp(name, "uniform") == 0 && n == 3 && a[0] >= 1 && a[1] >= a[0]) {
+        g_dist = DIST_UNIFORM;
+    } else if (strcmp(name, "bimodal") == 0 && n == 4 && a[0] >= 1 && a[1] >= 1 &&
+               a[2] >= 0 && a[2] <= 1) {
+        g_dist = DIST_BIMODAL;
+    } else if (strcmp(name, "lognormal") == 0 && n == 3 && a[0] >= 1 && a[1] > 0) {
+        g_dist = DIST_LOGNORMAL;
+    } else if (strcmp(name, "pareto") == 0 && n == 3 && a[0] >= 1 && a[1] > 0) {
+        g_dist = DIST_PARETO;
+    } else {
+        fprintf(stderr, "Invalid size distribution: %s\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+void init_workload(Workload *w, int thread_id) {
+    w->rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(thread_id + 1);
+    w->trace_pos = 0;
+    clock_gettime(CLOCK_MONOTONIC, &w->next_send);
+}
+
+/* xorshift64* mapped to a double in (0, 1) */
+double rng_uniform(uint64_t *s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return (((*s * 0x2545F4914F6CDD1DULL) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* Size of the next message, clamped to [1, -s]; trace replay sleeps out the gap first */
+size_t next_message_size(Workload *w) {
+    const double *a = g_dist_param;
+    double size;
+    switch (g_dist) {
+        case DIST_UNIFORM:
+            size = floor(a[0] + rng_uniform(&w->rng) * (a[1] - a[0] + 1));
+            break;
+        case DIST_BIMODAL:
+            size = rng_uniform(&w->rng) < a[2] ? a[1] : a[0];
+            break;
+        case DIST_LOGNORMAL: {
+            /* Box-Muller normal sample, scaled around the median */
+            double u1 = rng_uniform(&w->rng), u2 = rng_uniform(&w->rng);
+            double z = sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+            size = a[0] * exp(a[1] * z);
+            break;
+        }
+        case DIST_PARETO:
+            /* Inverse CDF: MIN / U^(1/ALPHA) */
+            size = a[0] / pow(rng_uniform(&w->rng), 1.0 / a[1]);
+            break;
+        case DIST_TRACE: {
+            size_t i = w->trace_pos++ % g_trace_len;
+            if (g_trace_gaps_us[i] > 0) {
+                w->next_send.tv_nsec += (long)g_trace_gaps_us[i] * 1000;
+                w->next_send.tv_sec += w->next_send.tv_nsec / 1000000000L;
+                w->next_send.tv_nsec %= 1000000000L;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &w->next_send, NULL);
+            }
+            return g_trace_sizes[i];
+        }
+        default:
+            return g_message_size;
+    }
+    if (size < 1) size = 1;
+    if (size > g_message_size) size = g_message_size;
+    return (size_t)size;
+}
+
+/* Field sizes of a total-byte message, split as in create_message() */
+void split_fields(size_t total, size_t *sizes) {
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        sizes[i] = total / NUM_FIELDS + (i < (int)(total % NUM_FIELDS) ? 1 : 0);
+    }
+}
+
+void size_stats_record(SizeStats *ss, size_t size, const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int cls = size_class(size);
+    ss->messages[cls]++;
+    ss->bytes[cls] += size;
+    ss->send_ns[cls] += (t1.tv_sec - t0->tv_sec) * 1e9 + (t1.tv_nsec - t0->tv_nsec);
+}
+
+/* Per-size-class breakdown of one connection's sends */
+void print_size_stats(int thread_id, const SizeStats *ss) {
+    printf("[Thread %d] Sizes (%s):\n", thread_id, g_dist_name);
+    for (int c = 0; c < SIZE_CLASSES; c++) {
+        if (ss->messages[c] == 0) continue;
+        printf("[Thread %d]   %7llu-%-7llu B: %10llu msgs, %8.2f us/msg, %6.2f Gbps while sending\n",
+               thread_id, 1ULL << c, (2ULL << c) - 1, ss->messages[c],
+               ss->send_ns[c] / ss->messages[c] / 1e3,
+               ss->bytes[c] * 8.0 / ss->send_ns[c]);
+    }
+}
+
 /* Signal handler for graceful shutdown */
 void signal_handler(int sig) {
     (void)sig;
@@ -104,8 +580,111 @@ void destroy_message(Message *msg) {
     }
 }
 
+/* kB of transparent huge pages in the mapping that contains addr, from its */
+/* AnonHugePages line in /proc/self/smaps, or -1 if it cannot be read */
+long thp_backed_kb(const void *addr) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return -1;
+    
+    char line[256];
+    int in_range = 0;
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long lo, hi;
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            if (in_range) break;
+            in_range = (uintptr_t)addr >= lo && (uintptr_t)addr < hi;
+        } else if (in_range && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    
+    fclose(f);
+    return kb;
+}
+
+/* Map size bytes on 2 MB pages: the hugetlb pool if it has pages reserved, */
+/* otherwise a 2 MB aligned anonymous mapping advised for transparent huge pages */
+/* backing is only "thp" if smaps shows huge pages under the whole range */
+void* map_huge(size_t size, size_t *map_size, const char **backing) {
+    *map_size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void *p = mmap(NULL, *map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        *backing = "hugetlb";
+        return p;
+    }
+    
+    /* Over-map by one huge page and trim, so THP can back the region from its start */
+    char *raw = (char*)mmap(NULL, *map_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    char *aligned = (char*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned > raw) munmap(raw, aligned - raw);
+    if (raw + HUGE_PAGE_SIZE > aligned) {
+        munmap(aligned + *map_size, raw + HUGE_PAGE_SIZE - aligned);
+    }
+    *backing = "4k";
+    if (madvise(aligned, *map_size, MADV_HUGEPAGE) == 0) {
+        /* THP is decided at fault time, so fault the range in before asking what backs it */
+        memset(aligned, 0, *map_size);
+        if (thp_backed_kb(aligned) >= (long)(*map_size / 1024)) *backing = "thp";
+    }
+    return aligned;
+}
+
+/* Build the shared store: same field sizes and pattern as create_message(), */
+/* but laid out contiguously in one huge page mapping */
+MessageStore* create_message_store(size_t total_size) {
+    MessageStore *store = (MessageStore*)calloc(1, sizeof(MessageStore));
+    if (!store) {
+        perror("Failed to allocate message store");
+        return NULL;
+    }
+    
+    store->base = (char*)map_huge(total_size, &store->map_size, &store->backing);
+    if (!store->base) {
+        perror("Failed to map message store");
+        free(store);
+        return NULL;
+    }
+    store->size = total_size;
+    
+    size_t field_size = total_size / NUM_FIELDS;
+    size_t remainder = total_size % NUM_FIELDS;
+    size_t offset = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        size_t size = field_size + (i < (int)remainder ? 1 : 0);
+        store->msg.fields[i] = store->base + offset;
+        store->msg.field_sizes[i] = size;
+        store->iov[i].iov_base = store->msg.fields[i];
+        store->iov[i].iov_len = size;
+        memset(store->msg.fields[i], 'A' + i, size);
+        offset += size;
+    }
+    
+    /* Immutable from here on: a stray write faults instead of corrupting every connection */
+    if (mprotect(store->base, store->map_size, PROT_READ) < 0) {
+        perror("mprotect message store failed");
+    }
+    
+    return store;
+}
+
+/* Message for a connection or worker: the shared store (-S) or a private copy */
+Message* acquire_message(void) {
+    return g_store ? &g_store->msg : create_message(g_message_size);
+}
+
+/* Release a message from acquire_message(), the store lives until exit */
+void release_message(Message *msg) {
+    if (!g_store) destroy_message(msg);
+}
+
 /* Prepare iovec array from message - this is the key optimization */
 /* Instead of copying to a single buffer, we set up scatter-gather I/O */
+/* There is no -m sendfile/splice engine here: sending from a memfd skips the */
+/* user-space gather this implementation measures, and A1 -m already covers it */
 struct iovec* prepare_iovec(Message *msg) {
     struct iovec *iov = (struct iovec*)malloc(NUM_FIELDS * sizeof(struct iovec));
     if (!iov) return NULL;
@@ -118,46 +697,356 @@ struct iovec* prepare_iovec(Message *msg) {
     return iov;
 }
 
+/* Build an iovec view of the message that skips the first offset bytes */
+/* Used to resume a partially sent message without copying any data */
+int iovec_from_offset(const struct iovec *src, int count, size_t offset,
+                      struct iovec *dst) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (offset >= src[i].iov_len) {
+            offset -= src[i].iov_len;
+            continue;
+        }
+        dst[n].iov_base = (char*)src[i].iov_base + offset;
+        dst[n].iov_len = src[i].iov_len - offset;
+        offset = 0;
+        n++;
+    }
+    return n;
+}
+
+/* Enable software TX timestamps; OPT_ID keys every report by byte offset */
+int enable_tx_timestamps(int fd) {
+    int flags = SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_SOFTWARE |
+                SOF_TIMESTAMPING_TX_ACK | SOF_TIMESTAMPING_SOFTWARE |
+                SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+/* Remember when the send ending at byte offset bytes_sent - 1 was issued */
+void ts_track_send(TxTimestamps *ts, unsigned long long bytes_sent,
+                   const struct timespec *t_user) {
+    if (ts->head - ts->tail == TS_PENDING) ts->tail++;     /* Drop the oldest */
+    unsigned int idx = ts->head % TS_PENDING;
+    ts->id[idx] = (uint32_t)(bytes_sent - 1);
+    memset(ts->stamp[idx], 0, sizeof(ts->stamp[idx]));
+    ts->stamp[idx][0] = *t_user;
+    ts->head++;
+}
+
+/* Apply one report: type is SCM_TSTAMP_SCHED/SND/ACK, key the OPT_ID byte offset */
+void ts_record(TxTimestamps *ts, uint32_t key, unsigned int type, const struct timespec *t) {
+    if (ts->tail == ts->head) return;
+    
+    /* Keys grow with the byte stream, so binary search the pending window */
+    unsigned long long lo = ts->tail, hi = ts->head;
+    uint32_t base = ts->id[lo % TS_PENDING];
+    while (lo < hi) {
+        unsigned long long mid = lo + (hi - lo) / 2;
+        if (ts->id[mid % TS_PENDING] - base < key - base) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == ts->head || ts->id[lo % TS_PENDING] != key) return;  /* Untracked partial send */
+    
+    int stage = type == SCM_TSTAMP_SCHED ? STAGE_USER_QDISC :
+                type == SCM_TSTAMP_SND ? STAGE_QDISC_WIRE : STAGE_WIRE_ACK;
+    struct timespec *s = ts->stamp[lo % TS_PENDING];
+    if (s[stage].tv_sec != 0) {
+        ts->stage_sum[stage] += (t->tv_sec - s[stage].tv_sec) * 1e6 +
+                                (t->tv_nsec - s[stage].tv_nsec) / 1e3;
+        ts->stage_count[stage]++;
+    }
+    if (stage + 1 < NUM_STAGES) {
+        s[stage + 1] = *t;
+    } else {
+        ts->tail = lo + 1;  /* ACKed: earlier sends have nothing more to report */
+    }
+}
+
+/* Match the SCM_TIMESTAMPING and IP_RECVERR cmsgs of one error queue message */
+void ts_handle_errqueue(struct msghdr *msg, TxTimestamps *ts) {
+    struct scm_timestamping *tss = NULL;
+    struct sock_extended_err *serr = NULL;
+    
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm; cm = CMSG_NXTHDR(msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+            tss = (struct scm_timestamping*)CMSG_DATA(cm);
+        } else if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) {
+            serr = (struct sock_extended_err*)CMSG_DATA(cm);
+        }
+    }
+    
+    if (tss && serr && serr->ee_errno == ENOMSG &&
+        serr->ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+        ts_record(ts, serr->ee_data, serr->ee_info, &tss->ts[0]);
+    }
+}
+
+/* Drain TX timestamp reports from the error queue without blocking */
+void drain_tx_timestamps(int fd, TxTimestamps *ts) {
+    char control[TS_CONTROL_SIZE];
+    struct msghdr msg;
+    
+    while (1) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        ts_handle_errqueue(&msg, ts);
+    }
+}
+
+/* Print the average of each TX stage */
+void print_tx_stages(int thread_id, const TxTimestamps *ts) {
+    double avg[NUM_STAGES];
+    for (int i = 0; i < NUM_STAGES; i++) {
+        avg[i] = ts->stage_count[i] > 0 ? ts->stage_sum[i] / ts->stage_count[i] : 0;
+    }
+    printf("[Thread %d] TX stages: user->qdisc %.2f us, qdisc->wire %.2f us, "
+           "wire->ack %.2f us (%llu/%llu/%llu samples)\n",
+           thread_id, avg[STAGE_USER_QDISC], avg[STAGE_QDISC_WIRE], avg[STAGE_WIRE_ACK],
+           ts->stage_count[STAGE_USER_QDISC], ts->stage_count[STAGE_QDISC_WIRE],
+           ts->stage_count[STAGE_WIRE_ACK]);
+}
+
+/* Read one request header, returns 1 on success or 0 if the client went away */
+int read_request(int fd, RequestHeader *req) {
+    size_t got = 0;
+    while (got < sizeof(*req)) {
+        ssize_t n = recv(fd, (char*)req + got, sizeof(*req) - got, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return 0;
+        }
+        got += n;
+    }
+    return 1;
+}
+
+/* sendmsg() a whole iovec list, resuming after partial sends */
+/* Returns bytes sent or <= 0 on error */
+ssize_t sendmsg_all(int fd, const struct iovec *src, int count, size_t total) {
+    struct iovec iov[NUM_FIELDS + 1];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    
+    size_t sent = 0;
+    while (sent < total) {
+        mh.msg_iovlen = iovec_from_offset(src, count, sent, iov);
+        ssize_t n = sendmsg(fd, &mh, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return n;
+        }
+        sent += n;
+    }
+    return sent;
+}
+
+/* Gather the fields into a sealed memfd for fd passing (-f), returns the fd or -1 */
+int create_message_memfd(const struct iovec *iov, size_t total) {
+    int fd = memfd_create("mt25057_message", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        perror("memfd_create failed");
+        return -1;
+    }
+    
+    /* One pwritev() gathers the fields just like sendmsg() does */
+    if (ftruncate(fd, total) < 0 || pwritev(fd, iov, NUM_FIELDS, 0) != (ssize_t)total) {
+        perror("memfd write failed");
+        close(fd);
+        return -1;
+    }
+    
+    /* The client maps it: seal it so it can trust the size and contents */
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        perror("memfd seal failed");
+    }
+    return fd;
+}
+
+/* Send one fd-passing record (-f), attaching memfd with SCM_RIGHTS when it is >= 0 */
+/* Returns bytes sent or <= 0 on error */
+ssize_t send_fd_record(int fd, const FrameHeader *hdr, int memfd) {
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { (void*)hdr, sizeof(*hdr) };
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (memfd >= 0) {
+        mh.msg_control = control.buf;
+        mh.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cm), &memfd, sizeof(int));
+    }
+    
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &mh, 0);
+    } while (sent < 0 && errno == EINTR);
+    if (sent <= 0 || (size_t)sent == sizeof(*hdr)) return sent;
+    
+    /* The descriptor went with the first byte, the rest of the record follows plainly */
+    iov.iov_base = (char*)hdr + sent;
+    iov.iov_len = sizeof(*hdr) - sent;
+    ssize_t rest = sendmsg_all(fd, &iov, 1, iov.iov_len);
+    return rest > 0 ? sent + rest : rest;
+}
+
+/* Fill in the frame header of a connection's next message */
+void frame_stamp(FrameHeader *hdr, uint32_t length, uint64_t seq, uint32_t flags) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    hdr->length = length;
+    hdr->flags = flags;
+    hdr->seq = seq;
+    hdr->send_ts_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Receive side of an upload (-x up/both) */
+typedef struct {
+    int client_fd;
+    int thread_id;
+} UploadArg;
+
+/* Per-connection summary of the upload direction */
+void print_upload_stats(int thread_id, unsigned long long bytes, unsigned long long messages,
+                        const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+    printf("[Thread %d] Upload: %.2f GB received, %.2f Gbps, %llu messages in %.2f seconds\n",
+           thread_id, bytes / 1e9, elapsed > 0 ? bytes * 8.0 / (elapsed * 1e9) : 0,
+           messages, elapsed);
+}
+
+/* Receive the client's upload with recvmsg() straight into a message's fields */
+/* Each read scatters from the current offset, so messages are the -s bytes the client sends */
+void* upload_receiver(void *arg) {
+    UploadArg *ua = (UploadArg*)arg;
+    Message *msg = create_message(g_message_size);
+    struct iovec *fields = msg ? prepare_iovec(msg) : NULL;
+    if (!fields) {
+        destroy_message(msg);
+        return NULL;
+    }
+    
+    struct iovec iov[NUM_FIELDS];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    
+    unsigned long long bytes = 0, messages = 0;
+    size_t partial = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    while (g_running) {
+        mh.msg_iovlen = iovec_from_offset(fields, NUM_FIELDS, partial, iov);
+        ssize_t received = recvmsg(ua->client_fd, &mh, 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) continue;
+            if (received < 0 && errno != ECONNRESET) perror("upload recvmsg error");
+            break;
+        }
+        bytes += received;
+        partial += received;
+        if (partial == (size_t)g_message_size) {
+            partial = 0;
+            messages++;
+        }
+    }
+    
+    print_upload_stats(ua->thread_id, bytes, messages, &start);
+    free(fields);
+    destroy_message(msg);
+    return NULL;
+}
+
 /* Client handler thread function */
 void* client_handler(void *arg) {
     ThreadArg *targ = (ThreadArg*)arg;
     int client_fd = targ->client_fd;
     int thread_id = targ->thread_id;
     
-    printf("[Thread %d] Client connected from %s:%d\n",
-           thread_id,
-           inet_ntoa(targ->client_addr.sin_addr),
-           ntohs(targ->client_addr.sin_port));
+    /* Pin before allocating so the message is first touched on the chosen node */
+    /* (shard workers stay on their shard's CPU) */
+    if (!g_shards) place_thread(thread_id);
     
-    /* Create message structure */
-    Message *msg = create_message(g_message_size);
+    if (g_unix_path) {
+        printf("[Thread %d] Client connected on %s\n", thread_id, g_unix_path);
+    } else {
+        printf("[Thread %d] Client connected from %s:%d\n",
+               thread_id,
+               inet_ntoa(targ->client_addr.sin_addr),
+               ntohs(targ->client_addr.sin_port));
+    }
+    
+    /* Upload (-x up): the client sends and this connection only receives */
+    if (g_direction == DIR_UP) {
+        UploadArg upload = { client_fd, thread_id };
+        upload_receiver(&upload);
+        close(client_fd);
+        free(targ);
+        return NULL;
+    }
+    
+    /* Create message structure, or use the shared store */
+    Message *msg = acquire_message();
     if (!msg) {
         close(client_fd);
         free(targ);
         return NULL;
     }
     
-    /* Prepare iovec for scatter-gather I/O */
-    struct iovec *iov = prepare_iovec(msg);
+    /* Prepare iovec for scatter-gather I/O (sendmsg() never writes to it, so the store's is shared) */
+    struct iovec *iov = g_store ? g_store->iov : prepare_iovec(msg);
     if (!iov) {
-        destroy_message(msg);
+        release_message(msg);
         close(client_fd);
         free(targ);
         return NULL;
     }
     
-    /* Prepare msghdr structure */
-    struct msghdr mh;
-    memset(&mh, 0, sizeof(mh));
-    mh.msg_iov = iov;
-    mh.msg_iovlen = NUM_FIELDS;
-    
     /* Calculate total message size */
     size_t total_size = 0;
     for (int i = 0; i < NUM_FIELDS; i++) {
         total_size += msg->field_sizes[i];
     }
     
+    /* Request/response (-r) and framing (-F): the echoed request or the frame header */
+    /* is gathered ahead of the fields */
+    RequestHeader req;
+    FrameHeader frame;
+    struct iovec head_iov[NUM_FIELDS + 1];
+    head_iov[0].iov_base = g_framing ? (void*)&frame : (void*)&req;
+    head_iov[0].iov_len = g_framing ? sizeof(frame) : sizeof(req);
+    memcpy(&head_iov[1], iov, NUM_FIELDS * sizeof(struct iovec));
+    
+    /* Fd passing (-f): only the memfd crosses the socket, the client maps the message */
+    int memfd = -1;
+    if (g_fd_passing) {
+        memfd = create_message_memfd(iov, total_size);
+        if (memfd < 0) {
+            if (!g_store) free(iov);
+            release_message(msg);
+            close(client_fd);
+            free(targ);
+            return NULL;
+        }
+    }
+    
     Stats stats = {0, 0, 0.0};
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
@@ -166,10 +1055,74 @@ void* client_handler(void *arg) {
     int flag = 1;
     setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
     
+    /* SO_TIMESTAMPING must be enabled before the first byte so OPT_ID keys match byte counts */
+    TxTimestamps *tx_ts = NULL;
+    if (g_timestamping) {
+        tx_ts = (TxTimestamps*)calloc(1, sizeof(TxTimestamps));
+        if (!tx_ts || enable_tx_timestamps(client_fd) < 0) {
+            perror("SO_TIMESTAMPING setup failed - continuing without timestamps");
+            free(tx_ts);
+            tx_ts = NULL;
+        }
+    }
+    
+    /* Size distribution (-D): each message gathers its own size from the fields */
+    Workload wl;
+    SizeStats size_stats;
+    if (g_dist != DIST_FIXED) {
+        init_workload(&wl, thread_id);
+        memset(&size_stats, 0, sizeof(size_stats));
+    }
+    
+    /* Bidirectional (-x both): a second thread receives the upload while this one sends */
+    UploadArg upload = { client_fd, thread_id };
+    pthread_t upload_thread;
+    int uploading = g_direction == DIR_BOTH &&
+                    pthread_create(&upload_thread, NULL, upload_receiver, &upload) == 0;
+    
     /* Send messages continuously using sendmsg() */
     while (g_running) {
+        if (g_request_response && !read_request(client_fd, &req)) break;
+        size_t size = g_dist != DIST_FIXED ? next_message_size(&wl) : 0;
+        
+        struct timespec t_user;
+        if (tx_ts) clock_gettime(CLOCK_REALTIME, &t_user);
+        
         /* sendmsg with scatter-gather - no user-space copy needed */
-        ssize_t sent = sendmsg(client_fd, &mh, 0);
+        ssize_t sent;
+        if (g_dist != DIST_FIXED) {
+            struct timespec t0;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            size_t sizes[NUM_FIELDS];
+            struct iovec sized_iov[NUM_FIELDS + 1];
+            split_fields(size, sizes);
+            for (int i = 0; i < NUM_FIELDS; i++) {
+                sized_iov[i + 1].iov_base = msg->fields[i];
+                sized_iov[i + 1].iov_len = sizes[i];
+            }
+            if (g_framing) {
+                frame_stamp(&frame, size, stats.messages_sent, 0);
+                sized_iov[0] = head_iov[0];
+                sent = sendmsg_all(client_fd, sized_iov, NUM_FIELDS + 1, sizeof(frame) + size);
+            } else {
+                sent = sendmsg_all(client_fd, sized_iov + 1, NUM_FIELDS, size);
+            }
+            if (sent > 0) size_stats_record(&size_stats, size, &t0);
+        } else if (g_request_response) {
+            sent = sendmsg_all(client_fd, head_iov, NUM_FIELDS + 1, sizeof(req) + total_size);
+        } else if (g_fd_passing) {
+            /* A record per message, the first one carries the memfd. The message */
+            /* it makes available is what counts as sent */
+            frame_stamp(&frame, total_size, stats.messages_sent, FRAME_F_MEMFD);
+            sent = send_fd_record(client_fd, &frame, stats.messages_sent == 0 ? memfd : -1);
+            if (sent > 0) sent = total_size;
+        } else if (g_framing) {
+            frame_stamp(&frame, total_size, stats.messages_sent, 0);
+            sent = sendmsg_all(client_fd, head_iov, NUM_FIELDS + 1, sizeof(frame) + total_size);
+        } else {
+            /* sendmsg_all so a short send is never counted as a whole message */
+            sent = sendmsg_all(client_fd, iov, NUM_FIELDS, total_size);
+        }
         if (sent <= 0) {
             if (sent < 0 && errno != EPIPE && errno != ECONNRESET) {
                 perror("sendmsg error");
@@ -178,6 +1131,17 @@ void* client_handler(void *arg) {
         }
         stats.bytes_sent += sent;
         stats.messages_sent++;
+        
+        if (tx_ts) {
+            ts_track_send(tx_ts, stats.bytes_sent, &t_user);
+            drain_tx_timestamps(client_fd, tx_ts);
+        }
+    }
+    
+    /* SHUT_RD wakes the receiver if the client is still sending */
+    if (uploading) {
+        shutdown(client_fd, SHUT_RD);
+        pthread_join(upload_thread, NULL);
     }
     
     clock_gettime(CLOCK_MONOTONIC, &end);
@@ -192,34 +1156,519 @@ void* client_handler(void *arg) {
            throughput_gbps,
            stats.messages_sent,
            stats.elapsed_time);
+    if (tx_ts) print_tx_stages(thread_id, tx_ts);
+    if (g_dist != DIST_FIXED) print_size_stats(thread_id, &size_stats);
     
     /* Cleanup */
-    free(iov);
-    destroy_message(msg);
+    free(tx_ts);
+    if (memfd >= 0) close(memfd);
+    if (!g_store) free(iov);
+    release_message(msg);
     close(client_fd);
     free(targ);
     
     return NULL;
 }
 
+/* Raise the open file limit so event-loop mode can hold thousands of sockets */
+void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            perror("setrlimit RLIMIT_NOFILE failed");
+        }
+    }
+}
+
+/* Print statistics and release a connection owned by an event worker */
+void close_connection(EventWorker *w, Connection *conn) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    conn->stats.elapsed_time = (end.tv_sec - conn->start.tv_sec) +
+                               (end.tv_nsec - conn->start.tv_nsec) / 1e9;
+    
+    double throughput_gbps = (conn->stats.bytes_sent * 8.0) / (conn->stats.elapsed_time * 1e9);
+    printf("[Worker %d/Conn %d] Stats: %.2f GB sent, %.2f Gbps, %llu messages in %.2f seconds\n",
+           w->worker_id,
+           conn->conn_id,
+           conn->stats.bytes_sent / 1e9,
+           throughput_gbps,
+           conn->stats.messages_sent,
+           conn->stats.elapsed_time);
+    
+    epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn);
+}
+
+/* Send up to SEND_BUDGET messages on a writable socket with sendmsg() */
+/* Returns -1 if the connection should be closed */
+int send_ready(EventWorker *w, Connection *conn) {
+    struct iovec iov[NUM_FIELDS];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    
+    for (int i = 0; i < SEND_BUDGET; i++) {
+        mh.msg_iovlen = iovec_from_offset(w->iov, NUM_FIELDS, conn->offset, iov);
+        
+        ssize_t sent = sendmsg(conn->fd, &mh, 0);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == EINTR) continue;
+            if (errno != EPIPE && errno != ECONNRESET) {
+                perror("sendmsg error");
+            }
+            return -1;
+        }
+        if (sent == 0) return -1;
+        
+        conn->stats.bytes_sent += sent;
+        conn->offset += sent;
+        if (conn->offset < w->total_size) return 0;  /* Partial send: wait for EPOLLOUT */
+        conn->offset = 0;
+        conn->stats.messages_sent++;
+    }
+    return 0;
+}
+
+/* Event-loop worker thread: multiplexes its connections with epoll */
+void* event_worker(void *arg) {
+    EventWorker *w = (EventWorker*)arg;
+    place_thread(w->worker_id);
+    struct epoll_event events[MAX_EVENTS];
+    
+    while (g_running) {
+        int n = epoll_wait(w->epoll_fd, events, MAX_EVENTS, 100);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            Connection *conn = (Connection*)events[i].data.ptr;
+            
+            if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                close_connection(w, conn);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && send_ready(w, conn) < 0) {
+                close_connection(w, conn);
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+/* Undo a start_event_workers() that failed at worker failed: stop and join */
+/* the workers already running, then free every worker's epoll set and message */
+void unwind_event_workers(EventWorker *workers, int failed) {
+    bind_memory(-1);
+    g_running = 0;      /* Startup failed, so the server exits anyway */
+    for (int i = 0; i <= failed; i++) {
+        EventWorker *w = &workers[i];
+        if (i < failed) pthread_join(w->thread, NULL);
+        if (w->epoll_fd >= 0) close(w->epoll_fd);
+        if (!g_store) free(w->iov);
+        if (w->msg) release_message(w->msg);
+    }
+    free(workers);
+}
+
+/* Create the event workers, each with its own epoll set and message */
+EventWorker* start_event_workers(int count) {
+    EventWorker *workers = (EventWorker*)calloc(count, sizeof(EventWorker));
+    if (!workers) {
+        perror("Failed to allocate event workers");
+        return NULL;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        EventWorker *w = &workers[i];
+        w->worker_id = i;
+        w->epoll_fd = epoll_create1(0);
+        if (w->epoll_fd < 0) {
+            perror("epoll_create1 failed");
+            unwind_event_workers(workers, i);
+            return NULL;
+        }
+        
+        /* Allocate the worker's message on the node chosen for its CPU */
+        bind_memory(placement_cpu(i));
+        w->msg = acquire_message();
+        if (!w->msg) {
+            unwind_event_workers(workers, i);
+            return NULL;
+        }
+        w->iov = g_store ? g_store->iov : prepare_iovec(w->msg);
+        if (!w->iov) {
+            perror("Failed to prepare iovec");
+            unwind_event_workers(workers, i);
+            return NULL;
+        }
+        for (int j = 0; j < NUM_FIELDS; j++) {
+            w->total_size += w->msg->field_sizes[j];
+        }
+        
+        bind_memory(-1);
+        
+        if (pthread_create(&w->thread, NULL, event_worker, w) != 0) {
+            perror("Failed to create event worker");
+            unwind_event_workers(workers, i);
+            return NULL;
+        }
+    }
+    
+    return workers;
+}
+
+/* Hand an accepted socket to an event worker's epoll set */
+int add_connection(EventWorker *w, int client_fd, int conn_id,
+                   struct sockaddr_in *client_addr) {
+    Connection *conn = (Connection*)calloc(1, sizeof(Connection));
+    if (!conn) {
+        perror("Failed to allocate connection");
+        return -1;
+    }
+    
+    int flags = fcntl(client_fd, F_GETFL, 0);
+    fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+    
+    /* Set TCP_NODELAY to disable Nagle's algorithm */
+    int flag = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    
+    conn->fd = client_fd;
+    conn->conn_id = conn_id;
+    conn->client_addr = *client_addr;
+    clock_gettime(CLOCK_MONOTONIC, &conn->start);
+    
+    /* Level-triggered EPOLLOUT keeps the per-event send budget fair */
+    struct epoll_event ev;
+    ev.events = EPOLLOUT | EPOLLRDHUP;
+    ev.data.ptr = conn;
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+        perror("epoll_ctl ADD failed");
+        free(conn);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* Create the AF_UNIX listening socket for -u, replacing any stale socket file */
+int open_unix_listener(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(g_unix_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", g_unix_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, g_unix_path);
+    
+    int fd = socket(AF_UNIX, g_unix_type, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        return -1;
+    }
+    
+    unlink(g_unix_path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind failed");
+        close(fd);
+        return -1;
+    }
+    
+    if (listen(fd, BACKLOG) < 0) {
+        perror("listen failed");
+        close(fd);
+        unlink(g_unix_path);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* Create a listening socket; all listeners on the port join one SO_REUSEPORT group */
+int open_listener(int port) {
+    if (g_unix_path) return open_unix_listener();
+    
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        return -1;
+    }
+    
+    /* Set socket options */
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    
+    /* Bind to address */
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+    
+    if (bind(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("bind failed");
+        close(fd);
+        return -1;
+    }
+    
+    /* Listen for connections */
+    if (listen(fd, BACKLOG) < 0) {
+        perror("listen failed");
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* Reuseport CBPF: pick the first shard whose workers run on the CPU that processed */
+/* the SYN; returning an index past the group makes the kernel fall back to the hash */
+int attach_cpu_steering(int listen_fd) {
+    int len = 2 * g_shards + 2;
+    struct sock_filter *code = (struct sock_filter*)malloc(len * sizeof(struct sock_filter));
+    if (!code) {
+        perror("Failed to allocate steering program");
+        return -1;
+    }
+    
+    int n = 0;
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+    for (int i = 0; i < g_shards; i++) {
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, placement_cpu(i), 0, 1);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, i);
+    }
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    
+    struct sock_fprog prog = { .len = (unsigned short)n, .filter = code };
+    int ret = setsockopt(listen_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+    if (ret < 0) perror("SO_ATTACH_REUSEPORT_CBPF failed");
+    free(code);
+    return ret;
+}
+
+/* Shard worker: accepts on its shard's listener and serves each connection inline, */
+/* so there is no shared accept queue and no pthread_create() per connection */
+void* shard_worker(void *arg) {
+    ShardWorker *w = (ShardWorker*)arg;
+    int served = 0;
+    
+    place_thread(w->shard_id);
+    
+    while (g_running) {
+        struct sockaddr_in client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        
+        int client_fd = accept(w->listen_fd, (struct sockaddr*)&client_addr, &addr_len);
+        if (client_fd < 0) {
+            if (errno == EINTR || !g_running) continue;
+            perror("accept failed");
+            continue;
+        }
+        
+        ThreadArg *targ = (ThreadArg*)malloc(sizeof(ThreadArg));
+        if (!targ) {
+            perror("Failed to allocate thread argument");
+            close(client_fd);
+            continue;
+        }
+        
+        /* With steering, the RX softirq CPU should be the one this worker is pinned to */
+        if (g_steer_cpu) {
+            int rx_cpu = -1;
+            socklen_t len = sizeof(rx_cpu);
+            getsockopt(client_fd, SOL_SOCKET, SO_INCOMING_CPU, &rx_cpu, &len);
+            printf("[Shard %d] Connection from RX CPU %d, served on CPU %d\n",
+                   w->shard_id, rx_cpu, sched_getcpu());
+        }
+        
+        /* Worker w of W numbers its connections w, w+W, w+2W, ... */
+        int total = g_shards * g_shard_workers;
+        targ->client_fd = client_fd;
+        targ->thread_id = w->worker_id + served++ * total;
+        targ->client_addr = client_addr;
+        
+        client_handler(targ);
+    }
+    
+    return NULL;
+}
+
+/* Open every shard's listener, then start the workers with SIGINT blocked */
+ShardWorker* start_shards(int port, int count) {
+    ShardWorker *shards = (ShardWorker*)calloc(count, sizeof(ShardWorker));
+    if (!shards) {
+        perror("Failed to allocate shard workers");
+        return NULL;
+    }
+    
+    /* All listeners join the group before the first accept, in shard order */
+    for (int i = 0; i < count; i++) {
+        shards[i].worker_id = i;
+        shards[i].shard_id = i / g_shard_workers;
+        if (i % g_shard_workers == 0) {
+            shards[i].listen_fd = open_listener(port);
+            if (shards[i].listen_fd < 0) return NULL;
+        } else {
+            shards[i].listen_fd = shards[i - 1].listen_fd;
+        }
+    }
+    
+    /* The program is shared by the whole group, socket index = shard index */
+    if (g_steer_cpu && attach_cpu_steering(shards[0].listen_fd) < 0) return NULL;
+    
+    /* SIGINT stays blocked in every thread and main() collects it with sigwait() */
+    sigset_t sigint;
+    sigemptyset(&sigint);
+    sigaddset(&sigint, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &sigint, NULL);
+    
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&shards[i].thread, NULL, shard_worker, &shards[i]) != 0) {
+            perror("Failed to create shard worker");
+            return NULL;
+        }
+    }
+    
+    return shards;
+}
+
 void print_usage(const char *prog) {
-    fprintf(stderr, "Usage: %s [-p port] [-s message_size]\n", prog);
+    fprintf(stderr, "Usage: %s [-p port] [-u [seqpacket:]path] [-s message_size] [-D dist] [-F] [-f] [-x down|up|both] [-w listeners[:workers]] [-b] [-S] [-e workers] [-r] [-T] [-c cpus] [-P spread|pack] [-N same|cross]\n", prog);
     fprintf(stderr, "  -p port         : Server port (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -u path         : Listen on an AF_UNIX SOCK_STREAM socket at path instead of\n");
+    fprintf(stderr, "                    TCP, or SOCK_SEQPACKET with a seqpacket: prefix\n");
     fprintf(stderr, "  -s message_size : Message size in bytes (default: %d)\n", DEFAULT_MSG_SIZE);
+    fprintf(stderr, "  -D dist         : Message sizes: fixed, uniform:MIN:MAX, bimodal:SMALL:LARGE:P,\n");
+    fprintf(stderr, "                    lognormal:MEDIAN:SIGMA, pareto:MIN:ALPHA (clamped to -s)\n");
+    fprintf(stderr, "                    or trace:FILE with \"size [gap_us]\" lines (default: fixed)\n");
+    fprintf(stderr, "  -F              : Frame every message with a length/seq/timestamp header\n");
+    fprintf(stderr, "                    (streaming thread-per-connection mode, client needs -F)\n");
+    fprintf(stderr, "  -f              : Pass a sealed memfd gathered from the fields once with\n");
+    fprintf(stderr, "                    SCM_RIGHTS, then send a record per message (needs -u,\n");
+    fprintf(stderr, "                    streaming thread-per-connection mode, client needs -f)\n");
+    fprintf(stderr, "  -x dir          : down (send), up (receive the client's upload with\n");
+    fprintf(stderr, "                    recvmsg() into the message fields) or both at once (default: down)\n");
+    fprintf(stderr, "  -w N[:K]        : N SO_REUSEPORT listeners, each with K pre-spawned workers\n");
+    fprintf(stderr, "                    (default: 1) that accept and serve one connection at a time\n");
+    fprintf(stderr, "  -b              : Steer each connection to the shard pinned to the CPU\n");
+    fprintf(stderr, "                    that received it (reuseport CBPF, default -w: one per CPU)\n");
+    fprintf(stderr, "  -S              : Send every connection's message from one shared, read-only\n");
+    fprintf(stderr, "                    store on 2 MB pages instead of a per-connection copy\n");
+    fprintf(stderr, "  -e workers      : Event-loop mode with N epoll worker threads\n");
+    fprintf(stderr, "                    (default: one thread per connection)\n");
+    fprintf(stderr, "  -r              : Request/response mode: send one message per client\n");
+    fprintf(stderr, "                    request, echoing its header (thread mode only)\n");
+    fprintf(stderr, "  -T              : SO_TIMESTAMPING breakdown of each send into\n");
+    fprintf(stderr, "                    user->qdisc, qdisc->wire, wire->ack (thread mode only)\n");
+    fprintf(stderr, "  -c cpus         : Pin connection/worker threads round-robin to a CPU list\n");
+    fprintf(stderr, "                    such as 0-3,8 (default: unpinned)\n");
+    fprintf(stderr, "  -P policy       : spread (one per physical core first) or pack (SMT siblings)\n");
+    fprintf(stderr, "  -N node         : same or cross: message buffers on the thread's NUMA node\n");
+    fprintf(stderr, "                    or on the next node\n");
 }
 
 int main(int argc, char *argv[]) {
     int port = DEFAULT_PORT;
     int opt;
+    const char *cpu_list = NULL;
+    int use_store = 0;
+    const char *dist_spec = NULL;
     
-    while ((opt = getopt(argc, argv, "p:s:h")) != -1) {
+    while ((opt = getopt(argc, argv, "p:u:s:D:w:bSFfx:e:rTc:P:N:h")) != -1) {
         switch (opt) {
             case 'p':
                 port = atoi(optarg);
                 break;
+            case 'u':
+                /* [stream:|seqpacket:]PATH */
+                if (strncmp(optarg, "seqpacket:", 10) == 0) {
+                    g_unix_type = SOCK_SEQPACKET;
+                    g_unix_path = optarg + 10;
+                } else {
+                    g_unix_path = strncmp(optarg, "stream:", 7) == 0 ? optarg + 7 : optarg;
+                }
+                break;
             case 's':
                 g_message_size = atoi(optarg);
                 break;
+            case 'b':
+                g_steer_cpu = 1;
+                break;
+            case 'S':
+                use_store = 1;
+                break;
+            case 'D':
+                dist_spec = optarg;
+                break;
+            case 'F':
+                g_framing = 1;
+                break;
+            case 'f':
+                g_fd_passing = 1;
+                break;
+            case 'x':
+                if (strcmp(optarg, "down") == 0) {
+                    g_direction = DIR_DOWN;
+                } else if (strcmp(optarg, "up") == 0) {
+                    g_direction = DIR_UP;
+                } else if (strcmp(optarg, "both") == 0) {
+                    g_direction = DIR_BOTH;
+                } else {
+                    fprintf(stderr, "Unknown direction: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'w': {
+                char *sep = strchr(optarg, ':');
+                g_shards = atoi(optarg);
+                if (sep) g_shard_workers = atoi(sep + 1);
+                break;
+            }
+            case 'e':
+                g_event_workers = atoi(optarg);
+                break;
+            case 'r':
+                g_request_response = 1;
+                break;
+            case 'T':
+                g_timestamping = 1;
+                break;
+            case 'c':
+                cpu_list = optarg;
+                break;
+            case 'P':
+                if (strcmp(optarg, "spread") == 0) {
+                    g_place_policy = PLACE_SPREAD;
+                } else if (strcmp(optarg, "pack") == 0) {
+                    g_place_policy = PLACE_PACK;
+                } else {
+                    fprintf(stderr, "Unknown placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'N':
+                if (strcmp(optarg, "same") == 0) {
+                    g_mem_policy = MEM_SAME;
+                } else if (strcmp(optarg, "cross") == 0) {
+                    g_mem_policy = MEM_CROSS;
+                } else {
+                    fprintf(stderr, "Unknown memory placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
             case 'h':
             default:
                 print_usage(argv[0]);
@@ -227,50 +1676,148 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    /* Set up signal handlers */
-    signal(SIGINT, signal_handler);
-    signal(SIGPIPE, SIG_IGN);
+    /* Steering needs every shard pinned, default to all CPUs we may run on */
+    if (g_steer_cpu && g_place_policy == PLACE_NONE && !cpu_list) g_place_policy = PLACE_LIST;
+    if (setup_placement(cpu_list) < 0) return 1;
     
-    /* Create socket */
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        perror("socket creation failed");
+    /* After getopt so a trace can raise -s to its largest message */
+    if (dist_spec && parse_dist(dist_spec) < 0) return 1;
+    if (g_steer_cpu && g_shards == 0) g_shards = g_cpu_count;
+    
+    if (g_shards < 0 || g_shard_workers < 1) {
+        fprintf(stderr, "-w needs a positive listener and worker count\n");
         return 1;
     }
     
-    /* Set socket options */
-    int reuse = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    if (g_dist != DIST_FIXED && (g_event_workers > 0 || g_request_response)) {
+        fprintf(stderr, "-D is only supported in streaming thread-per-connection mode\n");
+        return 1;
+    }
     
-    /* Bind to address */
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(port);
+    if (g_direction != DIR_DOWN && (g_event_workers > 0 || g_request_response)) {
+        fprintf(stderr, "-x up/both is only supported in streaming thread-per-connection mode\n");
+        return 1;
+    }
     
-    if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("bind failed");
-        close(server_fd);
+    if (g_framing && (g_event_workers > 0 || g_request_response)) {
+        fprintf(stderr, "-F is only supported in streaming thread-per-connection mode\n");
         return 1;
     }
     
-    /* Listen for connections */
-    if (listen(server_fd, BACKLOG) < 0) {
-        perror("listen failed");
-        close(server_fd);
+    if (g_shards > 0 && g_event_workers > 0) {
+        fprintf(stderr, "-w and -e cannot be combined\n");
+        return 1;
+    }
+    
+    if ((g_request_response || g_timestamping) && g_event_workers > 0) {
+        fprintf(stderr, "-r and -T are only supported in thread-per-connection mode\n");
+        return 1;
+    }
+    
+    if (g_unix_path && (g_shards > 0 || g_timestamping)) {
+        fprintf(stderr, "-u cannot be combined with -w/-b (SO_REUSEPORT) or -T (no TX timestamps on AF_UNIX)\n");
         return 1;
     }
     
+    if (g_fd_passing && (!g_unix_path || g_event_workers > 0 || g_request_response || g_framing ||
+                         g_dist != DIST_FIXED || g_direction != DIR_DOWN)) {
+        fprintf(stderr, "-f needs -u and streaming thread-per-connection mode "
+                "(not -e, -r, -F, -D or -x up/both)\n");
+        return 1;
+    }
+    
+    /* Set up signal handlers */
+    signal(SIGINT, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+    
+    /* Built before any worker or connection so they all see the same pages */
+    if (use_store) {
+        g_store = create_message_store(g_message_size);
+        if (!g_store) return 1;
+    }
+    
+    /* Create the listening socket, or one per shard worker */
+    int server_fd = -1;
+    ShardWorker *shards = NULL;
+    if (g_shards > 0) {
+        shards = start_shards(port, g_shards * g_shard_workers);
+        if (!shards) return 1;
+    } else {
+        server_fd = open_listener(port);
+        if (server_fd < 0) return 1;
+    }
+    
     printf("A2 One-Copy Server started on port %d (message size: %d bytes)\n",
            port, g_message_size);
-    printf("Using sendmsg() with scatter-gather I/O\n");
-    printf("Copy eliminated: User-space buffer serialization\n");
+    if (g_unix_path) {
+        printf("Transport: AF_UNIX %s at %s (-p unused)\n",
+               g_unix_type == SOCK_SEQPACKET ? "SOCK_SEQPACKET" : "SOCK_STREAM", g_unix_path);
+    }
+    if (g_fd_passing) {
+        printf("Using fd passing: fields gathered into a sealed memfd with pwritev(), sent once with\n");
+        printf("SCM_RIGHTS, %zu byte record per message\n", sizeof(FrameHeader));
+    } else {
+        printf("Using sendmsg() with scatter-gather I/O\n");
+        printf("Copy eliminated: User-space buffer serialization\n");
+    }
+    
+    EventWorker *workers = NULL;
+    if (g_event_workers > 0) {
+        raise_fd_limit();
+        workers = start_event_workers(g_event_workers);
+        if (!workers) {
+            close(server_fd);
+            return 1;
+        }
+        printf("Event-loop mode: %d epoll worker threads\n", g_event_workers);
+    }
+    if (g_request_response) {
+        printf("Request/response mode: one %d byte response per request\n", g_message_size);
+    }
+    if (g_timestamping) {
+        printf("SO_TIMESTAMPING: per-send SCHED/SND/ACK stage breakdown\n");
+    }
+    if (g_shards > 0) {
+        printf("Sharded listeners: %d SO_REUSEPORT listeners x %d workers, no per-connection threads\n",
+               g_shards, g_shard_workers);
+    }
+    if (g_direction != DIR_DOWN) {
+        printf("Direction: %s, uploads received with recvmsg() into the message fields\n",
+               g_direction == DIR_UP ? "up" : "both");
+    }
+    if (g_framing) {
+        printf("Framing: %zu byte header (length, flags, seq, send timestamp) per message\n",
+               sizeof(FrameHeader));
+    }
+    if (g_dist != DIST_FIXED) {
+        printf("Size distribution: %s, up to %d bytes, per-size breakdown per connection\n",
+               g_dist_name, g_message_size);
+    }
+    if (g_store) {
+        printf("Message store: %zu bytes in one %zu KB %s mapping, shared by all connections\n",
+               g_store->size, g_store->map_size / 1024, g_store->backing);
+    }
+    if (g_steer_cpu) {
+        printf("CPU steering: SO_ATTACH_REUSEPORT_CBPF on SKF_AD_CPU, shard i pinned to CPU i of the list\n");
+    }
+    if (g_cpu_count > 0) {
+        printf("Placement: %s over %d CPUs, %d NUMA node(s)\n",
+               g_placement, g_cpu_count, g_node_count);
+    }
     printf("Press Ctrl+C to stop\n\n");
     
     int thread_id = 0;
     
+    /* Sharded mode: the workers accept, main() just waits for Ctrl+C */
+    if (shards) {
+        sigset_t sigint;
+        sigemptyset(&sigint);
+        sigaddset(&sigint, SIGINT);
+        int sig;
+        sigwait(&sigint, &sig);
+        g_running = 0;
+    }
+    
     /* Accept connections and spawn threads */
     while (g_running) {
         struct sockaddr_in client_addr;
@@ -283,6 +1830,16 @@ int main(int argc, char *argv[]) {
             continue;
         }
         
+        /* Event-loop mode: distribute connections round-robin over workers */
+        if (workers) {
+            int conn_id = thread_id++;
+            if (add_connection(&workers[conn_id % g_event_workers], client_fd,
+                               conn_id, &client_addr) < 0) {
+                close(client_fd);
+            }
+            continue;
+        }
+        
         /* Create thread argument */
         ThreadArg *targ = (ThreadArg*)malloc(sizeof(ThreadArg));
         if (!targ) {
@@ -311,7 +1868,29 @@ int main(int argc, char *argv[]) {
     }
     
     printf("\nServer shutting down...\n");
-    close(server_fd);
+    if (shards) {
+        /* shutdown() wakes the blocked accept() calls, close() alone does not */
+        int total = g_shards * g_shard_workers;
+        for (int i = 0; i < total; i += g_shard_workers) {
+            shutdown(shards[i].listen_fd, SHUT_RDWR);
+        }
+        for (int i = 0; i < total; i++) {
+            pthread_join(shards[i].thread, NULL);
+        }
+        for (int i = 0; i < total; i += g_shard_workers) {
+            close(shards[i].listen_fd);
+        }
+        free(shards);
+    } else {
+        close(server_fd);
+        if (g_unix_path) unlink(g_unix_path);
+    }
+    
+    if (workers) {
+        for (int i = 0; i < g_event_workers; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
     
     return 0;
 }
@@ -14,6 +14,19 @@
  * 4. Kernel sends completion notification via error queue
  * 5. Application must poll error queue before reusing buffer
  * 
+ * Each connection sends from a ring of K message slots. A slot is only
+ * rewritten with new data once every MSG_ZEROCOPY send that referenced
+ * it has been acknowledged on the error queue; the handler blocks in
+ * poll(POLLERR) when the next slot is still in flight.
+ * 
+ * With -z auto the handler picks plain copy or MSG_ZEROCOPY per send.
+ * It learns the cost per byte of each path per message-size class, and
+ * it watches completion feedback: if most recent completions carry
+ * SO_EE_CODE_ZEROCOPY_COPIED (e.g. loopback), zero-copy is pure
+ * overhead and is only probed occasionally. The send-to-completion
+ * latency bounds the zero-copy rate at one slot ring per latency, and
+ * that bound is charged to the zero-copy cost.
+ * 
  * Author: Aayush Amritesh (MT25057)
  */
 
@@ -25,19 +38,53 @@
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <time.h>
 #include <signal.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <linux/filter.h>
+#include <stdint.h>
+#include <math.h>
 #include <poll.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
 
 #ifndef SO_ZEROCOPY
 #define SO_ZEROCOPY 60
 #endif
 
+#ifndef TCP_ZEROCOPY_RECEIVE
+#define TCP_ZEROCOPY_RECEIVE 35
+#endif
+#define ZC_COPYBUF_SIZE 65536   /* Upload receive (-x): copy buffer for the unmappable tail */
+
+/* Kernel ABI of getsockopt(TCP_ZEROCOPY_RECEIVE), including the copybuf */
+/* fields (Linux 5.11+) that glibc's older struct definition lacks */
+typedef struct {
+    uint64_t address;           /* in: address of mapping */
+    uint32_t length;            /* in/out: bytes to map / bytes mapped */
+    uint32_t recv_skip_hint;    /* out: bytes that must be read with recv() */
+    uint32_t inq;               /* out: bytes left in the receive queue */
+    int32_t err;                /* out: socket error */
+    uint64_t copybuf_address;   /* in: buffer for the unmappable part */
+    int32_t copybuf_len;        /* in/out: copybuf size / bytes copied */
+    uint32_t flags;
+    uint64_t msg_control;
+    uint64_t msg_controllen;
+    uint32_t msg_flags;
+    uint32_t reserved;
+} ZerocopyReceive;
+
 #ifndef MSG_ZEROCOPY
 #define MSG_ZEROCOPY 0x4000000
 #endif
@@ -45,10 +92,49 @@
 #define DEFAULT_PORT 8083
 #define NUM_FIELDS 8
 #define DEFAULT_MSG_SIZE 1024
+#define DEFAULT_SLOTS 8
+#define ZC_ID_MAP 4096      /* Max zerocopy send IDs tracked in flight */
+#define ZC_DRAIN_IDLE_MS 5000   /* No completion for this long: stop waiting at close */
+#define SIZE_CLASSES 32     /* log2 message-size classes for the adaptive policy */
+#define BOOTSTRAP_SAMPLES 8 /* Sends per path before trusting the estimates */
+#define EXPLORE_INTERVAL 64 /* Every Nth send tries the currently losing path */
+#define COPIED_PROBE_INTERVAL 1024
+#define EWMA_ALPHA 0.05
+
+/* Zero-copy policies (-z) */
+#define ZC_MODE_ALWAYS 0
+#define ZC_MODE_NEVER 1
+#define ZC_MODE_AUTO 2
 #define BACKLOG 128
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+/* Error queue control buffer: IP_RECVERR (with offender address) plus SCM_TIMESTAMPING */
+#define TS_CONTROL_SIZE (CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in)) + \
+                         CMSG_SPACE(sizeof(struct scm_timestamping)))
+#define MAX_EVENTS 256
+#define SEND_BUDGET 16      /* Messages sent per writable event before yielding */
 
 /* Global configuration */
 static int g_message_size = DEFAULT_MSG_SIZE;
+static int g_event_workers = 0;    /* 0 = thread-per-connection mode */
+static int g_request_response = 0;
+static int g_timestamping = 0;
+static int g_slots = DEFAULT_SLOTS;
+static int g_huge_slots = 0;      /* -g: all slots in one 2 MB page mapping */
+static int g_zc_mode = ZC_MODE_ALWAYS;
+static int g_shards = 0;          /* 0 = single listener, accept() in main() */
+static int g_shard_workers = 1;   /* Workers accepting on each shard's listener */
+static int g_steer_cpu = 0;       /* -b: steer connections to the shard on the SYN's CPU */
+static int g_framing = 0;
+
+/* Data direction (-x) */
+#define DIR_DOWN 0      /* Server sends, client receives (default) */
+#define DIR_UP 1        /* Client sends, server receives */
+#define DIR_BOTH 2      /* Both at once on each connection */
+static int g_direction = DIR_DOWN;
+
+/* AF_UNIX transport (-u) */
+static const char *g_unix_path = NULL;     /* NULL = TCP on -p port */
+static int g_unix_type = SOCK_STREAM;      /* or SOCK_SEQPACKET */
 static volatile int g_running = 1;
 
 /* Message structure with 8 dynamically allocated string fields */
@@ -57,6 +143,19 @@ typedef struct {
     size_t field_sizes[NUM_FIELDS];
 } Message;
 
+/* Shared message store (-S): one immutable copy of the message, built once at */
+/* startup on 2 MB pages, that every connection sends from */
+typedef struct {
+    Message msg;            /* fields[] point into base, back to back */
+    struct iovec iov[NUM_FIELDS];   /* Shared scatter-gather view of the fields */
+    char *base;
+    size_t size;            /* Message bytes */
+    size_t map_size;        /* Mapping size, a multiple of HUGE_PAGE_SIZE */
+    const char *backing;    /* "hugetlb", "thp" or "4k" */
+} MessageStore;
+
+static MessageStore *g_store = NULL;
+
 /* Thread argument structure */
 typedef struct {
     int client_fd;
@@ -64,14 +163,484 @@ typedef struct {
     struct sockaddr_in client_addr;
 } ThreadArg;
 
+/* Sharded listener worker (-w) */
+typedef struct {
+    pthread_t thread;
+    int worker_id;
+    int shard_id;
+    int listen_fd;      /* The shard's own SO_REUSEPORT listener */
+} ShardWorker;
+
+/* Request/response mode (-r): the client sends this header as its request */
+/* and the server echoes it at the start of the response */
+typedef struct {
+    uint64_t seq;
+    uint64_t send_ts_ns;    /* Client CLOCK_MONOTONIC time when the request was sent */
+} RequestHeader;
+
+/* Frame header (-F): precedes every streamed message, same layout in every binary */
+#define FRAME_F_ZEROCOPY 0x1    /* Payload was sent with MSG_ZEROCOPY */
+typedef struct {
+    uint32_t length;        /* Payload bytes following the header */
+    uint32_t flags;         /* FRAME_F_* */
+    uint64_t seq;           /* Message number on this connection, from 0 */
+    uint64_t send_ts_ns;    /* Sender CLOCK_MONOTONIC time when the send was issued */
+} FrameHeader;
+
+/* TX timestamp stages reported by SO_TIMESTAMPING (-T) */
+#define STAGE_USER_QDISC 0  /* send() call -> SCHED (entered the qdisc) */
+#define STAGE_QDISC_WIRE 1  /* SCHED -> SND (handed to the driver) */
+#define STAGE_WIRE_ACK 2    /* SND -> ACK (peer acknowledged the last byte) */
+#define NUM_STAGES 3
+#define TS_PENDING 4096     /* Sends awaiting their TX timestamps */
+
+/* Sends awaiting TX timestamps, keyed by the OPT_ID byte offset of their last byte */
+typedef struct {
+    uint32_t id[TS_PENDING];
+    struct timespec stamp[TS_PENDING][NUM_STAGES];  /* user, sched, snd (CLOCK_REALTIME) */
+    unsigned long long head, tail;
+    double stage_sum[NUM_STAGES];
+    unsigned long long stage_count[NUM_STAGES];
+} TxTimestamps;
+
 /* Statistics structure */
 typedef struct {
     unsigned long long bytes_sent;
     unsigned long long messages_sent;
     unsigned long long completions_received;
+    unsigned long long stalls;          /* Sends that waited for a free slot */
+    double stall_time_us;
+    unsigned long long zc_ids_completed;
+    unsigned long long zc_ids_copied;   /* Completed with SO_EE_CODE_ZEROCOPY_COPIED */
+    double copied_ratio;                /* Per-ID EWMA of the copied share, recent IDs dominate */
+    double completion_latency_us;       /* EWMA of send-to-completion time */
+    unsigned long long zc_sends;        /* sendmsg(MSG_ZEROCOPY) calls that queued data */
+    unsigned long long page_spans;      /* Pages those calls referenced, see pages_spanned() */
+    double zc_send_time_ns;             /* Time spent inside those calls */
+    TxTimestamps *tx_ts;                /* -T stage tracking, NULL when disabled */
     double elapsed_time;
 } Stats;
 
+/* Per-connection adaptive copy-vs-zerocopy state (-z auto) */
+typedef struct {
+    double cost_ns_per_byte[2][SIZE_CLASSES];  /* [0] = copy, [1] = zerocopy */
+    unsigned long long samples[2][SIZE_CLASSES];
+    unsigned long long sends[2];
+    unsigned long long decisions;
+    int window;                 /* Zerocopy sends in flight before the sender stalls */
+} ZcPolicy;
+
+/* Ring of K message slots gated on zero-copy completions */
+/*
+ * Every MSG_ZEROCOPY sendmsg() that queues data is assigned the next
+ * 32-bit ID by the kernel; completions arrive as [ee_info, ee_data]
+ * ID ranges. id_slot maps in-flight IDs back to the slot they read
+ * from, and a slot may be rewritten only when its outstanding count
+ * drops to zero.
+ */
+typedef struct {
+    Message **slots;
+    RequestHeader *headers;         /* Echoed request per slot (-r), pinned like the payload */
+    FrameHeader *frames;            /* Frame header per slot (-F), pinned like the payload */
+    char *region;                   /* -g: mapping holding every slot's fields */
+    size_t region_size;
+    size_t page_size;               /* Page size backing the payload */
+    int slot_count;
+    int next_slot;
+    unsigned int *outstanding;      /* In-flight send IDs per slot */
+    int id_slot[ZC_ID_MAP];
+    struct timespec id_sent[ZC_ID_MAP];
+    unsigned int next_id;           /* ID the kernel assigns to the next send */
+    unsigned int ids_in_flight;
+} ZcRing;
+
+/* Per-connection state for event-loop mode */
+typedef struct {
+    int fd;
+    int conn_id;
+    int zerocopy_enabled;
+    size_t offset;          /* Bytes of the current message already sent */
+    int tx_parked;          /* ENOBUFS: EPOLLOUT off until EPOLLERR brings completions */
+    Stats stats;
+    struct timespec start;
+    struct sockaddr_in client_addr;
+} Connection;
+
+/* Event-loop worker: owns one epoll set and one message/iovec pair */
+/* The message is never modified, so in-flight zero-copy sends may share it */
+typedef struct {
+    int worker_id;
+    int epoll_fd;
+    pthread_t thread;
+    Message *msg;
+    struct iovec *iov;
+    size_t total_size;
+} EventWorker;
+
+/* Thread placement (-c / -P / -N) */
+#define PLACE_NONE 0
+#define PLACE_LIST 1        /* CPUs in the order given with -c */
+#define PLACE_SPREAD 2      /* One CPU per physical core before any SMT sibling */
+#define PLACE_PACK 3        /* Fill the SMT siblings of a core before the next core */
+#define MEM_ANY 0
+#define MEM_SAME 1          /* Buffers on the NUMA node of the thread's CPU */
+#define MEM_CROSS 2         /* Buffers on the next NUMA node, across the interconnect */
+#define MAX_NODES 64
+
+static int g_place_policy = PLACE_NONE;
+static int g_mem_policy = MEM_ANY;
+static int g_cpus[CPU_SETSIZE];     /* CPUs in placement order, used round-robin */
+static int g_cpu_count = 0;
+static int g_node_count = 1;
+static char g_placement[64] = "none";
+
+/* Parse a CPU list such as "0-3,8,10-11", returns the number of CPUs or -1 */
+int parse_cpu_list(const char *list, int *cpus, int max) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return -1;
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && count < max; c++) {
+            cpus[count++] = (int)c;
+        }
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+        else break;
+    }
+    return count;
+}
+
+/* Lowest-numbered SMT sibling of a CPU, identifying its physical core */
+int core_of_cpu(int cpu) {
+    char path[128], line[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return cpu;
+    int siblings[CPU_SETSIZE];
+    int n = fgets(line, sizeof(line), f) ? parse_cpu_list(line, siblings, CPU_SETSIZE) : -1;
+    fclose(f);
+    return n > 0 ? siblings[0] : cpu;
+}
+
+/* NUMA node a CPU belongs to (0 if the topology is not exported) */
+int node_of_cpu(int cpu) {
+    char path[128];
+    for (int node = 0; node < g_node_count; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+    return 0;
+}
+
+/* Build the CPU order from -c / -P and count NUMA nodes */
+int setup_placement(const char *cpu_list) {
+    char path[64];
+    g_node_count = 0;
+    while (g_node_count < MAX_NODES) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", g_node_count);
+        if (access(path, F_OK) != 0) break;
+        g_node_count++;
+    }
+    if (g_node_count == 0) g_node_count = 1;
+    
+    if (cpu_list) {
+        g_cpu_count = parse_cpu_list(cpu_list, g_cpus, CPU_SETSIZE);
+        if (g_cpu_count <= 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+            return -1;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    } else if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        /* Default to every CPU this process may run on */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) g_cpus[g_cpu_count++] = c;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    }
+    
+    if (g_place_policy == PLACE_SPREAD || g_place_policy == PLACE_PACK) {
+        /* Sort key: spread = (sibling rank, core), pack = (core, sibling rank) */
+        int core[CPU_SETSIZE], rank[CPU_SETSIZE];
+        for (int i = 0; i < g_cpu_count; i++) {
+            core[i] = core_of_cpu(g_cpus[i]);
+            rank[i] = 0;
+            for (int j = 0; j < i; j++) {
+                if (core[j] == core[i]) rank[i]++;
+            }
+        }
+        for (int i = 1; i < g_cpu_count; i++) {
+            for (int j = i; j > 0; j--) {
+                int a = j - 1, b = j;
+                int swap = g_place_policy == PLACE_SPREAD ?
+                    (rank[a] > rank[b] || (rank[a] == rank[b] && core[a] > core[b])) :
+                    (core[a] > core[b] || (core[a] == core[b] && rank[a] > rank[b]));
+                if (!swap) break;
+                int t;
+                t = g_cpus[a]; g_cpus[a] = g_cpus[b]; g_cpus[b] = t;
+                t = core[a]; core[a] = core[b]; core[b] = t;
+                t = rank[a]; rank[a] = rank[b]; rank[b] = t;
+            }
+        }
+    }
+    
+    if (g_mem_policy == MEM_CROSS && g_node_count < 2) {
+        fprintf(stderr, "Warning: only one NUMA node, -N cross places memory on the same node\n");
+    }
+    
+    static const char *place_names[] = { "none", "list", "spread", "pack" };
+    static const char *mem_names[] = { "any", "same", "cross" };
+    if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        snprintf(g_placement, sizeof(g_placement), "%s-%s",
+                 place_names[g_place_policy], mem_names[g_mem_policy]);
+    }
+    return 0;
+}
+
+/* CPU for the index-th thread, or -1 when placement is off */
+int placement_cpu(int index) {
+    return g_cpu_count > 0 ? g_cpus[index % g_cpu_count] : -1;
+}
+
+/* Prefer the -N node of a CPU for this thread's future page faults (-1 resets) */
+void bind_memory(int cpu) {
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+    memset(mask, 0, sizeof(mask));
+    
+    if (cpu < 0 || g_mem_policy == MEM_ANY) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        return;
+    }
+    
+    int node = node_of_cpu(cpu);
+    if (g_mem_policy == MEM_CROSS) node = (node + 1) % g_node_count;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    
+    /* MPOL_PREFERRED rather than BIND so a full node degrades instead of failing */
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0) {
+        perror("set_mempolicy failed");
+    }
+}
+
+/* Pin the calling thread to its CPU and place its allocations (first touch) */
+void place_thread(int index) {
+    int cpu = placement_cpu(index);
+    if (cpu < 0) return;
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Failed to pin thread %d to CPU %d\n", index, cpu);
+    }
+    bind_memory(cpu);
+}
+
+/* Message-size workload (-D) */
+#define DIST_FIXED 0        /* Every message is -s bytes */
+#define DIST_UNIFORM 1      /* uniform:MIN:MAX */
+#define DIST_BIMODAL 2      /* bimodal:SMALL:LARGE:P_LARGE */
+#define DIST_LOGNORMAL 3    /* lognormal:MEDIAN:SIGMA */
+#define DIST_PARETO 4       /* pareto:MIN:ALPHA */
+#define DIST_TRACE 5        /* trace:FILE, replays sizes and inter-arrival gaps */
+static int g_dist = DIST_FIXED;
+static double g_dist_param[3];
+static char g_dist_name[64] = "fixed";
+static size_t *g_trace_sizes = NULL;
+static unsigned int *g_trace_gaps_us = NULL;   /* Gap before each message */
+static size_t g_trace_len = 0;
+
+/* Per-connection workload state */
+typedef struct {
+    uint64_t rng;
+    size_t trace_pos;
+    struct timespec next_send;      /* Trace replay schedule */
+} Workload;
+
+/* Sends per log2 size class, timed from message build to the last byte queued */
+typedef struct {
+    unsigned long long messages[SIZE_CLASSES];
+    unsigned long long bytes[SIZE_CLASSES];
+    double send_ns[SIZE_CLASSES];
+} SizeStats;
+/* log2 size class of a message */
+int size_class(size_t size) {
+    int cls = 0;
+    while (size > 1 && cls < SIZE_CLASSES - 1) {
+        size >>= 1;
+        cls++;
+    }
+    return cls;
+}
+
+/* Load a size trace: one "size_bytes [gap_us]" pair per line, '#' starts a comment */
+int load_trace(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    
+    size_t cap = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+        
+        unsigned long size, gap = 0;
+        if (sscanf(p, "%lu %lu", &size, &gap) < 1 || size == 0) {
+            fprintf(stderr, "Invalid trace line: %s", line);
+            fclose(f);
+            return -1;
+        }
+        if (g_trace_len == cap) {
+            cap = cap ? cap * 2 : 1024;
+            g_trace_sizes = (size_t*)realloc(g_trace_sizes, cap * sizeof(size_t));
+            g_trace_gaps_us = (unsigned int*)realloc(g_trace_gaps_us, cap * sizeof(unsigned int));
+            if (!g_trace_sizes || !g_trace_gaps_us) {
+                perror("Failed to allocate trace");
+                fclose(f);
+                return -1;
+            }
+        }
+        g_trace_sizes[g_trace_len] = size;
+        g_trace_gaps_us[g_trace_len] = (unsigned int)gap;
+        g_trace_len++;
+        
+        /* Buffers are sized for the largest message in the trace */
+        if (size > (unsigned long)g_message_size) g_message_size = (int)size;
+    }
+    fclose(f);
+    
+    if (g_trace_len == 0) {
+        fprintf(stderr, "Empty trace: %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Parse a -D workload specification */
+int parse_dist(const char *spec) {
+    snprintf(g_dist_name, sizeof(g_dist_name), "%s", spec);
+    if (strncmp(spec, "trace:", 6) == 0) {
+        g_dist = DIST_TRACE;
+        return load_trace(spec + 6);
+    }
+    
+    char name[16] = "";
+    double *a = g_dist_param;
+    int n = sscanf(spec, "%15[a-z]:%lf:%lf:%lf", name, &a[0], &a[1], &a[2]);
+    if (strcmp(name, "fixed") == 0 && n == 1) {
+        g_dist = DIST_FIXED;
+    } else if (strcmp(name, "uniform") == 0 && n == 3 && a[0] >= 1 && a[1] >= a[0]) {
+        g_dist = DIST_UNIFORM;
+    } else if (strcmp(name, "bimodal") == 0 && n == 4 && a[0] >= 1 && a[1] >= 1 &&
+               a[2] >= 0 && a[2] <= 1) {
+        g_dist = DIST_BIMODAL;
+    } else if (strcmp(name, "lognormal") == 0 && n == 3 && a[0] >= 1 && a[1] > 0) {
+        g_dist = DIST_LOGNORMAL;
+    } else if (strcmp(name, "pareto") == 0 && n == 3 && a[0] >= 1 && a[1] > 0) {
+        g_dist = DIST_PARETO;
+    } else {
+        fprintf(stderr, "Invalid size distribution: %s\n", spec);
+        return -1;
+    }
+    return 0;
+}
+
+void init_workload(Workload *w, int thread_id) {
+    w->rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(thread_id + 1);
+    w->trace_pos = 0;
+    clock_gettime(CLOCK_MONOTONIC, &w->next_send);
+}
+
+/* xorshift64* mapped to a double in (0, 1) */
+double rng_uniform(uint64_t *s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return (((*s * 0x2545F4914F6CDD1DULL) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* Size of the next message, clamped to [1, -s]; trace replay sleeps out the gap first */
+size_t next_message_size(Workload *w) {
+    const double *a = g_dist_param;
+    double size;
+    switch (g_dist) {
+        case DIST_UNIFORM:
+            size = floor(a[0] + rng_uniform(&w->rng) * (a[1] - a[0] + 1));
+            break;
+        case DIST_BIMODAL:
+            size = rng_uniform(&w->rng) < a[2] ? a[1] : a[0];
+            break;
+        case DIST_LOGNORMAL: {
+            /* Box-Muller normal sample, scaled around the median */
+            double u1 = rng_uniform(&w->rng), u2 = rng_uniform(&w->rng);
+            double z = sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+            size = a[0] * exp(a[1] * z);
+            break;
+        }
+        case DIST_PARETO:
+            /* Inverse CDF: MIN / U^(1/ALPHA) */
+            size = a[0] / pow(rng_uniform(&w->rng), 1.0 / a[1]);
+            break;
+        case DIST_TRACE: {
+            size_t i = w->trace_pos++ % g_trace_len;
+            if (g_trace_gaps_us[i] > 0) {
+                w->next_send.tv_nsec += (long)g_trace_gaps_us[i] * 1000;
+                w->next_send.tv_sec += w->next_send.tv_nsec / 1000000000L;
+                w->next_send.tv_nsec %= 1000000000L;
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &w->next_send, NULL);
+            }
+            return g_trace_sizes[i];
+        }
+        default:
+            return g_message_size;
+    }
+    if (size < 1) size = 1;
+    if (size > g_message_size) size = g_message_size;
+    return (size_t)size;
+}
+
+/* Field sizes of a total-byte message, split as in create_message() */
+void split_fields(size_t total, size_t *sizes) {
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        sizes[i] = total / NUM_FIELDS + (i < (int)(total % NUM_FIELDS) ? 1 : 0);
+    }
+}
+
+void size_stats_record(SizeStats *ss, size_t size, const struct timespec *t0) {
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    int cls = size_class(size);
+    ss->messages[cls]++;
+    ss->bytes[cls] += size;
+    ss->send_ns[cls] += (t1.tv_sec - t0->tv_sec) * 1e9 + (t1.tv_nsec - t0->tv_nsec);
+}
+
+/* Per-size-class breakdown of one connection's sends */
+void print_size_stats(int thread_id, const SizeStats *ss) {
+    printf("[Thread %d] Sizes (%s):\n", thread_id, g_dist_name);
+    for (int c = 0; c < SIZE_CLASSES; c++) {
+        if (ss->messages[c] == 0) continue;
+        printf("[Thread %d]   %7llu-%-7llu B: %10llu msgs, %8.2f us/msg, %6.2f Gbps while sending\n",
+               thread_id, 1ULL << c, (2ULL << c) - 1, ss->messages[c],
+               ss->send_ns[c] / ss->messages[c] / 1e3,
+               ss->bytes[c] * 8.0 / ss->send_ns[c]);
+    }
+}
+
 /* Signal handler for graceful shutdown */
 void signal_handler(int sig) {
     (void)sig;
@@ -122,7 +691,307 @@ void destroy_message(Message *msg) {
     }
 }
 
+/* kB of transparent huge pages in the mapping that contains addr, from its */
+/* AnonHugePages line in /proc/self/smaps, or -1 if it cannot be read */
+long thp_backed_kb(const void *addr) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return -1;
+    
+    char line[256];
+    int in_range = 0;
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long lo, hi;
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            if (in_range) break;
+            in_range = (uintptr_t)addr >= lo && (uintptr_t)addr < hi;
+        } else if (in_range && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    
+    fclose(f);
+    return kb;
+}
+
+/* Map size bytes on 2 MB pages: the hugetlb pool if it has pages reserved, */
+/* otherwise a 2 MB aligned anonymous mapping advised for transparent huge pages */
+/* backing is only "thp" if smaps shows huge pages under the whole range */
+void* map_huge(size_t size, size_t *map_size, const char **backing) {
+    *map_size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void *p = mmap(NULL, *map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        *backing = "hugetlb";
+        return p;
+    }
+    
+    /* Over-map by one huge page and trim, so THP can back the region from its start */
+    char *raw = (char*)mmap(NULL, *map_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    char *aligned = (char*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned > raw) munmap(raw, aligned - raw);
+    if (raw + HUGE_PAGE_SIZE > aligned) {
+        munmap(aligned + *map_size, raw + HUGE_PAGE_SIZE - aligned);
+    }
+    *backing = "4k";
+    if (madvise(aligned, *map_size, MADV_HUGEPAGE) == 0) {
+        /* THP is decided at fault time, so fault the range in before asking what backs it */
+        memset(aligned, 0, *map_size);
+        if (thp_backed_kb(aligned) >= (long)(*map_size / 1024)) *backing = "thp";
+    }
+    return aligned;
+}
+
+/* Build the shared store: same field sizes and pattern as create_message(), */
+/* but laid out contiguously in one huge page mapping */
+MessageStore* create_message_store(size_t total_size) {
+    MessageStore *store = (MessageStore*)calloc(1, sizeof(MessageStore));
+    if (!store) {
+        perror("Failed to allocate message store");
+        return NULL;
+    }
+    
+    store->base = (char*)map_huge(total_size, &store->map_size, &store->backing);
+    if (!store->base) {
+        perror("Failed to map message store");
+        free(store);
+        return NULL;
+    }
+    store->size = total_size;
+    
+    size_t field_size = total_size / NUM_FIELDS;
+    size_t remainder = total_size % NUM_FIELDS;
+    size_t offset = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        size_t size = field_size + (i < (int)remainder ? 1 : 0);
+        store->msg.fields[i] = store->base + offset;
+        store->msg.field_sizes[i] = size;
+        store->iov[i].iov_base = store->msg.fields[i];
+        store->iov[i].iov_len = size;
+        memset(store->msg.fields[i], 'A' + i, size);
+        offset += size;
+    }
+    
+    /* Immutable from here on: a stray write faults instead of corrupting every connection */
+    if (mprotect(store->base, store->map_size, PROT_READ) < 0) {
+        perror("mprotect message store failed");
+    }
+    
+    return store;
+}
+
+/* Message for a connection or worker: the shared store (-S) or a private copy */
+Message* acquire_message(void) {
+    return g_store ? &g_store->msg : create_message(g_message_size);
+}
+
+/* Release a message from acquire_message(), the store lives until exit */
+void release_message(Message *msg) {
+    if (!g_store) destroy_message(msg);
+}
+
+/* Write new payload into the first sizes[i] bytes of each field of a message slot */
+/* The pattern rotates with the sequence number so reused slots carry new data */
+void fill_message(Message *msg, const size_t *sizes, unsigned long long seq) {
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        memset(msg->fields[i], 'A' + (int)((i + seq) % NUM_FIELDS), sizes[i]);
+    }
+}
+
+/* Message whose fields are laid out back to back at base (-g slots) */
+Message* message_in_region(char *base, size_t total_size) {
+    Message *msg = (Message*)malloc(sizeof(Message));
+    if (!msg) {
+        perror("Failed to allocate message structure");
+        return NULL;
+    }
+    
+    size_t field_size = total_size / NUM_FIELDS;
+    size_t remainder = total_size % NUM_FIELDS;
+    size_t offset = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        msg->field_sizes[i] = field_size + (i < (int)remainder ? 1 : 0);
+        msg->fields[i] = base + offset;
+        memset(msg->fields[i], 'A' + i, msg->field_sizes[i]);
+        offset += msg->field_sizes[i];
+    }
+    
+    return msg;
+}
+
+/* Free a slot ring */
+void destroy_zc_ring(ZcRing *ring) {
+    if (ring) {
+        for (int i = 0; i < ring->slot_count; i++) {
+            if (ring->region) {
+                free(ring->slots[i]);
+            } else {
+                destroy_message(ring->slots[i]);
+            }
+        }
+        if (ring->region) munmap(ring->region, ring->region_size);
+        free(ring->slots);
+        free(ring->outstanding);
+        free(ring->headers);
+        free(ring->frames);
+        free(ring);
+    }
+}
+
+/* Allocate a ring of message slots */
+/* total_size 0 (-S): no payload per slot, the ring only tracks headers and sends */
+ZcRing* create_zc_ring(int slot_count, size_t total_size) {
+    ZcRing *ring = (ZcRing*)calloc(1, sizeof(ZcRing));
+    if (!ring) return NULL;
+    
+    ring->slot_count = slot_count;
+    ring->slots = (Message**)calloc(slot_count, sizeof(Message*));
+    ring->outstanding = (unsigned int*)calloc(slot_count, sizeof(unsigned int));
+    ring->headers = (RequestHeader*)calloc(slot_count, sizeof(RequestHeader));
+    ring->frames = (FrameHeader*)calloc(slot_count, sizeof(FrameHeader));
+    if (!ring->slots || !ring->outstanding || !ring->headers || !ring->frames) {
+        free(ring->slots);
+        free(ring->outstanding);
+        free(ring->headers);
+        free(ring->frames);
+        free(ring);
+        return NULL;
+    }
+    
+    /* -g: slot i's fields back to back at region + i * total_size, so a send */
+    /* touches one or two 2 MB pages instead of one 4 KB page per 4 KB of payload */
+    ring->page_size = sysconf(_SC_PAGESIZE);
+    const char *backing = NULL;
+    if (total_size > 0 && g_huge_slots) {
+        ring->region = (char*)map_huge((size_t)slot_count * total_size,
+                                       &ring->region_size, &backing);
+        if (!ring->region) {
+            free(ring->slots);
+            free(ring->outstanding);
+            free(ring->headers);
+            free(ring->frames);
+            free(ring);
+            return NULL;
+        }
+    } else if (total_size == 0 && g_store) {
+        backing = g_store->backing;
+    }
+    if (backing && strcmp(backing, "4k") != 0) ring->page_size = HUGE_PAGE_SIZE;
+    
+    for (int i = 0; i < slot_count && total_size > 0; i++) {
+        ring->slots[i] = ring->region ?
+            message_in_region(ring->region + (size_t)i * total_size, total_size) :
+            create_message(total_size);
+        if (!ring->slots[i]) {
+            destroy_zc_ring(ring);
+            return NULL;
+        }
+    }
+    
+    return ring;
+}
+
+/* Pages of page_size referenced by the first len bytes of an iovec array: */
+/* what a MSG_ZEROCOPY send of them has to pin, one reference per page per segment */
+unsigned long pages_spanned(const struct iovec *iov, int count, size_t len, size_t page_size) {
+    unsigned long pages = 0;
+    for (int i = 0; i < count && len > 0; i++) {
+        size_t n = iov[i].iov_len < len ? iov[i].iov_len : len;
+        if (n == 0) continue;
+        uintptr_t first = (uintptr_t)iov[i].iov_base / page_size;
+        uintptr_t last = ((uintptr_t)iov[i].iov_base + n - 1) / page_size;
+        pages += last - first + 1;
+        len -= n;
+    }
+    return pages;
+}
+
+/* Record that the next zerocopy send ID references a slot */
+void zc_ring_track_send(ZcRing *ring, int slot) {
+    ring->id_slot[ring->next_id % ZC_ID_MAP] = slot;
+    clock_gettime(CLOCK_MONOTONIC, &ring->id_sent[ring->next_id % ZC_ID_MAP]);
+    ring->outstanding[slot]++;
+    ring->next_id++;
+    ring->ids_in_flight++;
+}
+
+/* Release the slots referenced by a completed [lo, hi] ID range */
+void zc_ring_complete(ZcRing *ring, Stats *stats, unsigned int lo, unsigned int hi) {
+    for (unsigned int id = lo; id != hi + 1; id++) {
+        int slot = ring->id_slot[id % ZC_ID_MAP];
+        if (ring->outstanding[slot] > 0) ring->outstanding[slot]--;
+        if (ring->ids_in_flight > 0) ring->ids_in_flight--;
+    }
+    
+    /* Completion latency of the newest send in the range */
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct timespec *sent = &ring->id_sent[hi % ZC_ID_MAP];
+    double latency = (now.tv_sec - sent->tv_sec) * 1e6 + (now.tv_nsec - sent->tv_nsec) / 1e3;
+    stats->completion_latency_us = stats->completion_latency_us == 0 ? latency :
+        (1 - EWMA_ALPHA) * stats->completion_latency_us + EWMA_ALPHA * latency;
+}
+
+/* Decide whether the next send of this size should use MSG_ZEROCOPY */
+int zc_policy_choose(ZcPolicy *p, const Stats *stats, size_t size) {
+    int cls = size_class(size);
+    p->decisions++;
+    
+    /* Bootstrap: sample both paths before trusting either estimate */
+    if (p->samples[0][cls] < BOOTSTRAP_SAMPLES || p->samples[1][cls] < BOOTSTRAP_SAMPLES) {
+        return p->samples[1][cls] < p->samples[0][cls];
+    }
+    
+    /* Kernel is copying anyway: zero-copy only adds notification overhead.
+     * The ratio decays, so once the probes complete uncopied again the
+     * cost comparison below takes over. */
+    if (stats->zc_ids_completed >= EXPLORE_INTERVAL && stats->copied_ratio > 0.5) {
+        return (p->decisions % COPIED_PROBE_INTERVAL) == 0;
+    }
+    
+    /* A zerocopy send holds its buffer until the completion arrives, so
+     * with window sends in flight the path cannot beat window messages
+     * per completion latency, however cheap each sendmsg() is. */
+    double zc_cost = p->cost_ns_per_byte[1][cls];
+    double held = stats->completion_latency_us * 1e3 / ((double)p->window * size);
+    if (held > zc_cost) zc_cost = held;
+    
+    int best = zc_cost < p->cost_ns_per_byte[0][cls];
+    if ((p->decisions % EXPLORE_INTERVAL) == 0) return !best;
+    return best;
+}
+
+/* Feed the measured cost of one message back into the policy */
+void zc_policy_update(ZcPolicy *p, size_t size, int use_zc, double elapsed_ns) {
+    int cls = size_class(size);
+    double cost = elapsed_ns / (double)size;
+    
+    if (p->samples[use_zc][cls] == 0) {
+        p->cost_ns_per_byte[use_zc][cls] = cost;
+    } else {
+        p->cost_ns_per_byte[use_zc][cls] = (1 - EWMA_ALPHA) * p->cost_ns_per_byte[use_zc][cls] +
+                                           EWMA_ALPHA * cost;
+    }
+    p->samples[use_zc][cls]++;
+    p->sends[use_zc]++;
+}
+
+/* Smallest size class where zero-copy measured cheaper than copy, or -1 */
+int zc_policy_crossover(const ZcPolicy *p) {
+    for (int cls = 0; cls < SIZE_CLASSES; cls++) {
+        if (p->samples[0][cls] >= BOOTSTRAP_SAMPLES && p->samples[1][cls] >= BOOTSTRAP_SAMPLES &&
+            p->cost_ns_per_byte[1][cls] < p->cost_ns_per_byte[0][cls]) {
+            return cls;
+        }
+    }
+    return -1;
+}
+
 /* Prepare iovec array from message */
+/* MSG_ZEROCOPY pins these user pages, which is what A3 measures; page-cache */
+/* sends (sendfile/splice) are A1 -m and are not duplicated here */
 struct iovec* prepare_iovec(Message *msg) {
     struct iovec *iov = (struct iovec*)malloc(NUM_FIELDS * sizeof(struct iovec));
     if (!iov) return NULL;
@@ -135,10 +1004,109 @@ struct iovec* prepare_iovec(Message *msg) {
     return iov;
 }
 
+/* Build an iovec view of the message that skips the first offset bytes */
+/* Used to resume a partially sent message without copying any data */
+int iovec_from_offset(const struct iovec *src, int count, size_t offset,
+                      struct iovec *dst) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (offset >= src[i].iov_len) {
+            offset -= src[i].iov_len;
+            continue;
+        }
+        dst[n].iov_base = (char*)src[i].iov_base + offset;
+        dst[n].iov_len = src[i].iov_len - offset;
+        offset = 0;
+        n++;
+    }
+    return n;
+}
+
+/* Enable software TX timestamps; OPT_ID keys every report by byte offset */
+int enable_tx_timestamps(int fd) {
+    int flags = SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_SOFTWARE |
+                SOF_TIMESTAMPING_TX_ACK | SOF_TIMESTAMPING_SOFTWARE |
+                SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+/* Remember when the send ending at byte offset bytes_sent - 1 was issued */
+void ts_track_send(TxTimestamps *ts, unsigned long long bytes_sent,
+                   const struct timespec *t_user) {
+    if (ts->head - ts->tail == TS_PENDING) ts->tail++;     /* Drop the oldest */
+    unsigned int idx = ts->head % TS_PENDING;
+    ts->id[idx] = (uint32_t)(bytes_sent - 1);
+    memset(ts->stamp[idx], 0, sizeof(ts->stamp[idx]));
+    ts->stamp[idx][0] = *t_user;
+    ts->head++;
+}
+
+/* Apply one report: type is SCM_TSTAMP_SCHED/SND/ACK, key the OPT_ID byte offset */
+void ts_record(TxTimestamps *ts, uint32_t key, unsigned int type, const struct timespec *t) {
+    if (ts->tail == ts->head) return;
+    
+    /* Keys grow with the byte stream, so binary search the pending window */
+    unsigned long long lo = ts->tail, hi = ts->head;
+    uint32_t base = ts->id[lo % TS_PENDING];
+    while (lo < hi) {
+        unsigned long long mid = lo + (hi - lo) / 2;
+        if (ts->id[mid % TS_PENDING] - base < key - base) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == ts->head || ts->id[lo % TS_PENDING] != key) return;  /* Untracked partial send */
+    
+    int stage = type == SCM_TSTAMP_SCHED ? STAGE_USER_QDISC :
+                type == SCM_TSTAMP_SND ? STAGE_QDISC_WIRE : STAGE_WIRE_ACK;
+    struct timespec *s = ts->stamp[lo % TS_PENDING];
+    if (s[stage].tv_sec != 0) {
+        ts->stage_sum[stage] += (t->tv_sec - s[stage].tv_sec) * 1e6 +
+                                (t->tv_nsec - s[stage].tv_nsec) / 1e3;
+        ts->stage_count[stage]++;
+    }
+    if (stage + 1 < NUM_STAGES) {
+        s[stage + 1] = *t;
+    } else {
+        ts->tail = lo + 1;  /* ACKed: earlier sends have nothing more to report */
+    }
+}
+
+/* Match the SCM_TIMESTAMPING and IP_RECVERR cmsgs of one error queue message */
+void ts_handle_errqueue(struct msghdr *msg, TxTimestamps *ts) {
+    struct scm_timestamping *tss = NULL;
+    struct sock_extended_err *serr = NULL;
+    
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm; cm = CMSG_NXTHDR(msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+            tss = (struct scm_timestamping*)CMSG_DATA(cm);
+        } else if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) {
+            serr = (struct sock_extended_err*)CMSG_DATA(cm);
+        }
+    }
+    
+    if (tss && serr && serr->ee_errno == ENOMSG &&
+        serr->ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+        ts_record(ts, serr->ee_data, serr->ee_info, &tss->ts[0]);
+    }
+}
+
+/* Print the average of each TX stage */
+void print_tx_stages(int thread_id, const TxTimestamps *ts) {
+    double avg[NUM_STAGES];
+    for (int i = 0; i < NUM_STAGES; i++) {
+        avg[i] = ts->stage_count[i] > 0 ? ts->stage_sum[i] / ts->stage_count[i] : 0;
+    }
+    printf("[Thread %d] TX stages: user->qdisc %.2f us, qdisc->wire %.2f us, "
+           "wire->ack %.2f us (%llu/%llu/%llu samples)\n",
+           thread_id, avg[STAGE_USER_QDISC], avg[STAGE_QDISC_WIRE], avg[STAGE_WIRE_ACK],
+           ts->stage_count[STAGE_USER_QDISC], ts->stage_count[STAGE_QDISC_WIRE],
+           ts->stage_count[STAGE_WIRE_ACK]);
+}
+
 /* Process zerocopy completion notifications from error queue */
 /* This is essential - we must drain completions to avoid blocking */
-int process_zerocopy_completions(int fd, Stats *stats, int blocking) {
-    char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(uint32_t))];
+/* ring may be NULL when the payload is never rewritten */
+int process_zerocopy_completions(int fd, Stats *stats, ZcRing *ring, int blocking) {
+    char control[TS_CONTROL_SIZE];
     struct msghdr msg;
     struct cmsghdr *cm;
     int ret;
@@ -164,29 +1132,278 @@ int process_zerocopy_completions(int fd, Stats *stats, int blocking) {
             if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) {
                 struct sock_extended_err *serr = (struct sock_extended_err*)CMSG_DATA(cm);
                 if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
-                    completions += serr->ee_data - serr->ee_info + 1;
+                    unsigned int ids = serr->ee_data - serr->ee_info + 1;
+                    completions += ids;
                     stats->completions_received++;
+                    stats->zc_ids_completed += ids;
+                    int copied = (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+                    if (copied) {
+                        stats->zc_ids_copied += ids;
+                    }
+                    /* One EWMA step per ID, so a coalesced range weighs as much as single IDs */
+                    double keep = pow(1 - EWMA_ALPHA, ids);
+                    stats->copied_ratio = stats->copied_ratio * keep + copied * (1 - keep);
+                    if (ring) zc_ring_complete(ring, stats, serr->ee_info, serr->ee_data);
                 }
             }
         }
         
+        /* TX timestamps share the error queue with zerocopy completions */
+        if (stats->tx_ts) ts_handle_errqueue(&msg, stats->tx_ts);
+        
         msg.msg_controllen = sizeof(control);
     }
     
     return completions;
 }
 
-/* Client handler thread function */
-void* client_handler(void *arg) {
+/* Block in poll(POLLERR) until the error queue has completions, then drain it */
+/* Returns -1 if the socket failed */
+int wait_for_completions(int fd, Stats *stats, ZcRing *ring) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = 0;     /* POLLERR is always reported */
+    
+    int ret = poll(&pfd, 1, 100);
+    if (ret < 0) return (errno == EINTR) ? 0 : -1;
+    if (ret == 0) return 0;
+    if (pfd.revents & POLLHUP) return -1;
+    
+    return process_zerocopy_completions(fd, stats, ring, 0) < 0 ? -1 : 0;
+}
+
+/* True while the slot is still referenced by a send, or the ID map is full */
+/* Pass slot -1 to check only the ID map */
+int zc_ring_busy(const ZcRing *ring, int slot) {
+    /* The shared store never changes, so only an echoed or frame header can keep a slot busy */
+    int reuse_wait = !g_store || g_request_response || g_framing;
+    
+    return (slot >= 0 && reuse_wait && ring->outstanding[slot] > 0) ||
+           ring->ids_in_flight >= ZC_ID_MAP;
+}
+
+/* Block on completions until zc_ring_busy() clears, counting the stall */
+/* Returns -1 if the socket failed or the server stopped while still busy */
+int zc_ring_wait(int fd, ZcRing *ring, Stats *stats, int slot) {
+    if (!zc_ring_busy(ring, slot)) return 0;
+    
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    stats->stalls++;
+    
+    while (g_running && zc_ring_busy(ring, slot)) {
+        if (wait_for_completions(fd, stats, ring) < 0) return -1;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stats->stall_time_us += (t1.tv_sec - t0.tv_sec) * 1e6 +
+                            (t1.tv_nsec - t0.tv_nsec) / 1e3;
+    
+    /* Stopped with the slot still referenced: it must not be rewritten */
+    return zc_ring_busy(ring, slot) ? -1 : 0;
+}
+
+/* Wait at close until every zerocopy send has completed and no slot is still */
+/* referenced, giving up after ZC_DRAIN_IDLE_MS without a completion */
+/* Returns the IDs still in flight */
+unsigned int drain_zc_ring(int fd, Stats *stats, ZcRing *ring) {
+    struct timespec last, now;
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    
+    while (ring->ids_in_flight > 0) {
+        unsigned int before = ring->ids_in_flight;
+        
+        /* After a hangup poll() returns at once, so pause rather than spin */
+        struct pollfd pfd = { fd, 0, 0 };   /* POLLERR is always reported */
+        if (poll(&pfd, 1, 100) > 0 && !(pfd.revents & POLLERR)) {
+            struct timespec pause = { 0, 1000000 };
+            nanosleep(&pause, NULL);
+        }
+        process_zerocopy_completions(fd, stats, ring, 0);
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (ring->ids_in_flight < before) {
+            last = now;
+        } else if ((now.tv_sec - last.tv_sec) * 1000 +
+                   (now.tv_nsec - last.tv_nsec) / 1000000 >= ZC_DRAIN_IDLE_MS) {
+            break;
+        }
+    }
+    return ring->ids_in_flight;
+}
+
+/* Take the next slot, waiting until the kernel has released it */
+/* Returns the slot index, or -1 if the socket failed or the server */
+/* stopped while the slot was still in flight */
+int zc_ring_acquire(int fd, ZcRing *ring, Stats *stats) {
+    int slot = ring->next_slot;
+    if (zc_ring_wait(fd, ring, stats, slot) < 0) return -1;
+    
+    ring->next_slot = (slot + 1) % ring->slot_count;
+    return slot;
+}
+
+/* Read one request header, returns 1 on success or 0 if the client went away */
+int read_request(int fd, RequestHeader *req) {
+    size_t got = 0;
+    while (got < sizeof(*req)) {
+        ssize_t n = recv(fd, (char*)req + got, sizeof(*req) - got, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return 0;
+        }
+        got += n;
+    }
+    return 1;
+}
+
+/* Fill in the frame header of a connection's next message */
+void frame_stamp(FrameHeader *hdr, uint32_t length, uint64_t seq, uint32_t flags) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    hdr->length = length;
+    hdr->flags = flags;
+    hdr->seq = seq;
+    hdr->send_ts_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Receive side of an upload (-x up/both) */
+typedef struct {
+    int client_fd;
+    int thread_id;
+} UploadArg;
+
+/* Per-connection summary of the upload direction */
+void print_upload_stats(int thread_id, unsigned long long bytes, unsigned long long messages,
+                        const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+    printf("[Thread %d] Upload: %.2f GB received, %.2f Gbps, %llu messages in %.2f seconds\n",
+           thread_id, bytes / 1e9, elapsed > 0 ? bytes * 8.0 / (elapsed * 1e9) : 0,
+           messages, elapsed);
+}
+
+/* Receive the client's upload with TCP_ZEROCOPY_RECEIVE: whole payload pages */
+/* are mapped into a window of the socket's mmap(), the unaligned rest is copied */
+/* into copybuf, and what the kernel can do neither with is read with recv() */
+void* upload_receiver(void *arg) {
+    UploadArg *ua = (UploadArg*)arg;
+    int fd = ua->client_fd;
+    long page_size = sysconf(_SC_PAGESIZE);
+    
+    /* Map window large enough for several messages, rounded to pages */
+    size_t map_size = (size_t)g_message_size * 4;
+    if (map_size < 256 * 1024) map_size = 256 * 1024;
+    map_size = (map_size + page_size - 1) & ~(size_t)(page_size - 1);
+    
+    void *addr = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        perror("mmap of socket failed - receiving the upload with recv()");
+        addr = NULL;
+    }
+    char *copybuf = (char*)malloc(ZC_COPYBUF_SIZE);
+    if (!copybuf) {
+        perror("Failed to allocate copy buffer");
+        if (addr) munmap(addr, map_size);
+        return NULL;
+    }
+    
+    unsigned long long mapped = 0, copied = 0, messages = 0;
+    size_t partial = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    while (g_running) {
+        size_t got = 0;
+        size_t skip = ZC_COPYBUF_SIZE;      /* Without a mapping every read is a recv() */
+        if (addr) {
+            ZerocopyReceive zc;
+            memset(&zc, 0, sizeof(zc));
+            zc.address = (unsigned long long)addr;
+            zc.length = map_size;
+            zc.copybuf_address = (unsigned long long)copybuf;
+            zc.copybuf_len = ZC_COPYBUF_SIZE;
+            socklen_t zc_len = sizeof(zc);
+            
+            if (getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &zc_len) < 0) {
+                if (errno == EINTR) continue;
+                /* Once the client has closed the call fails (EIO) instead of mapping 0 bytes */
+                char c;
+                if (recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 0) {
+                    perror("getsockopt TCP_ZEROCOPY_RECEIVE failed");
+                }
+                break;
+            }
+            if (zc.err) break;
+            mapped += zc.length;
+            copied += zc.copybuf_len;
+            got = zc.length + zc.copybuf_len;
+            skip = zc.recv_skip_hint;
+        }
+        
+        if (skip > 0) {
+            ssize_t received = recv(fd, copybuf, skip < ZC_COPYBUF_SIZE ? skip : ZC_COPYBUF_SIZE, 0);
+            if (received <= 0) {
+                if (received < 0 && errno == EINTR) continue;
+                if (received < 0 && errno != ECONNRESET) perror("upload recv error");
+                break;
+            }
+            copied += received;
+            got += received;
+        } else if (got == 0) {
+            /* Nothing queued: wait for data, and detect EOF */
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 100) > 0) {
+                char c;
+                ssize_t peek = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+                if (peek == 0 || (peek < 0 && errno != EAGAIN && errno != EINTR)) break;
+            }
+        }
+        
+        partial += got;
+        messages += partial / g_message_size;
+        partial %= g_message_size;
+    }
+    
+    print_upload_stats(ua->thread_id, mapped + copied, messages, &start);
+    if (mapped + copied > 0) {
+        printf("[Thread %d] Upload: %.1f%% of bytes mapped by TCP_ZEROCOPY_RECEIVE\n",
+               ua->thread_id, 100.0 * mapped / (mapped + copied));
+    }
+    free(copybuf);
+    if (addr) munmap(addr, map_size);
+    return NULL;
+}
+
+/* Client handler thread function */
+void* client_handler(void *arg) {
     ThreadArg *targ = (ThreadArg*)arg;
     int client_fd = targ->client_fd;
     int thread_id = targ->thread_id;
+    
+    /* Pin before allocating so the message is first touched on the chosen node */
+    /* (shard workers stay on their shard's CPU) */
+    if (!g_shards) place_thread(thread_id);
     int zerocopy_enabled = 0;
     
-    printf("[Thread %d] Client connected from %s:%d\n",
-           thread_id,
-           inet_ntoa(targ->client_addr.sin_addr),
-           ntohs(targ->client_addr.sin_port));
+    if (g_unix_path) {
+        printf("[Thread %d] Client connected on %s\n", thread_id, g_unix_path);
+    } else {
+        printf("[Thread %d] Client connected from %s:%d\n",
+               thread_id,
+               inet_ntoa(targ->client_addr.sin_addr),
+               ntohs(targ->client_addr.sin_port));
+    }
+    
+    /* Upload (-x up): the client sends and this connection only receives */
+    if (g_direction == DIR_UP) {
+        UploadArg upload = { client_fd, thread_id };
+        upload_receiver(&upload);
+        close(client_fd);
+        free(targ);
+        return NULL;
+    }
     
     /* Enable SO_ZEROCOPY on the socket */
     int one = 1;
@@ -198,36 +1415,24 @@ void* client_handler(void *arg) {
         printf("[Thread %d] MSG_ZEROCOPY enabled\n", thread_id);
     }
     
-    /* Create message structure */
-    Message *msg = create_message(g_message_size);
-    if (!msg) {
+    /* Create the ring of message slots */
+    ZcRing *ring = create_zc_ring(g_slots, g_store ? 0 : g_message_size);
+    if (!ring) {
+        perror("Failed to allocate message slots");
         close(client_fd);
         free(targ);
         return NULL;
     }
     
-    /* Prepare iovec for scatter-gather I/O */
-    struct iovec *iov = prepare_iovec(msg);
-    if (!iov) {
-        destroy_message(msg);
-        close(client_fd);
-        free(targ);
-        return NULL;
-    }
-    
-    /* Prepare msghdr structure */
-    struct msghdr mh;
-    memset(&mh, 0, sizeof(mh));
-    mh.msg_iov = iov;
-    mh.msg_iovlen = NUM_FIELDS;
-    
     /* Calculate total message size */
     size_t total_size = 0;
-    for (int i = 0; i < NUM_FIELDS; i++) {
-        total_size += msg->field_sizes[i];
+    for (int i = 0; i < NUM_FIELDS && !g_store; i++) {
+        total_size += ring->slots[0]->field_sizes[i];
     }
+    if (g_store) total_size = g_store->size;
     
-    Stats stats = {0, 0, 0, 0.0};
+    Stats stats;
+    memset(&stats, 0, sizeof(stats));
     struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
     
@@ -239,55 +1444,155 @@ void* client_handler(void *arg) {
     int sndbuf = 1024 * 1024;  /* 1MB */
     setsockopt(client_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
     
+    /* SO_TIMESTAMPING must be enabled before the first byte so OPT_ID keys match byte counts */
+    if (g_timestamping) {
+        stats.tx_ts = (TxTimestamps*)calloc(1, sizeof(TxTimestamps));
+        if (!stats.tx_ts || enable_tx_timestamps(client_fd) < 0) {
+            perror("SO_TIMESTAMPING setup failed - continuing without timestamps");
+            free(stats.tx_ts);
+            stats.tx_ts = NULL;
+        }
+    }
+    
+    /* Bidirectional (-x both): a second thread receives the upload while this one sends */
+    UploadArg upload = { client_fd, thread_id };
+    pthread_t upload_thread;
+    int uploading = g_direction == DIR_BOTH &&
+                    pthread_create(&upload_thread, NULL, upload_receiver, &upload) == 0;
+    
     /* Send messages continuously using sendmsg() with MSG_ZEROCOPY */
-    unsigned int pending = 0;
-    const unsigned int max_pending = 256;  /* Allow more pending for better throughput */
-    int send_flags = zerocopy_enabled ? MSG_ZEROCOPY : 0;
+    if (g_zc_mode == ZC_MODE_NEVER) zerocopy_enabled = 0;
+    ZcPolicy policy;
+    memset(&policy, 0, sizeof(policy));
+    /* Same condition as zc_ring_busy(): without slot reuse only the ID map bounds it */
+    policy.window = (!g_store || g_request_response || g_framing) ? ring->slot_count : ZC_ID_MAP;
+    struct timespec t0, t1, t_user, t_send, t_done;
+    struct iovec iov[NUM_FIELDS + 1];
+    struct iovec slot_iov[NUM_FIELDS + 1];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    unsigned long long seq = 0;
+    int failed = 0;
     
-    while (g_running) {
+    /* In request/response mode each response carries the echoed request header, */
+    /* with framing (-F) every message carries its frame header */
+    size_t header_size = g_request_response ? sizeof(RequestHeader) :
+                         g_framing ? sizeof(FrameHeader) : 0;
+    size_t payload_size = total_size;
+    RequestHeader req;
+    
+    /* Size distribution (-D): slots hold -s bytes, each send uses a prefix of every field */
+    Workload wl;
+    SizeStats size_stats;
+    size_t sizes[NUM_FIELDS];
+    split_fields(total_size, sizes);
+    if (g_dist != DIST_FIXED) {
+        init_workload(&wl, thread_id);
+        memset(&size_stats, 0, sizeof(size_stats));
+    }
+    
+    while (g_running && !failed) {
+        if (g_request_response && !read_request(client_fd, &req)) break;
+        
+        struct timespec t_msg;
+        if (g_dist != DIST_FIXED) {
+            payload_size = next_message_size(&wl);
+            split_fields(payload_size, sizes);
+            clock_gettime(CLOCK_MONOTONIC, &t_msg);
+        }
+        size_t send_size = header_size + payload_size;
+        
+        int use_zc = zerocopy_enabled;
+        if (use_zc && g_zc_mode == ZC_MODE_AUTO) {
+            use_zc = zc_policy_choose(&policy, &stats, send_size);
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+        }
+        int send_flags = use_zc ? MSG_ZEROCOPY : 0;
+        
+        /* Without zero-copy the kernel copies, so any slot may be reused */
+        /* A failed acquire leaves the loop before the slot is touched */
+        int slot = zerocopy_enabled ? zc_ring_acquire(client_fd, ring, &stats) : 0;
+        if (slot < 0) break;
+        
+        /* Producer writes new data into the released slot, the shared store is sent as is */
+        Message *msg = g_store ? &g_store->msg : ring->slots[slot];
+        if (!g_store) fill_message(msg, sizes, seq++);
+        int iov_count = 0;
+        if (g_request_response) {
+            ring->headers[slot] = req;
+            slot_iov[iov_count].iov_base = &ring->headers[slot];
+            slot_iov[iov_count++].iov_len = sizeof(RequestHeader);
+        } else if (g_framing) {
+            frame_stamp(&ring->frames[slot], payload_size, stats.messages_sent,
+                        use_zc ? FRAME_F_ZEROCOPY : 0);
+            slot_iov[iov_count].iov_base = &ring->frames[slot];
+            slot_iov[iov_count++].iov_len = sizeof(FrameHeader);
+        }
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            slot_iov[iov_count].iov_base = msg->fields[i];
+            slot_iov[iov_count++].iov_len = sizes[i];
+        }
+        
         /* sendmsg with MSG_ZEROCOPY - kernel will DMA directly from user memory */
-        ssize_t sent = sendmsg(client_fd, &mh, send_flags);
-        if (sent <= 0) {
-            if (sent < 0) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    /* Socket buffer full - drain completions and wait briefly */
-                    if (zerocopy_enabled) {
-                        process_zerocopy_completions(client_fd, &stats, 0);
-                    }
-                    usleep(100);
-                    continue;
-                }
-                if (errno == ENOBUFS) {
-                    /* Too many pending zerocopy - drain completions */
-                    if (zerocopy_enabled) {
-                        process_zerocopy_completions(client_fd, &stats, 0);
+        size_t offset = 0;
+        while (offset < send_size && g_running) {
+            mh.msg_iovlen = iovec_from_offset(slot_iov, iov_count, offset, iov);
+            if (stats.tx_ts) clock_gettime(CLOCK_REALTIME, &t_user);
+            /* Every zerocopy sendmsg(), short ones included, takes an ID */
+            if (use_zc && zc_ring_wait(client_fd, ring, &stats, -1) < 0) {
+                failed = 1;
+                break;
+            }
+            if (use_zc) clock_gettime(CLOCK_MONOTONIC, &t_send);
+            ssize_t sent = sendmsg(client_fd, &mh, send_flags);
+            if (sent <= 0) {
+                if (sent < 0 && (errno == ENOBUFS || errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    /* Notification budget or socket buffer exhausted: wait for the kernel */
+                    if (zerocopy_enabled && wait_for_completions(client_fd, &stats, ring) == 0) {
+                        continue;
                     }
-                    usleep(100);
+                } else if (sent < 0 && errno == EINTR) {
                     continue;
-                }
-                if (errno != EPIPE && errno != ECONNRESET) {
+                } else if (sent < 0 && errno != EPIPE && errno != ECONNRESET) {
                     perror("sendmsg error");
                 }
+                failed = 1;
+                break;
             }
-            break;
+            if (use_zc) {
+                clock_gettime(CLOCK_MONOTONIC, &t_done);
+                stats.zc_send_time_ns += (t_done.tv_sec - t_send.tv_sec) * 1e9 +
+                                         (t_done.tv_nsec - t_send.tv_nsec);
+                stats.zc_sends++;
+                stats.page_spans += pages_spanned(iov, mh.msg_iovlen, sent, ring->page_size);
+                zc_ring_track_send(ring, slot);
+            }
+            stats.bytes_sent += sent;
+            offset += sent;
+            if (stats.tx_ts) ts_track_send(stats.tx_ts, stats.bytes_sent, &t_user);
         }
-        stats.bytes_sent += sent;
-        stats.messages_sent++;
-        pending++;
+        if (offset == send_size) {
+            stats.messages_sent++;
+            if (g_dist != DIST_FIXED) size_stats_record(&size_stats, payload_size, &t_msg);
+        }
+        if (stats.tx_ts) process_zerocopy_completions(client_fd, &stats, ring, 0);
         
-        /* Drain completions periodically to avoid buildup */
-        if (zerocopy_enabled && pending >= max_pending) {
-            while (process_zerocopy_completions(client_fd, &stats, 0) > 0);
-            pending = 0;
+        /* Cost of this message includes any stall waiting for its slot */
+        if (zerocopy_enabled && g_zc_mode == ZC_MODE_AUTO) {
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            zc_policy_update(&policy, send_size, use_zc,
+                             (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec));
         }
     }
     
-    /* Drain remaining completions */
-    if (zerocopy_enabled) {
-        for (int i = 0; i < 10; i++) {
-            if (process_zerocopy_completions(client_fd, &stats, 0) <= 0) break;
-            usleep(1000);
-        }
+    /* The slots may only be freed once the kernel has released all of them */
+    unsigned int stuck = zerocopy_enabled ? drain_zc_ring(client_fd, &stats, ring) : 0;
+    
+    /* SHUT_RD wakes the receiver if the client is still sending */
+    if (uploading) {
+        shutdown(client_fd, SHUT_RD);
+        pthread_join(upload_thread, NULL);
     }
     
     clock_gettime(CLOCK_MONOTONIC, &end);
@@ -303,34 +1608,633 @@ void* client_handler(void *arg) {
            stats.messages_sent,
            stats.completions_received,
            stats.elapsed_time);
+    printf("[Thread %d] Slot ring: %d slots, %llu stalls, %.2f ms stalled\n",
+           thread_id, ring->slot_count, stats.stalls, stats.stall_time_us / 1e3);
+    if (stats.zc_sends > 0) {
+        printf("[Thread %d] Page spans: %.1f x %zu KB pages referenced per zerocopy send, %.2f us per sendmsg()\n",
+               thread_id, (double)stats.page_spans / stats.zc_sends, ring->page_size / 1024,
+               stats.zc_send_time_ns / stats.zc_sends / 1e3);
+    }
+    if (stats.zc_ids_completed > 0) {
+        printf("[Thread %d] Completions: %.1f%% copied by kernel, %.2f us send-to-completion\n",
+               thread_id, 100.0 * stats.zc_ids_copied / stats.zc_ids_completed,
+               stats.completion_latency_us);
+    }
+    if (zerocopy_enabled && g_zc_mode == ZC_MODE_AUTO) {
+        int cls = size_class(header_size + total_size);
+        int crossover = zc_policy_crossover(&policy);
+        printf("[Thread %d] Adaptive: %llu copy / %llu zerocopy sends, "
+               "%.3f vs %.3f ns/byte at %zu B, crossover: ",
+               thread_id, policy.sends[0], policy.sends[1],
+               policy.cost_ns_per_byte[0][cls], policy.cost_ns_per_byte[1][cls], header_size + total_size);
+        if (crossover < 0) {
+            printf("none (copy wins)\n");
+        } else {
+            printf("~%llu B\n", 1ULL << crossover);
+        }
+    }
+    if (stats.tx_ts) print_tx_stages(thread_id, stats.tx_ts);
+    if (g_dist != DIST_FIXED) print_size_stats(thread_id, &size_stats);
     
     /* Cleanup */
-    free(iov);
-    destroy_message(msg);
+    free(stats.tx_ts);
+    if (stuck > 0) {
+        fprintf(stderr, "[Thread %d] %u zerocopy sends never completed, leaking the slot ring\n",
+                thread_id, stuck);
+    } else {
+        destroy_zc_ring(ring);
+    }
     close(client_fd);
     free(targ);
     
     return NULL;
 }
 
+/* Raise the open file limit so event-loop mode can hold thousands of sockets */
+void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+            perror("setrlimit RLIMIT_NOFILE failed");
+        }
+    }
+}
+
+/* Print statistics and release a connection owned by an event worker */
+void close_connection(EventWorker *w, Connection *conn) {
+    /* Collect whatever completions are already queued */
+    if (conn->zerocopy_enabled) {
+        process_zerocopy_completions(conn->fd, &conn->stats, NULL, 0);
+    }
+    
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    conn->stats.elapsed_time = (end.tv_sec - conn->start.tv_sec) +
+                               (end.tv_nsec - conn->start.tv_nsec) / 1e9;
+    
+    double throughput_gbps = (conn->stats.bytes_sent * 8.0) / (conn->stats.elapsed_time * 1e9);
+    printf("[Worker %d/Conn %d] Stats: %.2f GB sent, %.2f Gbps, %llu messages, %llu completions in %.2f seconds\n",
+           w->worker_id,
+           conn->conn_id,
+           conn->stats.bytes_sent / 1e9,
+           throughput_gbps,
+           conn->stats.messages_sent,
+           conn->stats.completions_received,
+           conn->stats.elapsed_time);
+    
+    epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    free(conn);
+}
+
+/* Switch EPOLLOUT off (parked) or back on for a connection */
+/* Returns -1 if the epoll set could not be updated */
+int set_tx_parked(EventWorker *w, Connection *conn, int parked) {
+    struct epoll_event ev;
+    ev.events = (parked ? 0 : EPOLLOUT) | EPOLLRDHUP;
+    ev.data.ptr = conn;
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+        perror("epoll_ctl MOD failed");
+        return -1;
+    }
+    conn->tx_parked = parked;
+    return 0;
+}
+
+/* Send up to SEND_BUDGET messages on a writable socket with MSG_ZEROCOPY */
+/* Returns -1 if the connection should be closed */
+int send_ready(EventWorker *w, Connection *conn) {
+    struct iovec iov[NUM_FIELDS];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    int send_flags = conn->zerocopy_enabled ? MSG_ZEROCOPY : 0;
+    
+    for (int i = 0; i < SEND_BUDGET; i++) {
+        mh.msg_iovlen = iovec_from_offset(w->iov, NUM_FIELDS, conn->offset, iov);
+        
+        ssize_t sent = sendmsg(conn->fd, &mh, send_flags);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            if (errno == ENOBUFS) {
+                /* Notification budget exhausted: retry if draining freed some, */
+                /* else stop polling EPOLLOUT (it stays ready) until EPOLLERR */
+                int done = process_zerocopy_completions(conn->fd, &conn->stats, NULL, 0);
+                if (done < 0) return -1;
+                if (done > 0) continue;
+                return set_tx_parked(w, conn, 1);
+            }
+            if (errno == EINTR) continue;
+            if (errno != EPIPE && errno != ECONNRESET) {
+                perror("sendmsg error");
+            }
+            return -1;
+        }
+        if (sent == 0) return -1;
+        
+        conn->stats.bytes_sent += sent;
+        conn->offset += sent;
+        if (conn->offset < w->total_size) return 0;  /* Partial send: wait for EPOLLOUT */
+        conn->offset = 0;
+        conn->stats.messages_sent++;
+    }
+    return 0;
+}
+
+/* EPOLLERR on a zero-copy socket usually means completions are queued */
+/* Returns -1 only if the socket carries a real error */
+int handle_error_event(EventWorker *w, Connection *conn) {
+    if (conn->zerocopy_enabled) {
+        int done = process_zerocopy_completions(conn->fd, &conn->stats, NULL, 0);
+        if (done < 0) return -1;
+        
+        /* Completions returned notification budget: resume sending */
+        if (conn->tx_parked && done > 0 && set_tx_parked(w, conn, 0) < 0) return -1;
+    }
+    
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Event-loop worker thread: multiplexes its connections with epoll */
+void* event_worker(void *arg) {
+    EventWorker *w = (EventWorker*)arg;
+    place_thread(w->worker_id);
+    struct epoll_event events[MAX_EVENTS];
+    
+    while (g_running) {
+        int n = epoll_wait(w->epoll_fd, events, MAX_EVENTS, 100);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            Connection *conn = (Connection*)events[i].data.ptr;
+            
+            if (events[i].events & (EPOLLHUP | EPOLLRDHUP)) {
+                close_connection(w, conn);
+                continue;
+            }
+            if ((events[i].events & EPOLLERR) && handle_error_event(w, conn) < 0) {
+                close_connection(w, conn);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && send_ready(w, conn) < 0) {
+                close_connection(w, conn);
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+/* Undo a start_event_workers() that failed at worker failed: stop and join */
+/* the workers already running, then free every worker's epoll set and message */
+void unwind_event_workers(EventWorker *workers, int failed) {
+    bind_memory(-1);
+    g_running = 0;      /* Startup failed, so the server exits anyway */
+    for (int i = 0; i <= failed; i++) {
+        EventWorker *w = &workers[i];
+        if (i < failed) pthread_join(w->thread, NULL);
+        if (w->epoll_fd >= 0) close(w->epoll_fd);
+        if (!g_store) free(w->iov);
+        if (w->msg) release_message(w->msg);
+    }
+    free(workers);
+}
+
+/* Create the event workers, each with its own epoll set and message */
+EventWorker* start_event_workers(int count) {
+    EventWorker *workers = (EventWorker*)calloc(count, sizeof(EventWorker));
+    if (!workers) {
+        perror("Failed to allocate event workers");
+        return NULL;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        EventWorker *w = &workers[i];
+        w->worker_id = i;
+        w->epoll_fd = epoll_create1(0);
+        if (w->epoll_fd < 0) {
+            perror("epoll_create1 failed");
+            unwind_event_workers(workers, i);
+            return NULL;
+        }
+        
+        /* Allocate the worker's message on the node chosen for its CPU */
+        bind_memory(placement_cpu(i));
+        w->msg = acquire_message();
+        if (!w->msg) {
+            unwind_event_workers(workers, i);
+            return NULL;
+        }
+        w->iov = g_store ? g_store->iov : prepare_iovec(w->msg);
+        if (!w->iov) {
+            perror("Failed to prepare iovec");
+            unwind_event_workers(workers, i);
+            return NULL;
+        }
+        for (int j = 0; j < NUM_FIELDS; j++) {
+            w->total_size += w->msg->field_sizes[j];
+        }
+        
+        bind_memory(-1);
+        
+        if (pthread_create(&w->thread, NULL, event_worker, w) != 0) {
+            perror("Failed to create event worker");
+            unwind_event_workers(workers, i);
+            return NULL;
+        }
+    }
+    
+    return workers;
+}
+
+/* Hand an accepted socket to an event worker's epoll set */
+int add_connection(EventWorker *w, int client_fd, int conn_id,
+                   struct sockaddr_in *client_addr) {
+    Connection *conn = (Connection*)calloc(1, sizeof(Connection));
+    if (!conn) {
+        perror("Failed to allocate connection");
+        return -1;
+    }
+    
+    int flags = fcntl(client_fd, F_GETFL, 0);
+    fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
+    
+    /* Enable SO_ZEROCOPY on the socket, falling back to regular send */
+    int one = 1;
+    if (setsockopt(client_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+        conn->zerocopy_enabled = 1;
+    }
+    
+    /* Set TCP_NODELAY to disable Nagle's algorithm */
+    int flag = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    
+    /* Increase send buffer for zero-copy efficiency */
+    int sndbuf = 1024 * 1024;  /* 1MB */
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    
+    conn->fd = client_fd;
+    conn->conn_id = conn_id;
+    conn->client_addr = *client_addr;
+    clock_gettime(CLOCK_MONOTONIC, &conn->start);
+    
+    /* Level-triggered EPOLLOUT keeps the per-event send budget fair; */
+    /* EPOLLERR is always reported and signals queued completions */
+    struct epoll_event ev;
+    ev.events = EPOLLOUT | EPOLLRDHUP;
+    ev.data.ptr = conn;
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, client_fd, &ev) < 0) {
+        perror("epoll_ctl ADD failed");
+        free(conn);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* Create the AF_UNIX listening socket for -u, replacing any stale socket file */
+int open_unix_listener(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(g_unix_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", g_unix_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, g_unix_path);
+    
+    int fd = socket(AF_UNIX, g_unix_type, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        return -1;
+    }
+    
+    unlink(g_unix_path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind failed");
+        close(fd);
+        return -1;
+    }
+    
+    if (listen(fd, BACKLOG) < 0) {
+        perror("listen failed");
+        close(fd);
+        unlink(g_unix_path);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* Create a listening socket; all listeners on the port join one SO_REUSEPORT group */
+int open_listener(int port) {
+    if (g_unix_path) return open_unix_listener();
+    
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        return -1;
+    }
+    
+    /* Set socket options */
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    
+    /* Bind to address */
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+    
+    if (bind(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("bind failed");
+        close(fd);
+        return -1;
+    }
+    
+    /* Listen for connections */
+    if (listen(fd, BACKLOG) < 0) {
+        perror("listen failed");
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* Reuseport CBPF: pick the first shard whose workers run on the CPU that processed */
+/* the SYN; returning an index past the group makes the kernel fall back to the hash */
+int attach_cpu_steering(int listen_fd) {
+    int len = 2 * g_shards + 2;
+    struct sock_filter *code = (struct sock_filter*)malloc(len * sizeof(struct sock_filter));
+    if (!code) {
+        perror("Failed to allocate steering program");
+        return -1;
+    }
+    
+    int n = 0;
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+    for (int i = 0; i < g_shards; i++) {
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, placement_cpu(i), 0, 1);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, i);
+    }
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    
+    struct sock_fprog prog = { .len = (unsigned short)n, .filter = code };
+    int ret = setsockopt(listen_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+    if (ret < 0) perror("SO_ATTACH_REUSEPORT_CBPF failed");
+    free(code);
+    return ret;
+}
+
+/* Shard worker: accepts on its shard's listener and serves each connection inline, */
+/* so there is no shared accept queue and no pthread_create() per connection */
+void* shard_worker(void *arg) {
+    ShardWorker *w = (ShardWorker*)arg;
+    int served = 0;
+    
+    place_thread(w->shard_id);
+    
+    while (g_running) {
+        struct sockaddr_in client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        
+        int client_fd = accept(w->listen_fd, (struct sockaddr*)&client_addr, &addr_len);
+        if (client_fd < 0) {
+            if (errno == EINTR || !g_running) continue;
+            perror("accept failed");
+            continue;
+        }
+        
+        ThreadArg *targ = (ThreadArg*)malloc(sizeof(ThreadArg));
+        if (!targ) {
+            perror("Failed to allocate thread argument");
+            close(client_fd);
+            continue;
+        }
+        
+        /* With steering, the RX softirq CPU should be the one this worker is pinned to */
+        if (g_steer_cpu) {
+            int rx_cpu = -1;
+            socklen_t len = sizeof(rx_cpu);
+            getsockopt(client_fd, SOL_SOCKET, SO_INCOMING_CPU, &rx_cpu, &len);
+            printf("[Shard %d] Connection from RX CPU %d, served on CPU %d\n",
+                   w->shard_id, rx_cpu, sched_getcpu());
+        }
+        
+        /* Worker w of W numbers its connections w, w+W, w+2W, ... */
+        int total = g_shards * g_shard_workers;
+        targ->client_fd = client_fd;
+        targ->thread_id = w->worker_id + served++ * total;
+        targ->client_addr = client_addr;
+        
+        client_handler(targ);
+    }
+    
+    return NULL;
+}
+
+/* Open every shard's listener, then start the workers with SIGINT blocked */
+ShardWorker* start_shards(int port, int count) {
+    ShardWorker *shards = (ShardWorker*)calloc(count, sizeof(ShardWorker));
+    if (!shards) {
+        perror("Failed to allocate shard workers");
+        return NULL;
+    }
+    
+    /* All listeners join the group before the first accept, in shard order */
+    for (int i = 0; i < count; i++) {
+        shards[i].worker_id = i;
+        shards[i].shard_id = i / g_shard_workers;
+        if (i % g_shard_workers == 0) {
+            shards[i].listen_fd = open_listener(port);
+            if (shards[i].listen_fd < 0) return NULL;
+        } else {
+            shards[i].listen_fd = shards[i - 1].listen_fd;
+        }
+    }
+    
+    /* The program is shared by the whole group, socket index = shard index */
+    if (g_steer_cpu && attach_cpu_steering(shards[0].listen_fd) < 0) return NULL;
+    
+    /* SIGINT stays blocked in every thread and main() collects it with sigwait() */
+    sigset_t sigint;
+    sigemptyset(&sigint);
+    sigaddset(&sigint, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &sigint, NULL);
+    
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&shards[i].thread, NULL, shard_worker, &shards[i]) != 0) {
+            perror("Failed to create shard worker");
+            return NULL;
+        }
+    }
+    
+    return shards;
+}
+
 void print_usage(const char *prog) {
-    fprintf(stderr, "Usage: %s [-p port] [-s message_size]\n", prog);
+    fprintf(stderr, "Usage: %s [-p port] [-u [seqpacket:]path] [-s message_size] [-D dist] [-F] [-x down|up|both] [-w listeners[:workers]] [-b] [-S] [-e workers] [-k slots] [-g] [-z mode] [-r] [-T] [-c cpus] [-P spread|pack] [-N same|cross]\n", prog);
     fprintf(stderr, "  -p port         : Server port (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -u path         : Listen on an AF_UNIX SOCK_STREAM socket at path instead of\n");
+    fprintf(stderr, "                    TCP, or SOCK_SEQPACKET with a seqpacket: prefix\n");
     fprintf(stderr, "  -s message_size : Message size in bytes (default: %d)\n", DEFAULT_MSG_SIZE);
+    fprintf(stderr, "  -D dist         : Message sizes: fixed, uniform:MIN:MAX, bimodal:SMALL:LARGE:P,\n");
+    fprintf(stderr, "                    lognormal:MEDIAN:SIGMA, pareto:MIN:ALPHA (clamped to -s)\n");
+    fprintf(stderr, "                    or trace:FILE with \"size [gap_us]\" lines (default: fixed)\n");
+    fprintf(stderr, "  -F              : Frame every message with a length/seq/timestamp header\n");
+    fprintf(stderr, "                    (streaming thread-per-connection mode, client needs -F)\n");
+    fprintf(stderr, "  -x dir          : down (send), up (receive the client's upload with\n");
+    fprintf(stderr, "                    TCP_ZEROCOPY_RECEIVE) or both at once (default: down)\n");
+    fprintf(stderr, "  -w N[:K]        : N SO_REUSEPORT listeners, each with K pre-spawned workers\n");
+    fprintf(stderr, "                    (default: 1) that accept and serve one connection at a time\n");
+    fprintf(stderr, "  -b              : Steer each connection to the shard pinned to the CPU\n");
+    fprintf(stderr, "                    that received it (reuseport CBPF, default -w: one per CPU)\n");
+    fprintf(stderr, "  -S              : Send every connection's message from one shared, read-only\n");
+    fprintf(stderr, "                    store on 2 MB pages instead of a per-connection copy\n");
+    fprintf(stderr, "  -e workers      : Event-loop mode with N epoll worker threads\n");
+    fprintf(stderr, "                    (default: one thread per connection)\n");
+    fprintf(stderr, "  -r              : Request/response mode: send one message per client\n");
+    fprintf(stderr, "                    request, echoing its header (thread mode only)\n");
+    fprintf(stderr, "  -T              : SO_TIMESTAMPING breakdown of each send into\n");
+    fprintf(stderr, "                    user->qdisc, qdisc->wire, wire->ack (thread mode only)\n");
+    fprintf(stderr, "  -k slots        : Message slots per connection; a slot is rewritten\n");
+    fprintf(stderr, "                    only after its zero-copy sends complete (default: %d)\n",
+            DEFAULT_SLOTS);
+    fprintf(stderr, "  -g              : Put all slots in one 2 MB page mapping (hugetlb or THP)\n");
+    fprintf(stderr, "                    instead of a 4 KB aligned allocation per field\n");
+    fprintf(stderr, "  -z mode         : always (MSG_ZEROCOPY), never (plain copy), or\n");
+    fprintf(stderr, "                    auto (choose per send from completion feedback)\n");
+    fprintf(stderr, "                    (default: always)\n");
+    fprintf(stderr, "  -c cpus         : Pin connection/worker threads round-robin to a CPU list\n");
+    fprintf(stderr, "                    such as 0-3,8 (default: unpinned)\n");
+    fprintf(stderr, "  -P policy       : spread (one per physical core first) or pack (SMT siblings)\n");
+    fprintf(stderr, "  -N node         : same or cross: message buffers on the thread's NUMA node\n");
+    fprintf(stderr, "                    or on the next node\n");
 }
 
 int main(int argc, char *argv[]) {
     int port = DEFAULT_PORT;
     int opt;
+    const char *cpu_list = NULL;
+    int slots_given = 0;        /* -k was passed */
+    int use_store = 0;
+    const char *dist_spec = NULL;
     
-    while ((opt = getopt(argc, argv, "p:s:h")) != -1) {
+    while ((opt = getopt(argc, argv, "p:u:s:D:w:bSFx:ge:k:z:rTc:P:N:h")) != -1) {
         switch (opt) {
             case 'p':
                 port = atoi(optarg);
                 break;
+            case 'u':
+                /* [stream:|seqpacket:]PATH */
+                if (strncmp(optarg, "seqpacket:", 10) == 0) {
+                    g_unix_type = SOCK_SEQPACKET;
+                    g_unix_path = optarg + 10;
+                } else {
+                    g_unix_path = strncmp(optarg, "stream:", 7) == 0 ? optarg + 7 : optarg;
+                }
+                break;
             case 's':
                 g_message_size = atoi(optarg);
                 break;
+            case 'b':
+                g_steer_cpu = 1;
+                break;
+            case 'S':
+                use_store = 1;
+                break;
+            case 'D':
+                dist_spec = optarg;
+                break;
+            case 'F':
+                g_framing = 1;
+                break;
+            case 'x':
+                if (strcmp(optarg, "down") == 0) {
+                    g_direction = DIR_DOWN;
+                } else if (strcmp(optarg, "up") == 0) {
+                    g_direction = DIR_UP;
+                } else if (strcmp(optarg, "both") == 0) {
+                    g_direction = DIR_BOTH;
+                } else {
+                    fprintf(stderr, "Unknown direction: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'w': {
+                char *sep = strchr(optarg, ':');
+                g_shards = atoi(optarg);
+                if (sep) g_shard_workers = atoi(sep + 1);
+                break;
+            }
+            case 'e':
+                g_event_workers = atoi(optarg);
+                break;
+            case 'r':
+                g_request_response = 1;
+                break;
+            case 'T':
+                g_timestamping = 1;
+                break;
+            case 'g':
+                g_huge_slots = 1;
+                break;
+            case 'k':
+                g_slots = atoi(optarg);
+                if (g_slots < 1) g_slots = 1;
+                slots_given = 1;
+                break;
+            case 'z':
+                if (strcmp(optarg, "always") == 0) {
+                    g_zc_mode = ZC_MODE_ALWAYS;
+                } else if (strcmp(optarg, "never") == 0) {
+                    g_zc_mode = ZC_MODE_NEVER;
+                } else if (strcmp(optarg, "auto") == 0) {
+                    g_zc_mode = ZC_MODE_AUTO;
+                } else {
+                    fprintf(stderr, "Unknown zero-copy mode: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                cpu_list = optarg;
+                break;
+            case 'P':
+                if (strcmp(optarg, "spread") == 0) {
+                    g_place_policy = PLACE_SPREAD;
+                } else if (strcmp(optarg, "pack") == 0) {
+                    g_place_policy = PLACE_PACK;
+                } else {
+                    fprintf(stderr, "Unknown placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'N':
+                if (strcmp(optarg, "same") == 0) {
+                    g_mem_policy = MEM_SAME;
+                } else if (strcmp(optarg, "cross") == 0) {
+                    g_mem_policy = MEM_CROSS;
+                } else {
+                    fprintf(stderr, "Unknown memory placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
             case 'h':
             default:
                 print_usage(argv[0]);
@@ -338,50 +2242,146 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    /* Set up signal handlers */
-    signal(SIGINT, signal_handler);
-    signal(SIGPIPE, SIG_IGN);
+    /* Steering needs every shard pinned, default to all CPUs we may run on */
+    if (g_steer_cpu && g_place_policy == PLACE_NONE && !cpu_list) g_place_policy = PLACE_LIST;
+    if (setup_placement(cpu_list) < 0) return 1;
     
-    /* Create socket */
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        perror("socket creation failed");
+    /* After getopt so a trace can raise -s to its largest message */
+    if (dist_spec && parse_dist(dist_spec) < 0) return 1;
+    if (g_steer_cpu && g_shards == 0) g_shards = g_cpu_count;
+    
+    if (g_shards < 0 || g_shard_workers < 1) {
+        fprintf(stderr, "-w needs a positive listener and worker count\n");
         return 1;
     }
     
-    /* Set socket options */
-    int reuse = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    if (g_dist != DIST_FIXED && (g_event_workers > 0 || g_request_response)) {
+        fprintf(stderr, "-D is only supported in streaming thread-per-connection mode\n");
+        return 1;
+    }
     
-    /* Bind to address */
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(port);
+    if (g_direction != DIR_DOWN && (g_event_workers > 0 || g_request_response)) {
+        fprintf(stderr, "-x up/both is only supported in streaming thread-per-connection mode\n");
+        return 1;
+    }
     
-    if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("bind failed");
-        close(server_fd);
+    if (g_framing && (g_event_workers > 0 || g_request_response)) {
+        fprintf(stderr, "-F is only supported in streaming thread-per-connection mode\n");
         return 1;
     }
     
-    /* Listen for connections */
-    if (listen(server_fd, BACKLOG) < 0) {
-        perror("listen failed");
-        close(server_fd);
+    if (g_shards > 0 && g_event_workers > 0) {
+        fprintf(stderr, "-w and -e cannot be combined\n");
         return 1;
     }
     
+    if ((g_request_response || g_timestamping) && g_event_workers > 0) {
+        fprintf(stderr, "-r and -T are only supported in thread-per-connection mode\n");
+        return 1;
+    }
+    
+    /* Event workers always send their one immutable message with MSG_ZEROCOPY */
+    if (g_event_workers > 0 && (slots_given || g_huge_slots || g_zc_mode != ZC_MODE_ALWAYS)) {
+        fprintf(stderr, "-k, -g and -z never/auto are only supported in thread-per-connection mode\n");
+        return 1;
+    }
+    
+    if (g_unix_path && (g_shards > 0 || g_timestamping)) {
+        fprintf(stderr, "-u cannot be combined with -w/-b (SO_REUSEPORT) or -T (no TX timestamps on AF_UNIX)\n");
+        return 1;
+    }
+    
+    /* Set up signal handlers */
+    signal(SIGINT, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+    
+    /* Built before any worker or connection so they all see the same pages */
+    if (use_store) {
+        g_store = create_message_store(g_message_size);
+        if (!g_store) return 1;
+    }
+    
+    /* Create the listening socket, or one per shard worker */
+    int server_fd = -1;
+    ShardWorker *shards = NULL;
+    if (g_shards > 0) {
+        shards = start_shards(port, g_shards * g_shard_workers);
+        if (!shards) return 1;
+    } else {
+        server_fd = open_listener(port);
+        if (server_fd < 0) return 1;
+    }
+    
     printf("A3 Zero-Copy Server started on port %d (message size: %d bytes)\n",
            port, g_message_size);
     printf("Using sendmsg() with MSG_ZEROCOPY\n");
     printf("Kernel behavior: Page pinning + DMA from user space\n");
+    if (g_unix_path) {
+        printf("Transport: AF_UNIX %s at %s (-p unused)\n",
+               g_unix_type == SOCK_SEQPACKET ? "SOCK_SEQPACKET" : "SOCK_STREAM", g_unix_path);
+        printf("AF_UNIX has no SO_ZEROCOPY: sends fall back to copying into the peer's queue\n");
+    }
+    
+    EventWorker *workers = NULL;
+    if (g_event_workers > 0) {
+        raise_fd_limit();
+        workers = start_event_workers(g_event_workers);
+        if (!workers) {
+            close(server_fd);
+            return 1;
+        }
+        printf("Event-loop mode: %d epoll worker threads\n", g_event_workers);
+    }
+    if (g_huge_slots && !g_store) {
+        printf("Slot buffers: one mapping of 2 MB pages per connection\n");
+    }
+    if (g_request_response) {
+        printf("Request/response mode: one %d byte response per request\n", g_message_size);
+    }
+    if (g_timestamping) {
+        printf("SO_TIMESTAMPING: per-send SCHED/SND/ACK stage breakdown\n");
+    }
+    if (g_shards > 0) {
+        printf("Sharded listeners: %d SO_REUSEPORT listeners x %d workers, no per-connection threads\n",
+               g_shards, g_shard_workers);
+    }
+    if (g_direction != DIR_DOWN) {
+        printf("Direction: %s, uploads received with TCP_ZEROCOPY_RECEIVE\n",
+               g_direction == DIR_UP ? "up" : "both");
+    }
+    if (g_framing) {
+        printf("Framing: %zu byte header (length, flags, seq, send timestamp) per message\n",
+               sizeof(FrameHeader));
+    }
+    if (g_dist != DIST_FIXED) {
+        printf("Size distribution: %s, up to %d bytes, per-size breakdown per connection\n",
+               g_dist_name, g_message_size);
+    }
+    if (g_store) {
+        printf("Message store: %zu bytes in one %zu KB %s mapping, shared by all connections\n",
+               g_store->size, g_store->map_size / 1024, g_store->backing);
+    }
+    if (g_steer_cpu) {
+        printf("CPU steering: SO_ATTACH_REUSEPORT_CBPF on SKF_AD_CPU, shard i pinned to CPU i of the list\n");
+    }
+    if (g_cpu_count > 0) {
+        printf("Placement: %s over %d CPUs, %d NUMA node(s)\n",
+               g_placement, g_cpu_count, g_node_count);
+    }
     printf("Press Ctrl+C to stop\n\n");
     
     int thread_id = 0;
     
+    /* Sharded mode: the workers accept, main() just waits for Ctrl+C */
+    if (shards) {
+        sigset_t sigint;
+        sigemptyset(&sigint);
+        sigaddset(&sigint, SIGINT);
+        int sig;
+        sigwait(&sigint, &sig);
+        g_running = 0;
+    }
+    
     /* Accept connections and spawn threads */
     while (g_running) {
         struct sockaddr_in client_addr;
@@ -394,6 +2394,16 @@ int main(int argc, char *argv[]) {
             continue;
         }
         
+        /* Event-loop mode: distribute connections round-robin over workers */
+        if (workers) {
+            int conn_id = thread_id++;
+            if (add_connection(&workers[conn_id % g_event_workers], client_fd,
+                               conn_id, &client_addr) < 0) {
+                close(client_fd);
+            }
+            continue;
+        }
+        
         /* Create thread argument */
         ThreadArg *targ = (ThreadArg*)malloc(sizeof(ThreadArg));
         if (!targ) {
@@ -422,7 +2432,29 @@ int main(int argc, char *argv[]) {
     }
     
     printf("\nServer shutting down...\n");
-    close(server_fd);
+    if (shards) {
+        /* shutdown() wakes the blocked accept() calls, close() alone does not */
+        int total = g_shards * g_shard_workers;
+        for (int i = 0; i < total; i += g_shard_workers) {
+            shutdown(shards[i].listen_fd, SHUT_RDWR);
+        }
+        for (int i = 0; i < total; i++) {
+            pthread_join(shards[i].thread, NULL);
+        }
+        for (int i = 0; i < total; i += g_shard_workers) {
+            close(shards[i].listen_fd);
+        }
+        free(shards);
+    } else {
+        close(server_fd);
+        if (g_unix_path) unlink(g_unix_path);
+    }
+    
+    if (workers) {
+        for (int i = 0; i < g_event_workers; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
     
     return 0;
 }
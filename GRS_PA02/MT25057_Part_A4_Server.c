@@ -0,0 +1,1334 @@
+/*
+ * MT25057
+ * PA02: Analysis of Network I/O primitives using "perf" tool
+ * Part A4: io_uring Asynchronous Send Implementation - Server
+ *
+ * This server submits sends through io_uring instead of calling
+ * send()/sendmsg() synchronously. Two send engines are supported:
+ *
+ * 1. sendmsg: IORING_OP_SENDMSG with the same scatter-gather iovec as A2
+ * 2. zc:      IORING_OP_SEND_ZC from registered (pinned) buffers
+ *
+ * Up to batch-size sends are submitted per io_uring_enter() as one linked
+ * batch. The links run the sends one after another, which keeps the byte
+ * stream in order, so this measures batched submission rather than many
+ * sends in flight at once. For the zero-copy engine, the kernel reports
+ * buffer release with a separate IORING_CQE_F_NOTIF completion in the CQ
+ * ring, so no MSG_ERRQUEUE polling is needed (contrast with
+ * process_zerocopy_completions in A3), and a buffer stays held across
+ * batches until its notification arrives.
+ *
+ * Author: Aayush Amritesh (MT25057)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <linux/mempolicy.h>
+#include <linux/filter.h>
+#include <linux/io_uring.h>
+
+#define DEFAULT_PORT 8084
+#define NUM_FIELDS 8
+#define DEFAULT_MSG_SIZE 1024
+#define DEFAULT_BATCH_SIZE 8
+#define MAX_BATCH_SIZE 256
+#define BACKLOG 128
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define DRAIN_WAIT_NS 100000000L    /* io_uring_enter() wait per drain round at close */
+#define DRAIN_IDLE_ROUNDS 50        /* Rounds without a completion before giving up */
+
+/* Send engines */
+#define ENGINE_SENDMSG 0
+#define ENGINE_ZC 1
+
+/* Global configuration */
+static int g_message_size = DEFAULT_MSG_SIZE;
+static int g_engine = ENGINE_SENDMSG;
+static int g_batch_size = DEFAULT_BATCH_SIZE;
+static int g_shards = 0;          /* 0 = single listener, accept() in main() */
+static int g_shard_workers = 1;   /* Workers accepting on each shard's listener */
+static int g_steer_cpu = 0;       /* -b: steer connections to the shard on the SYN's CPU */
+
+/* AF_UNIX transport (-u) */
+static const char *g_unix_path = NULL;     /* NULL = TCP on -p port */
+static int g_unix_type = SOCK_STREAM;      /* or SOCK_SEQPACKET */
+static volatile int g_running = 1;
+
+/* Message structure with 8 dynamically allocated string fields */
+typedef struct {
+    char *fields[NUM_FIELDS];
+    size_t field_sizes[NUM_FIELDS];
+} Message;
+
+/* Shared message store (-S): one immutable copy of the message, built once at */
+/* startup on 2 MB pages, that every connection sends from */
+typedef struct {
+    Message msg;            /* fields[] point into base, back to back */
+    char *base;
+    size_t size;            /* Message bytes */
+    size_t map_size;        /* Mapping size, a multiple of HUGE_PAGE_SIZE */
+    const char *backing;    /* "hugetlb", "thp" or "4k" */
+} MessageStore;
+
+static MessageStore *g_store = NULL;
+
+/* Thread argument structure */
+typedef struct {
+    int client_fd;
+    int thread_id;
+    struct sockaddr_in client_addr;
+} ThreadArg;
+
+/* Sharded listener worker (-w) */
+typedef struct {
+    pthread_t thread;
+    int worker_id;
+    int shard_id;
+    int listen_fd;      /* The shard's own SO_REUSEPORT listener */
+} ShardWorker;
+
+/* Statistics structure */
+typedef struct {
+    unsigned long long bytes_sent;
+    unsigned long long messages_sent;
+    unsigned long long completions_received;
+    unsigned long long submit_calls;
+    unsigned long long sends_submitted;
+    double elapsed_time;
+} Stats;
+
+/* Minimal io_uring instance built directly on the raw syscalls */
+typedef struct {
+    int ring_fd;
+    unsigned entries;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_map_size;
+    size_t cq_map_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned sq_local_tail;     /* SQEs prepared but not yet published */
+} Uring;
+
+/* One send slot; a connection owns batch-size of these */
+typedef struct {
+    size_t offset;              /* Bytes of this slot's message already sent */
+    int in_batch;               /* Send CQE not yet received */
+    int notif_pending;          /* SEND_ZC buffer still referenced by the kernel */
+    struct iovec iov[NUM_FIELDS];
+    struct msghdr mh;
+    char *zc_buffer;            /* Registered buffer (zc engine) */
+} SendSlot;
+
+/* Thread placement (-c / -P / -N) */
+#define PLACE_NONE 0
+#define PLACE_LIST 1        /* CPUs in the order given with -c */
+#define PLACE_SPREAD 2      /* One CPU per physical core before any SMT sibling */
+#define PLACE_PACK 3        /* Fill the SMT siblings of a core before the next core */
+#define MEM_ANY 0
+#define MEM_SAME 1          /* Buffers on the NUMA node of the thread's CPU */
+#define MEM_CROSS 2         /* Buffers on the next NUMA node, across the interconnect */
+#define MAX_NODES 64
+
+static int g_place_policy = PLACE_NONE;
+static int g_mem_policy = MEM_ANY;
+static int g_cpus[CPU_SETSIZE];     /* CPUs in placement order, used round-robin */
+static int g_cpu_count = 0;
+static int g_node_count = 1;
+static char g_placement[64] = "none";
+
+/* Parse a CPU list such as "0-3,8,10-11", returns the number of CPUs or -1 */
+int parse_cpu_list(const char *list, int *cpus, int max) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return -1;
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && count < max; c++) {
+            cpus[count++] = (int)c;
+        }
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+        else break;
+    }
+    return count;
+}
+
+/* Lowest-numbered SMT sibling of a CPU, identifying its physical core */
+int core_of_cpu(int cpu) {
+    char path[128], line[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return cpu;
+    int siblings[CPU_SETSIZE];
+    int n = fgets(line, sizeof(line), f) ? parse_cpu_list(line, siblings, CPU_SETSIZE) : -1;
+    fclose(f);
+    return n > 0 ? siblings[0] : cpu;
+}
+
+/* NUMA node a CPU belongs to (0 if the topology is not exported) */
+int node_of_cpu(int cpu) {
+    char path[128];
+    for (int node = 0; node < g_node_count; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+    return 0;
+}
+
+/* Build the CPU order from -c / -P and count NUMA nodes */
+int setup_placement(const char *cpu_list) {
+    char path[64];
+    g_node_count = 0;
+    while (g_node_count < MAX_NODES) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", g_node_count);
+        if (access(path, F_OK) != 0) break;
+        g_node_count++;
+    }
+    if (g_node_count == 0) g_node_count = 1;
+    
+    if (cpu_list) {
+        g_cpu_count = parse_cpu_list(cpu_list, g_cpus, CPU_SETSIZE);
+        if (g_cpu_count <= 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+            return -1;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    } else if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        /* Default to every CPU this process may run on */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) g_cpus[g_cpu_count++] = c;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    }
+    
+    if (g_place_policy == PLACE_SPREAD || g_place_policy == PLACE_PACK) {
+        /* Sort key: spread = (sibling rank, core), pack = (core, sibling rank) */
+        int core[CPU_SETSIZE], rank[CPU_SETSIZE];
+        for (int i = 0; i < g_cpu_count; i++) {
+            core[i] = core_of_cpu(g_cpus[i]);
+            rank[i] = 0;
+            for (int j = 0; j < i; j++) {
+                if (core[j] == core[i]) rank[i]++;
+            }
+        }
+        for (int i = 1; i < g_cpu_count; i++) {
+            for (int j = i; j > 0; j--) {
+                int a = j - 1, b = j;
+                int swap = g_place_policy == PLACE_SPREAD ?
+                    (rank[a] > rank[b] || (rank[a] == rank[b] && core[a] > core[b])) :
+                    (core[a] > core[b] || (core[a] == core[b] && rank[a] > rank[b]));
+                if (!swap) break;
+                int t;
+                t = g_cpus[a]; g_cpus[a] = g_cpus[b]; g_cpus[b] = t;
+                t = core[a]; core[a] = core[b]; core[b] = t;
+                t = rank[a]; rank[a] = rank[b]; rank[b] = t;
+            }
+        }
+    }
+    
+    if (g_mem_policy == MEM_CROSS && g_node_count < 2) {
+        fprintf(stderr, "Warning: only one NUMA node, -N cross places memory on the same node\n");
+    }
+    
+    static const char *place_names[] = { "none", "list", "spread", "pack" };
+    static const char *mem_names[] = { "any", "same", "cross" };
+    if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        snprintf(g_placement, sizeof(g_placement), "%s-%s",
+                 place_names[g_place_policy], mem_names[g_mem_policy]);
+    }
+    return 0;
+}
+
+/* CPU for the index-th thread, or -1 when placement is off */
+int placement_cpu(int index) {
+    return g_cpu_count > 0 ? g_cpus[index % g_cpu_count] : -1;
+}
+
+/* Prefer the -N node of a CPU for this thread's future page faults (-1 resets) */
+void bind_memory(int cpu) {
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+    memset(mask, 0, sizeof(mask));
+    
+    if (cpu < 0 || g_mem_policy == MEM_ANY) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        return;
+    }
+    
+    int node = node_of_cpu(cpu);
+    if (g_mem_policy == MEM_CROSS) node = (node + 1) % g_node_count;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    
+    /* MPOL_PREFERRED rather than BIND so a full node degrades instead of failing */
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0) {
+        perror("set_mempolicy failed");
+    }
+}
+
+/* Pin the calling thread to its CPU and place its allocations (first touch) */
+void place_thread(int index) {
+    int cpu = placement_cpu(index);
+    if (cpu < 0) return;
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Failed to pin thread %d to CPU %d\n", index, cpu);
+    }
+    bind_memory(cpu);
+}
+
+/* Signal handler for graceful shutdown */
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* Raw io_uring syscall wrappers */
+int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* Create the ring and map the SQ/CQ rings and the SQE array */
+int uring_init(Uring *ring, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(ring, 0, sizeof(*ring));
+    
+    ring->ring_fd = sys_io_uring_setup(entries, &p);
+    if (ring->ring_fd < 0) {
+        perror("io_uring_setup failed");
+        return -1;
+    }
+    ring->entries = p.sq_entries;
+    
+    ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) ring->sq_map_size = ring->cq_map_size;
+        ring->cq_map_size = ring->sq_map_size;
+    }
+    
+    ring->sq_ptr = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        perror("mmap SQ ring failed");
+        close(ring->ring_fd);
+        return -1;
+    }
+    
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            perror("mmap CQ ring failed");
+            munmap(ring->sq_ptr, ring->sq_map_size);
+            close(ring->ring_fd);
+            return -1;
+        }
+    }
+    
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                                            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                            ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        perror("mmap SQEs failed");
+        return -1;
+    }
+    
+    char *sq = (char*)ring->sq_ptr;
+    char *cq = (char*)ring->cq_ptr;
+    ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    ring->sq_local_tail = *ring->sq_tail;
+    
+    return 0;
+}
+
+/* Tear down the ring mappings */
+void uring_destroy(Uring *ring) {
+    munmap(ring->sqes, ring->entries * sizeof(struct io_uring_sqe));
+    if (ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_map_size);
+    munmap(ring->sq_ptr, ring->sq_map_size);
+    close(ring->ring_fd);
+}
+
+/* Get a zeroed SQE, or NULL if the submission queue is full */
+struct io_uring_sqe* uring_get_sqe(Uring *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->entries) return NULL;
+    
+    unsigned idx = ring->sq_local_tail & *ring->sq_mask;
+    ring->sq_array[idx] = idx;
+    ring->sq_local_tail++;
+    
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+/* Publish prepared SQEs and optionally wait for completions */
+int uring_submit_and_wait(Uring *ring, unsigned wait_nr) {
+    unsigned to_submit = ring->sq_local_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    
+    int ret;
+    do {
+        ret = sys_io_uring_enter(ring->ring_fd, to_submit, wait_nr,
+                                 wait_nr ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR && g_running);
+    return ret;
+}
+
+/* Publish prepared SQEs and wait up to timeout_ns for wait_nr completions */
+/* A timeout or signal returns 0, so the caller can re-check its state */
+int uring_submit_and_wait_timeout(Uring *ring, unsigned wait_nr, long timeout_ns) {
+    unsigned to_submit = ring->sq_local_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout_ns / 1000000000L;
+    ts.tv_nsec = timeout_ns % 1000000000L;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (unsigned long long)&ts;
+    
+    int ret = (int)syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, wait_nr,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                           &arg, sizeof(arg));
+    if (ret < 0 && (errno == ETIME || errno == EINTR)) return 0;
+    return ret;
+}
+
+/* Peek the next completion without consuming it */
+struct io_uring_cqe* uring_peek_cqe(Uring *ring) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+/* Mark the completion returned by uring_peek_cqe as consumed */
+void uring_cqe_seen(Uring *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/* Allocate and initialize message structure */
+Message* create_message(size_t total_size) {
+    Message *msg = (Message*)malloc(sizeof(Message));
+    if (!msg) {
+        perror("Failed to allocate message structure");
+        return NULL;
+    }
+    
+    /* Distribute size among 8 fields */
+    size_t field_size = total_size / NUM_FIELDS;
+    size_t remainder = total_size % NUM_FIELDS;
+    
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        size_t size = field_size + (i < (int)remainder ? 1 : 0);
+        msg->field_sizes[i] = size;
+        msg->fields[i] = (char*)malloc(size);
+        if (!msg->fields[i]) {
+            perror("Failed to allocate message field");
+            for (int j = 0; j < i; j++) {
+                free(msg->fields[j]);
+            }
+            free(msg);
+            return NULL;
+        }
+        /* Initialize with pattern data */
+        memset(msg->fields[i], 'A' + i, size);
+    }
+    
+    return msg;
+}
+
+/* Free message structure */
+void destroy_message(Message *msg) {
+    if (msg) {
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            free(msg->fields[i]);
+        }
+        free(msg);
+    }
+}
+
+/* kB of transparent huge pages in the mapping that contains addr, from its */
+/* AnonHugePages line in /proc/self/smaps, or -1 if it cannot be read */
+long thp_backed_kb(const void *addr) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return -1;
+    
+    char line[256];
+    int in_range = 0;
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long lo, hi;
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            if (in_range) break;
+            in_range = (uintptr_t)addr >= lo && (uintptr_t)addr < hi;
+        } else if (in_range && sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    
+    fclose(f);
+    return kb;
+}
+
+/* Map size bytes on 2 MB pages: the hugetlb pool if it has pages reserved, */
+/* otherwise a 2 MB aligned anonymous mapping advised for transparent huge pages */
+/* backing is only "thp" if smaps shows huge pages under the whole range */
+void* map_huge(size_t size, size_t *map_size, const char **backing) {
+    *map_size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void *p = mmap(NULL, *map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        *backing = "hugetlb";
+        return p;
+    }
+    
+    /* Over-map by one huge page and trim, so THP can back the region from its start */
+    char *raw = (char*)mmap(NULL, *map_size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    char *aligned = (char*)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (aligned > raw) munmap(raw, aligned - raw);
+    if (raw + HUGE_PAGE_SIZE > aligned) {
+        munmap(aligned + *map_size, raw + HUGE_PAGE_SIZE - aligned);
+    }
+    *backing = "4k";
+    if (madvise(aligned, *map_size, MADV_HUGEPAGE) == 0) {
+        /* THP is decided at fault time, so fault the range in before asking what backs it */
+        memset(aligned, 0, *map_size);
+        if (thp_backed_kb(aligned) >= (long)(*map_size / 1024)) *backing = "thp";
+    }
+    return aligned;
+}
+
+/* Build the shared store: same field sizes and pattern as create_message(), */
+/* but laid out contiguously in one huge page mapping */
+MessageStore* create_message_store(size_t total_size) {
+    MessageStore *store = (MessageStore*)calloc(1, sizeof(MessageStore));
+    if (!store) {
+        perror("Failed to allocate message store");
+        return NULL;
+    }
+    
+    store->base = (char*)map_huge(total_size, &store->map_size, &store->backing);
+    if (!store->base) {
+        perror("Failed to map message store");
+        free(store);
+        return NULL;
+    }
+    store->size = total_size;
+    
+    size_t field_size = total_size / NUM_FIELDS;
+    size_t remainder = total_size % NUM_FIELDS;
+    size_t offset = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        size_t size = field_size + (i < (int)remainder ? 1 : 0);
+        store->msg.fields[i] = store->base + offset;
+        store->msg.field_sizes[i] = size;
+        memset(store->msg.fields[i], 'A' + i, size);
+        offset += size;
+    }
+    
+    /* Left writable: IORING_REGISTER_BUFFERS pins pages for write and would fail */
+    /* on a read-only mapping; nothing in the server writes to it after this */
+    
+    return store;
+}
+
+/* Message for a connection or worker: the shared store (-S) or a private copy */
+Message* acquire_message(void) {
+    return g_store ? &g_store->msg : create_message(g_message_size);
+}
+
+/* Release a message from acquire_message(), the store lives until exit */
+void release_message(Message *msg) {
+    if (!g_store) destroy_message(msg);
+}
+
+/* Serialize message into a page-aligned buffer suitable for registration */
+char* serialize_message(Message *msg, size_t *total_size) {
+    *total_size = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        *total_size += msg->field_sizes[i];
+    }
+    
+    char *buffer;
+    if (posix_memalign((void**)&buffer, 4096, *total_size) != 0) {
+        return NULL;
+    }
+    
+    size_t offset = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        memcpy(buffer + offset, msg->fields[i], msg->field_sizes[i]);
+        offset += msg->field_sizes[i];
+    }
+    
+    return buffer;
+}
+
+/* Build an iovec view of the message that skips the first offset bytes */
+int iovec_from_offset(const Message *msg, size_t offset, struct iovec *dst) {
+    int n = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        if (offset >= msg->field_sizes[i]) {
+            offset -= msg->field_sizes[i];
+            continue;
+        }
+        dst[n].iov_base = msg->fields[i] + offset;
+        dst[n].iov_len = msg->field_sizes[i] - offset;
+        offset = 0;
+        n++;
+    }
+    return n;
+}
+
+/* Prepare the SQE that sends the remainder of a slot's message */
+void prep_send(struct io_uring_sqe *sqe, int fd, int slot_idx, SendSlot *slot,
+               Message *msg, size_t total_size) {
+    sqe->fd = fd;
+    sqe->user_data = (unsigned long long)slot_idx;
+    /* MSG_WAITALL makes io_uring retry short sends on stream sockets */
+    sqe->msg_flags = MSG_WAITALL;
+    
+    if (g_engine == ENGINE_ZC) {
+        sqe->opcode = IORING_OP_SEND_ZC;
+        sqe->addr = (unsigned long long)(slot->zc_buffer + slot->offset);
+        sqe->len = total_size - slot->offset;
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = slot_idx;
+    } else {
+        memset(&slot->mh, 0, sizeof(slot->mh));
+        slot->mh.msg_iov = slot->iov;
+        slot->mh.msg_iovlen = iovec_from_offset(msg, slot->offset, slot->iov);
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (unsigned long long)&slot->mh;
+        sqe->len = 1;
+    }
+}
+
+/* Client handler thread function */
+void* client_handler(void *arg) {
+    ThreadArg *targ = (ThreadArg*)arg;
+    int client_fd = targ->client_fd;
+    int thread_id = targ->thread_id;
+    
+    /* Pin before allocating so the message is first touched on the chosen node */
+    /* (shard workers stay on their shard's CPU) */
+    if (!g_shards) place_thread(thread_id);
+    int batch_size = g_batch_size;
+    int stuck = 0;      /* Sends or notifications never completed: leak their buffers */
+    
+    if (g_unix_path) {
+        printf("[Thread %d] Client connected on %s\n", thread_id, g_unix_path);
+    } else {
+        printf("[Thread %d] Client connected from %s:%d\n",
+               thread_id,
+               inet_ntoa(targ->client_addr.sin_addr),
+               ntohs(targ->client_addr.sin_port));
+    }
+    
+    /* Create message structure, or use the shared store */
+    Message *msg = acquire_message();
+    if (!msg) {
+        close(client_fd);
+        free(targ);
+        return NULL;
+    }
+    
+    size_t total_size = 0;
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        total_size += msg->field_sizes[i];
+    }
+    
+    /* Ring needs room for a full batch plus the notifications it produces */
+    Uring ring;
+    if (uring_init(&ring, batch_size * 2) < 0) {
+        release_message(msg);
+        close(client_fd);
+        free(targ);
+        return NULL;
+    }
+    
+    SendSlot *slots = (SendSlot*)calloc(batch_size, sizeof(SendSlot));
+    struct iovec *reg = (struct iovec*)calloc(batch_size, sizeof(struct iovec));
+    if (!slots || !reg) {
+        perror("Failed to allocate send slots");
+        goto cleanup;
+    }
+    
+    /* zc engine: one serialized copy per slot, registered (pinned) once */
+    /* With -S every slot registers the store, which is already serialized */
+    if (g_engine == ENGINE_ZC) {
+        for (int i = 0; i < batch_size; i++) {
+            size_t size = total_size;
+            slots[i].zc_buffer = g_store ? g_store->base : serialize_message(msg, &size);
+            if (!slots[i].zc_buffer) {
+                perror("Failed to allocate registered buffer");
+                goto cleanup;
+            }
+            reg[i].iov_base = slots[i].zc_buffer;
+            reg[i].iov_len = size;
+        }
+        if (sys_io_uring_register(ring.ring_fd, IORING_REGISTER_BUFFERS, reg, batch_size) < 0) {
+            perror("IORING_REGISTER_BUFFERS failed");
+            goto cleanup;
+        }
+    }
+    
+    Stats stats = {0, 0, 0, 0, 0, 0.0};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    /* Set TCP_NODELAY to disable Nagle's algorithm */
+    int flag = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    
+    /*
+     * Sends are submitted as linked batches so the byte stream stays in
+     * order. head is the oldest slot whose message is not fully sent;
+     * every batch walks the slots starting there, so a short or
+     * cancelled send is always resumed before any fresh message.
+     */
+    int head = 0;
+    int outstanding = 0;    /* Sends submitted whose CQE has not arrived */
+    int notifs_pending = 0;
+    int closed = 0;
+    
+    while (g_running && !closed) {
+        int batch = 0;
+        struct io_uring_sqe *last = NULL;
+        
+        for (int k = 0; k < batch_size; k++) {
+            int idx = (head + k) % batch_size;
+            SendSlot *slot = &slots[idx];
+            /* A fresh message may not reuse a buffer the kernel still holds */
+            if (slot->offset == 0 && slot->notif_pending) break;
+            
+            struct io_uring_sqe *sqe = uring_get_sqe(&ring);
+            if (!sqe) break;
+            prep_send(sqe, client_fd, idx, slot, msg, total_size);
+            sqe->flags |= IOSQE_IO_LINK;
+            slot->in_batch = 1;
+            last = sqe;
+            batch++;
+        }
+        if (last) last->flags &= ~IOSQE_IO_LINK;
+        
+        if (uring_submit_and_wait(&ring, 1) < 0) {
+            if (g_running) perror("io_uring_enter failed");
+            break;
+        }
+        stats.submit_calls++;
+        stats.sends_submitted += batch;
+        
+        /* Reap until this batch's sends have all completed */
+        outstanding = batch;
+        while (1) {
+            struct io_uring_cqe *cqe;
+            while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+                SendSlot *slot = &slots[cqe->user_data];
+                
+                if (cqe->flags & IORING_CQE_F_NOTIF) {
+                    /* Kernel released the registered buffer */
+                    slot->notif_pending = 0;
+                    notifs_pending--;
+                    stats.completions_received++;
+                } else {
+                    slot->in_batch = 0;
+                    outstanding--;
+                    if (cqe->flags & IORING_CQE_F_MORE) {
+                        slot->notif_pending = 1;
+                        notifs_pending++;
+                    }
+                    if (cqe->res > 0) {
+                        stats.bytes_sent += cqe->res;
+                        slot->offset += cqe->res;
+                        if (slot->offset >= total_size) {
+                            slot->offset = 0;
+                            stats.messages_sent++;
+                        }
+                    } else if (cqe->res == 0 ||
+                               (cqe->res != -ECANCELED && cqe->res != -EINTR)) {
+                        if (cqe->res < 0 && cqe->res != -EPIPE && cqe->res != -ECONNRESET) {
+                            fprintf(stderr, "[Thread %d] send error: %s\n",
+                                    thread_id, strerror(-cqe->res));
+                        }
+                        closed = 1;
+                    }
+                }
+                uring_cqe_seen(&ring);
+            }
+            
+            if (outstanding == 0 || !g_running) break;
+            if (uring_submit_and_wait(&ring, 1) < 0) {
+                closed = 1;
+                break;
+            }
+        }
+        
+        /* Advance head to the first slot that still has unsent bytes */
+        for (int k = 0; k < batch_size; k++) {
+            int idx = (head + k) % batch_size;
+            if (slots[idx].offset != 0) {
+                head = idx;
+                break;
+            }
+        }
+    }
+    
+    /* The kernel holds the slot buffers until every send has completed and */
+    /* every SEND_ZC notification is in, so block in io_uring_enter() for them */
+    int idle = 0;
+    while ((outstanding > 0 || notifs_pending > 0) && idle < DRAIN_IDLE_ROUNDS) {
+        if (uring_submit_and_wait_timeout(&ring, 1, DRAIN_WAIT_NS) < 0) {
+            perror("io_uring_enter failed while draining");
+            break;
+        }
+        int reaped = 0;
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+            if (cqe->flags & IORING_CQE_F_NOTIF) {
+                notifs_pending--;
+                stats.completions_received++;
+            } else {
+                outstanding--;
+                if (cqe->flags & IORING_CQE_F_MORE) notifs_pending++;
+                if (cqe->res > 0) stats.bytes_sent += cqe->res;
+            }
+            uring_cqe_seen(&ring);
+            reaped++;
+        }
+        idle = reaped > 0 ? 0 : idle + 1;
+    }
+    stuck = outstanding > 0 || notifs_pending > 0;
+    if (stuck) {
+        fprintf(stderr, "[Thread %d] %d sends and %d notifications never completed, "
+                "leaking the ring and its buffers\n", thread_id, outstanding, notifs_pending);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats.elapsed_time = (end.tv_sec - start.tv_sec) +
+                         (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    /* Print statistics */
+    double throughput_gbps = (stats.bytes_sent * 8.0) / (stats.elapsed_time * 1e9);
+    double sends_per_submit = stats.submit_calls > 0 ?
+                              (double)stats.sends_submitted / stats.submit_calls : 0;
+    printf("[Thread %d] Stats: %.2f GB sent, %.2f Gbps, %llu messages, %llu completions, "
+           "%.2f sends/submit in %.2f seconds\n",
+           thread_id,
+           stats.bytes_sent / 1e9,
+           throughput_gbps,
+           stats.messages_sent,
+           stats.completions_received,
+           sends_per_submit,
+           stats.elapsed_time);
+
+cleanup:
+    if (!stuck) {
+        uring_destroy(&ring);
+        if (slots) {
+            for (int i = 0; i < batch_size; i++) {
+                if (!g_store) free(slots[i].zc_buffer);
+            }
+        }
+        free(slots);
+        free(reg);
+        release_message(msg);
+    }
+    close(client_fd);
+    free(targ);
+    
+    return NULL;
+}
+
+/* Create the AF_UNIX listening socket for -u, replacing any stale socket file */
+int open_unix_listener(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(g_unix_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", g_unix_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, g_unix_path);
+    
+    int fd = socket(AF_UNIX, g_unix_type, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        return -1;
+    }
+    
+    unlink(g_unix_path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind failed");
+        close(fd);
+        return -1;
+    }
+    
+    if (listen(fd, BACKLOG) < 0) {
+        perror("listen failed");
+        close(fd);
+        unlink(g_unix_path);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* Create a listening socket; all listeners on the port join one SO_REUSEPORT group */
+int open_listener(int port) {
+    if (g_unix_path) return open_unix_listener();
+    
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        return -1;
+    }
+    
+    /* Set socket options */
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+    
+    /* Bind to address */
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+    
+    if (bind(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("bind failed");
+        close(fd);
+        return -1;
+    }
+    
+    /* Listen for connections */
+    if (listen(fd, BACKLOG) < 0) {
+        perror("listen failed");
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* Reuseport CBPF: pick the first shard whose workers run on the CPU that processed */
+/* the SYN; returning an index past the group makes the kernel fall back to the hash */
+int attach_cpu_steering(int listen_fd) {
+    int len = 2 * g_shards + 2;
+    struct sock_filter *code = (struct sock_filter*)malloc(len * sizeof(struct sock_filter));
+    if (!code) {
+        perror("Failed to allocate steering program");
+        return -1;
+    }
+    
+    int n = 0;
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+    for (int i = 0; i < g_shards; i++) {
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, placement_cpu(i), 0, 1);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, i);
+    }
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    
+    struct sock_fprog prog = { .len = (unsigned short)n, .filter = code };
+    int ret = setsockopt(listen_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+    if (ret < 0) perror("SO_ATTACH_REUSEPORT_CBPF failed");
+    free(code);
+    return ret;
+}
+
+/* Shard worker: accepts on its shard's listener and serves each connection inline, */
+/* so there is no shared accept queue and no pthread_create() per connection */
+void* shard_worker(void *arg) {
+    ShardWorker *w = (ShardWorker*)arg;
+    int served = 0;
+    
+    place_thread(w->shard_id);
+    
+    while (g_running) {
+        struct sockaddr_in client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        
+        int client_fd = accept(w->listen_fd, (struct sockaddr*)&client_addr, &addr_len);
+        if (client_fd < 0) {
+            if (errno == EINTR || !g_running) continue;
+            perror("accept failed");
+            continue;
+        }
+        
+        ThreadArg *targ = (ThreadArg*)malloc(sizeof(ThreadArg));
+        if (!targ) {
+            perror("Failed to allocate thread argument");
+            close(client_fd);
+            continue;
+        }
+        
+        /* With steering, the RX softirq CPU should be the one this worker is pinned to */
+        if (g_steer_cpu) {
+            int rx_cpu = -1;
+            socklen_t len = sizeof(rx_cpu);
+            getsockopt(client_fd, SOL_SOCKET, SO_INCOMING_CPU, &rx_cpu, &len);
+            printf("[Shard %d] Connection from RX CPU %d, served on CPU %d\n",
+                   w->shard_id, rx_cpu, sched_getcpu());
+        }
+        
+        /* Worker w of W numbers its connections w, w+W, w+2W, ... */
+        int total = g_shards * g_shard_workers;
+        targ->client_fd = client_fd;
+        targ->thread_id = w->worker_id + served++ * total;
+        targ->client_addr = client_addr;
+        
+        client_handler(targ);
+    }
+    
+    return NULL;
+}
+
+/* Open every shard's listener, then start the workers with SIGINT blocked */
+ShardWorker* start_shards(int port, int count) {
+    ShardWorker *shards = (ShardWorker*)calloc(count, sizeof(ShardWorker));
+    if (!shards) {
+        perror("Failed to allocate shard workers");
+        return NULL;
+    }
+    
+    /* All listeners join the group before the first accept, in shard order */
+    for (int i = 0; i < count; i++) {
+        shards[i].worker_id = i;
+        shards[i].shard_id = i / g_shard_workers;
+        if (i % g_shard_workers == 0) {
+            shards[i].listen_fd = open_listener(port);
+            if (shards[i].listen_fd < 0) return NULL;
+        } else {
+            shards[i].listen_fd = shards[i - 1].listen_fd;
+        }
+    }
+    
+    /* The program is shared by the whole group, socket index = shard index */
+    if (g_steer_cpu && attach_cpu_steering(shards[0].listen_fd) < 0) return NULL;
+    
+    /* SIGINT stays blocked in every thread and main() collects it with sigwait() */
+    sigset_t sigint;
+    sigemptyset(&sigint);
+    sigaddset(&sigint, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &sigint, NULL);
+    
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&shards[i].thread, NULL, shard_worker, &shards[i]) != 0) {
+            perror("Failed to create shard worker");
+            return NULL;
+        }
+    }
+    
+    return shards;
+}
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-p port] [-u [seqpacket:]path] [-s message_size] [-w listeners[:workers]] [-b] [-S] [-m engine] [-q batch] [-c cpus] [-P spread|pack] [-N same|cross]\n", prog);
+    fprintf(stderr, "  -p port         : Server port (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -u path         : Listen on an AF_UNIX SOCK_STREAM socket at path instead of\n");
+    fprintf(stderr, "                    TCP, or SOCK_SEQPACKET with a seqpacket: prefix\n");
+    fprintf(stderr, "  -s message_size : Message size in bytes (default: %d)\n", DEFAULT_MSG_SIZE);
+    fprintf(stderr, "  -w N[:K]        : N SO_REUSEPORT listeners, each with K pre-spawned workers\n");
+    fprintf(stderr, "                    (default: 1) that accept and serve one connection at a time\n");
+    fprintf(stderr, "  -b              : Steer each connection to the shard pinned to the CPU\n");
+    fprintf(stderr, "                    that received it (reuseport CBPF, default -w: one per CPU)\n");
+    fprintf(stderr, "  -S              : Send every connection's message from one shared, read-only\n");
+    fprintf(stderr, "                    store on 2 MB pages instead of a per-connection copy\n");
+    fprintf(stderr, "  -m engine       : sendmsg (IORING_OP_SENDMSG) or zc (IORING_OP_SEND_ZC)\n");
+    fprintf(stderr, "                    (default: sendmsg)\n");
+    fprintf(stderr, "  -q batch        : Sends submitted per io_uring_enter() as one linked batch;\n");
+    fprintf(stderr, "                    the links run them in order (default: %d, max: %d)\n",
+            DEFAULT_BATCH_SIZE, MAX_BATCH_SIZE);
+    fprintf(stderr, "  -c cpus         : Pin connection/worker threads round-robin to a CPU list\n");
+    fprintf(stderr, "                    such as 0-3,8 (default: unpinned)\n");
+    fprintf(stderr, "  -P policy       : spread (one per physical core first) or pack (SMT siblings)\n");
+    fprintf(stderr, "  -N node         : same or cross: message buffers on the thread's NUMA node\n");
+    fprintf(stderr, "                    or on the next node\n");
+}
+
+int main(int argc, char *argv[]) {
+    int port = DEFAULT_PORT;
+    int opt;
+    const char *cpu_list = NULL;
+    int use_store = 0;
+    
+    while ((opt = getopt(argc, argv, "p:u:s:w:bSm:q:c:P:N:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 'u':
+                /* [stream:|seqpacket:]PATH */
+                if (strncmp(optarg, "seqpacket:", 10) == 0) {
+                    g_unix_type = SOCK_SEQPACKET;
+                    g_unix_path = optarg + 10;
+                } else {
+                    g_unix_path = strncmp(optarg, "stream:", 7) == 0 ? optarg + 7 : optarg;
+                }
+                break;
+            case 's':
+                g_message_size = atoi(optarg);
+                break;
+            case 'b':
+                g_steer_cpu = 1;
+                break;
+            case 'S':
+                use_store = 1;
+                break;
+            case 'w': {
+                char *sep = strchr(optarg, ':');
+                g_shards = atoi(optarg);
+                if (sep) g_shard_workers = atoi(sep + 1);
+                break;
+            }
+            case 'm':
+                if (strcmp(optarg, "sendmsg") == 0) {
+                    g_engine = ENGINE_SENDMSG;
+                } else if (strcmp(optarg, "zc") == 0) {
+                    g_engine = ENGINE_ZC;
+                } else {
+                    fprintf(stderr, "Unknown engine: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'q':
+                g_batch_size = atoi(optarg);
+                break;
+            case 'c':
+                cpu_list = optarg;
+                break;
+            case 'P':
+                if (strcmp(optarg, "spread") == 0) {
+                    g_place_policy = PLACE_SPREAD;
+                } else if (strcmp(optarg, "pack") == 0) {
+                    g_place_policy = PLACE_PACK;
+                } else {
+                    fprintf(stderr, "Unknown placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'N':
+                if (strcmp(optarg, "same") == 0) {
+                    g_mem_policy = MEM_SAME;
+                } else if (strcmp(optarg, "cross") == 0) {
+                    g_mem_policy = MEM_CROSS;
+                } else {
+                    fprintf(stderr, "Unknown memory placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'h':
+            default:
+                print_usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    
+    /* Steering needs every shard pinned, default to all CPUs we may run on */
+    if (g_steer_cpu && g_place_policy == PLACE_NONE && !cpu_list) g_place_policy = PLACE_LIST;
+    if (setup_placement(cpu_list) < 0) return 1;
+    if (g_steer_cpu && g_shards == 0) g_shards = g_cpu_count;
+    
+    if (g_shards < 0 || g_shard_workers < 1) {
+        fprintf(stderr, "-w needs a positive listener and worker count\n");
+        return 1;
+    }
+    
+    if (g_batch_size < 1 || g_batch_size > MAX_BATCH_SIZE) {
+        fprintf(stderr, "Batch size must be between 1 and %d\n", MAX_BATCH_SIZE);
+        return 1;
+    }
+    
+    if (g_unix_path && (g_shards > 0 || g_engine == ENGINE_ZC)) {
+        fprintf(stderr, "-u cannot be combined with -w/-b (SO_REUSEPORT) or -m zc (no SEND_ZC on AF_UNIX)\n");
+        return 1;
+    }
+    
+    /* Set up signal handlers */
+    signal(SIGINT, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+    
+    /* Built before any worker or connection so they all see the same pages */
+    if (use_store) {
+        g_store = create_message_store(g_message_size);
+        if (!g_store) return 1;
+    }
+    
+    /* Create the listening socket, or one per shard worker */
+    int server_fd = -1;
+    ShardWorker *shards = NULL;
+    if (g_shards > 0) {
+        shards = start_shards(port, g_shards * g_shard_workers);
+        if (!shards) return 1;
+    } else {
+        server_fd = open_listener(port);
+        if (server_fd < 0) return 1;
+    }
+    
+    printf("A4 io_uring Server started on port %d (message size: %d bytes)\n",
+           port, g_message_size);
+    if (g_engine == ENGINE_ZC) {
+        printf("Using IORING_OP_SEND_ZC with registered buffers, linked batches of %d\n",
+               g_batch_size);
+        printf("Completions: IORING_CQE_F_NOTIF entries in the CQ ring\n");
+    } else {
+        printf("Using IORING_OP_SENDMSG with scatter-gather I/O, linked batches of %d\n",
+               g_batch_size);
+    }
+    if (g_unix_path) {
+        printf("Transport: AF_UNIX %s at %s (-p unused)\n",
+               g_unix_type == SOCK_SEQPACKET ? "SOCK_SEQPACKET" : "SOCK_STREAM", g_unix_path);
+    }
+    if (g_shards > 0) {
+        printf("Sharded listeners: %d SO_REUSEPORT listeners x %d workers, no per-connection threads\n",
+               g_shards, g_shard_workers);
+    }
+    if (g_store) {
+        printf("Message store: %zu bytes in one %zu KB %s mapping, shared by all connections\n",
+               g_store->size, g_store->map_size / 1024, g_store->backing);
+    }
+    if (g_steer_cpu) {
+        printf("CPU steering: SO_ATTACH_REUSEPORT_CBPF on SKF_AD_CPU, shard i pinned to CPU i of the list\n");
+    }
+    if (g_cpu_count > 0) {
+        printf("Placement: %s over %d CPUs, %d NUMA node(s)\n",
+               g_placement, g_cpu_count, g_node_count);
+    }
+    printf("Press Ctrl+C to stop\n\n");
+    
+    int thread_id = 0;
+    
+    /* Sharded mode: the workers accept, main() just waits for Ctrl+C */
+    if (shards) {
+        sigset_t sigint;
+        sigemptyset(&sigint);
+        sigaddset(&sigint, SIGINT);
+        int sig;
+        sigwait(&sigint, &sig);
+        g_running = 0;
+    }
+    
+    /* Accept connections and spawn threads */
+    while (g_running) {
+        struct sockaddr_in client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        
+        int client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &addr_len);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept failed");
+            continue;
+        }
+        
+        /* Create thread argument */
+        ThreadArg *targ = (ThreadArg*)malloc(sizeof(ThreadArg));
+        if (!targ) {
+            perror("Failed to allocate thread argument");
+            close(client_fd);
+            continue;
+        }
+        
+        targ->client_fd = client_fd;
+        targ->thread_id = thread_id++;
+        targ->client_addr = client_addr;
+        
+        /* Spawn client handler thread */
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        
+        if (pthread_create(&thread, &attr, client_handler, targ) != 0) {
+            perror("Failed to create thread");
+            close(client_fd);
+            free(targ);
+        }
+        
+        pthread_attr_destroy(&attr);
+    }
+    
+    printf("\nServer shutting down...\n");
+    if (shards) {
+        /* shutdown() wakes the blocked accept() calls, close() alone does not */
+        int total = g_shards * g_shard_workers;
+        for (int i = 0; i < total; i += g_shard_workers) {
+            shutdown(shards[i].listen_fd, SHUT_RDWR);
+        }
+        for (int i = 0; i < total; i++) {
+            pthread_join(shards[i].thread, NULL);
+        }
+        for (int i = 0; i < total; i += g_shard_workers) {
+            close(shards[i].listen_fd);
+        }
+        free(shards);
+    } else {
+        close(server_fd);
+        if (g_unix_path) unlink(g_unix_path);
+    }
+    
+    return 0;
+}
+
+/* This code was generated with the assistance of Claude Opus 4.5 by Anthropic. */
@@ -0,0 +1,799 @@
+/*
+ * MT25057
+ * PA02: Analysis of Network I/O primitives using "perf" tool
+ * Part A5: Batched UDP Implementation - Server
+ *
+ * This server streams UDP datagrams and amortises the per-packet syscall
+ * cost by handing the kernel many of them at once with sendmmsg().
+ * Every datagram is a frame header (same layout as -F in A1-A3) followed
+ * by the 8-field message, gathered straight from the fields with an
+ * iovec as in A2.
+ *
+ * A client starts a session by sending a HELLO datagram to the server
+ * port. The session thread answers from its own socket connected to the
+ * client, and stops on the client's BYE or when the kernel reports the
+ * client's port unreachable (ECONNREFUSED).
+ *
+ * Optional send-side offloads:
+ * 1. -G: UDP_SEGMENT (GSO), each sendmmsg() entry carries up to 64
+ *        datagrams that the stack segments after a single route lookup
+ * 2. -z: MSG_ZEROCOPY, the kernel pins the message pages instead of
+ *        copying them and reports completions on the error queue
+ *
+ * Author: Aayush Amritesh (MT25057)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <stdint.h>
+#include <poll.h>
+#include <linux/errqueue.h>
+
+#define DEFAULT_PORT 8085
+#define NUM_FIELDS 8
+#define DEFAULT_MSG_SIZE 1024
+#define DEFAULT_BATCH 32        /* sendmmsg() entries per call */
+#define MAX_BATCH 1024          /* UIO_MAXIOV, the kernel's sendmmsg() limit */
+#define UDP_MAX_PAYLOAD 65507   /* 64 KB minus the IPv4 and UDP headers */
+#define GSO_MAX_SEGMENTS 64     /* Datagrams per UDP_SEGMENT send */
+#define ZC_SLOTS 4              /* Header batches in flight with MSG_ZEROCOPY */
+#define ZC_DRAIN_IDLE 50        /* 10 ms polls without a completion before giving up */
+#define SOCKET_BUFFER (4 * 1024 * 1024)
+
+/* Global configuration */
+static int g_message_size = DEFAULT_MSG_SIZE;
+static int g_batch = DEFAULT_BATCH;
+static int g_gso = 0;
+static int g_zerocopy = 0;
+static volatile int g_running = 1;
+
+/* Message structure with 8 dynamically allocated string fields */
+typedef struct {
+    char *fields[NUM_FIELDS];
+    size_t field_sizes[NUM_FIELDS];
+} Message;
+
+/* Session control: the client sends these to start and stop its stream */
+#define CTRL_MAGIC 0x41355544   /* "DU5A" */
+#define CTRL_HELLO 1            /* To the server port: start a session */
+#define CTRL_BYE 2              /* To the session's socket: stop sending */
+typedef struct {
+    uint32_t magic;
+    uint32_t type;
+} ControlMsg;
+
+/* Frame header: starts every datagram, same layout as -F in A1-A3 */
+#define FRAME_F_ZEROCOPY 0x1    /* Payload was sent with MSG_ZEROCOPY */
+#define FRAME_F_GSO 0x2         /* Datagram was cut from a UDP_SEGMENT send */
+typedef struct {
+    uint32_t length;        /* Payload bytes following the header */
+    uint32_t flags;         /* FRAME_F_* */
+    uint64_t seq;           /* Datagram number in this session, from 0 */
+    uint64_t send_ts_ns;    /* Sender CLOCK_MONOTONIC time when the send was issued */
+} FrameHeader;
+
+/* Thread argument structure */
+typedef struct {
+    int thread_id;
+    struct sockaddr_in client_addr;
+} ThreadArg;
+
+/* Statistics structure */
+typedef struct {
+    unsigned long long bytes_sent;
+    unsigned long long datagrams_sent;
+    unsigned long long send_calls;      /* sendmmsg() calls that sent something */
+    unsigned long long send_blocked;    /* ENOBUFS/EAGAIN: socket or qdisc full */
+    unsigned long long zc_sends;        /* sendmmsg() entries sent with MSG_ZEROCOPY */
+    unsigned long long zc_completed;
+    unsigned long long zc_copied;       /* Completions the kernel copied after all */
+    double elapsed_time;
+} Stats;
+
+/* Thread placement (-c / -P / -N) */
+#define PLACE_NONE 0
+#define PLACE_LIST 1        /* CPUs in the order given with -c */
+#define PLACE_SPREAD 2      /* One CPU per physical core before any SMT sibling */
+#define PLACE_PACK 3        /* Fill the SMT siblings of a core before the next core */
+#define MEM_ANY 0
+#define MEM_SAME 1          /* Buffers on the NUMA node of the thread's CPU */
+#define MEM_CROSS 2         /* Buffers on the next NUMA node, across the interconnect */
+#define MAX_NODES 64
+
+static int g_place_policy = PLACE_NONE;
+static int g_mem_policy = MEM_ANY;
+static int g_cpus[CPU_SETSIZE];     /* CPUs in placement order, used round-robin */
+static int g_cpu_count = 0;
+static int g_node_count = 1;
+static char g_placement[64] = "none";
+
+/* Parse a CPU list such as "0-3,8,10-11", returns the number of CPUs or -1 */
+int parse_cpu_list(const char *list, int *cpus, int max) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return -1;
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && count < max; c++) {
+            cpus[count++] = (int)c;
+        }
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+        else break;
+    }
+    return count;
+}
+
+/* Lowest-numbered SMT sibling of a CPU, identifying its physical core */
+int core_of_cpu(int cpu) {
+    char path[128], line[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return cpu;
+    int siblings[CPU_SETSIZE];
+    int n = fgets(line, sizeof(line), f) ? parse_cpu_list(line, siblings, CPU_SETSIZE) : -1;
+    fclose(f);
+    return n > 0 ? siblings[0] : cpu;
+}
+
+/* NUMA node a CPU belongs to (0 if the topology is not exported) */
+int node_of_cpu(int cpu) {
+    char path[128];
+    for (int node = 0; node < g_node_count; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+    return 0;
+}
+
+/* Build the CPU order from -c / -P and count NUMA nodes */
+int setup_placement(const char *cpu_list) {
+    char path[64];
+    g_node_count = 0;
+    while (g_node_count < MAX_NODES) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", g_node_count);
+        if (access(path, F_OK) != 0) break;
+        g_node_count++;
+    }
+    if (g_node_count == 0) g_node_count = 1;
+    
+    if (cpu_list) {
+        g_cpu_count = parse_cpu_list(cpu_list, g_cpus, CPU_SETSIZE);
+        if (g_cpu_count <= 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+            return -1;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    } else if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        /* Default to every CPU this process may run on */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) g_cpus[g_cpu_count++] = c;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    }
+    
+    if (g_place_policy == PLACE_SPREAD || g_place_policy == PLACE_PACK) {
+        /* Sort key: spread = (sibling rank, core), pack = (core, sibling rank) */
+        int core[CPU_SETSIZE], rank[CPU_SETSIZE];
+        for (int i = 0; i < g_cpu_count; i++) {
+            core[i] = core_of_cpu(g_cpus[i]);
+            rank[i] = 0;
+            for (int j = 0; j < i; j++) {
+                if (core[j] == core[i]) rank[i]++;
+            }
+        }
+        for (int i = 1; i < g_cpu_count; i++) {
+            for (int j = i; j > 0; j--) {
+                int a = j - 1, b = j;
+                int swap = g_place_policy == PLACE_SPREAD ?
+                    (rank[a] > rank[b] || (rank[a] == rank[b] && core[a] > core[b])) :
+                    (core[a] > core[b] || (core[a] == core[b] && rank[a] > rank[b]));
+                if (!swap) break;
+                int t;
+                t = g_cpus[a]; g_cpus[a] = g_cpus[b]; g_cpus[b] = t;
+                t = core[a]; core[a] = core[b]; core[b] = t;
+                t = rank[a]; rank[a] = rank[b]; rank[b] = t;
+            }
+        }
+    }
+    
+    if (g_mem_policy == MEM_CROSS && g_node_count < 2) {
+        fprintf(stderr, "Warning: only one NUMA node, -N cross places memory on the same node\n");
+    }
+    
+    static const char *place_names[] = { "none", "list", "spread", "pack" };
+    static const char *mem_names[] = { "any", "same", "cross" };
+    if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        snprintf(g_placement, sizeof(g_placement), "%s-%s",
+                 place_names[g_place_policy], mem_names[g_mem_policy]);
+    }
+    return 0;
+}
+
+/* CPU for the index-th thread, or -1 when placement is off */
+int placement_cpu(int index) {
+    return g_cpu_count > 0 ? g_cpus[index % g_cpu_count] : -1;
+}
+
+/* Prefer the -N node of a CPU for this thread's future page faults (-1 resets) */
+void bind_memory(int cpu) {
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+    memset(mask, 0, sizeof(mask));
+    
+    if (cpu < 0 || g_mem_policy == MEM_ANY) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        return;
+    }
+    
+    int node = node_of_cpu(cpu);
+    if (g_mem_policy == MEM_CROSS) node = (node + 1) % g_node_count;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    
+    /* MPOL_PREFERRED rather than BIND so a full node degrades instead of failing */
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0) {
+        perror("set_mempolicy failed");
+    }
+}
+
+/* Pin the calling thread to its CPU and place its allocations (first touch) */
+void place_thread(int index) {
+    int cpu = placement_cpu(index);
+    if (cpu < 0) return;
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Failed to pin thread %d to CPU %d\n", index, cpu);
+    }
+    bind_memory(cpu);
+}
+
+/* Signal handler for graceful shutdown */
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* Allocate and initialize message structure */
+Message* create_message(size_t total_size) {
+    Message *msg = (Message*)malloc(sizeof(Message));
+    if (!msg) {
+        perror("Failed to allocate message structure");
+        return NULL;
+    }
+    
+    /* Distribute size among 8 fields */
+    size_t field_size = total_size / NUM_FIELDS;
+    size_t remainder = total_size % NUM_FIELDS;
+    
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        size_t size = field_size + (i < (int)remainder ? 1 : 0);
+        msg->field_sizes[i] = size;
+        msg->fields[i] = (char*)malloc(size);
+        if (!msg->fields[i]) {
+            perror("Failed to allocate message field");
+            for (int j = 0; j < i; j++) {
+                free(msg->fields[j]);
+            }
+            free(msg);
+            return NULL;
+        }
+        /* Initialize with pattern data */
+        memset(msg->fields[i], 'A' + i, size);
+    }
+    
+    return msg;
+}
+
+/* Free message structure */
+void destroy_message(Message *msg) {
+    if (msg) {
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            free(msg->fields[i]);
+        }
+        free(msg);
+    }
+}
+
+/* Fill in the frame header of a session's next datagram */
+void frame_stamp(FrameHeader *hdr, uint32_t length, uint64_t seq, uint32_t flags) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    hdr->length = length;
+    hdr->flags = flags;
+    hdr->seq = seq;
+    hdr->send_ts_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* Datagrams per sendmmsg() entry: a full UDP_SEGMENT send with -G, else one */
+int segments_per_send(size_t datagram_size) {
+    if (!g_gso) return 1;
+    int segs = UDP_MAX_PAYLOAD / datagram_size;
+    return segs > GSO_MAX_SEGMENTS ? GSO_MAX_SEGMENTS : segs;
+}
+
+/* Read MSG_ZEROCOPY notifications, first waiting up to timeout_ms for one */
+/* Each sendmmsg() entry is one sendmsg() to the kernel and gets its own ID */
+void reap_completions(int fd, Stats *stats, int timeout_ms) {
+    if (timeout_ms > 0) {
+        struct pollfd pfd = { fd, 0, 0 };   /* POLLERR is always reported */
+        poll(&pfd, 1, timeout_ms);
+    }
+    
+    char control[128];
+    while (1) {
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_control = control;
+        mh.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &mh, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) break;
+        
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm; cm = CMSG_NXTHDR(&mh, cm)) {
+            if (cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR) continue;
+            struct sock_extended_err *serr = (struct sock_extended_err*)CMSG_DATA(cm);
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            
+            /* [ee_info, ee_data] is the range of send IDs completed */
+            unsigned long long ids = serr->ee_data - serr->ee_info + 1;
+            stats->zc_completed += ids;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) stats->zc_copied += ids;
+        }
+    }
+}
+
+/* Point each sendmmsg() entry at its run of iov_per_entry iovecs */
+void layout_entries(struct mmsghdr *msgs, struct iovec *iov, int iov_per_entry) {
+    for (int e = 0; e < g_batch; e++) {
+        msgs[e].msg_hdr.msg_iov = iov + (size_t)e * iov_per_entry;
+        msgs[e].msg_hdr.msg_iovlen = iov_per_entry;
+    }
+}
+
+/* 1 once the client has sent BYE, -1 if its port is unreachable, else 0 */
+int session_closed(int fd) {
+    ControlMsg ctrl;
+    ssize_t n = recv(fd, &ctrl, sizeof(ctrl), MSG_DONTWAIT);
+    if (n == (ssize_t)sizeof(ctrl) && ctrl.magic == CTRL_MAGIC && ctrl.type == CTRL_BYE) return 1;
+    if (n < 0 && errno == ECONNREFUSED) return -1;
+    return 0;
+}
+
+/* Open the session's own socket, connected to the client so sends skip */
+/* the per-datagram address and route lookup */
+int open_session_socket(const struct sockaddr_in *client_addr, int thread_id) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket creation failed");
+        return -1;
+    }
+    
+    int sndbuf = SOCKET_BUFFER;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    
+    if (connect(fd, (const struct sockaddr*)client_addr, sizeof(*client_addr)) < 0) {
+        perror("connect failed");
+        close(fd);
+        return -1;
+    }
+    
+    if (g_gso) {
+        /* Every send is cut into datagram_size segments, the last one may be short */
+        int gso_size = sizeof(FrameHeader) + g_message_size;
+        if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)) < 0) {
+            fprintf(stderr, "[Thread %d] setsockopt UDP_SEGMENT failed: %s\n",
+                    thread_id, strerror(errno));
+            close(fd);
+            return -1;
+        }
+    }
+    
+    return fd;
+}
+
+/* Session handler - streams datagrams to one client until it leaves */
+void* session_handler(void *arg) {
+    ThreadArg *targ = (ThreadArg*)arg;
+    int thread_id = targ->thread_id;
+    
+    /* Pin before allocating so the message is first touched on the chosen node */
+    place_thread(thread_id);
+    
+    printf("[Thread %d] Session from %s:%d\n",
+           thread_id,
+           inet_ntoa(targ->client_addr.sin_addr),
+           ntohs(targ->client_addr.sin_port));
+    
+    int fd = open_session_socket(&targ->client_addr, thread_id);
+    if (fd < 0) {
+        free(targ);
+        return NULL;
+    }
+    
+    int send_flags = 0;
+    uint32_t frame_flags = g_gso ? FRAME_F_GSO : 0;
+    if (g_zerocopy) {
+        int one = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+            perror("setsockopt SO_ZEROCOPY failed - sending with regular sendmmsg");
+        } else {
+            send_flags = MSG_ZEROCOPY;
+            frame_flags |= FRAME_F_ZEROCOPY;
+        }
+    }
+    
+    Message *msg = create_message(g_message_size);
+    if (!msg) {
+        close(fd);
+        free(targ);
+        return NULL;
+    }
+    
+    /* Layout: every sendmmsg() entry gathers segs datagrams, each its own */
+    /* header followed by the 8 shared fields. With MSG_ZEROCOPY the kernel */
+    /* keeps reading the headers after the call, so they rotate through */
+    /* ZC_SLOTS batches and a batch is only restamped once it completed */
+    size_t datagram_size = sizeof(FrameHeader) + g_message_size;
+    int segs = segments_per_send(datagram_size);
+    int per_batch = g_batch * segs;
+    int slot_stride = per_batch;    /* Headers per slot, kept if segs shrinks */
+    int slots = send_flags ? ZC_SLOTS : 1;
+    int iov_per_entry = segs * (NUM_FIELDS + 1);
+    
+    FrameHeader *headers = (FrameHeader*)calloc((size_t)slots * slot_stride, sizeof(FrameHeader));
+    struct iovec *iov = (struct iovec*)malloc((size_t)g_batch * iov_per_entry * sizeof(struct iovec));
+    struct mmsghdr *msgs = (struct mmsghdr*)calloc(g_batch, sizeof(struct mmsghdr));
+    if (!headers || !iov || !msgs) {
+        perror("Failed to allocate send batch");
+        free(headers);
+        free(iov);
+        free(msgs);
+        destroy_message(msg);
+        close(fd);
+        free(targ);
+        return NULL;
+    }
+    
+    for (int i = 0; i < per_batch; i++) {
+        struct iovec *d = iov + (size_t)i * (NUM_FIELDS + 1);
+        d[0].iov_len = sizeof(FrameHeader);
+        for (int f = 0; f < NUM_FIELDS; f++) {
+            d[f + 1].iov_base = msg->fields[f];
+            d[f + 1].iov_len = msg->field_sizes[f];
+        }
+    }
+    layout_entries(msgs, iov, iov_per_entry);
+    
+    Stats stats;
+    memset(&stats, 0, sizeof(stats));
+    unsigned long long slot_ids[ZC_SLOTS] = {0};  /* zc_sends once each slot's batch was queued */
+    uint64_t seq = 0;
+    int slot = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    while (g_running) {
+        int closed = session_closed(fd);
+        if (closed) {
+            if (closed < 0) printf("[Thread %d] Client port unreachable, ending session\n", thread_id);
+            break;
+        }
+        
+        /* Completions are counted, not matched to IDs: UDP completes in order */
+        FrameHeader *batch_headers = headers + (size_t)slot * slot_stride;
+        if (send_flags) {
+            while (g_running && stats.zc_completed < slot_ids[slot]) {
+                reap_completions(fd, &stats, 10);
+            }
+            /* Stopped with the slot still in flight: its headers must not be restamped */
+            if (stats.zc_completed < slot_ids[slot]) break;
+        }
+        
+        for (int i = 0; i < per_batch; i++) {
+            frame_stamp(&batch_headers[i], g_message_size, seq + i, frame_flags);
+            iov[(size_t)i * (NUM_FIELDS + 1)].iov_base = &batch_headers[i];
+        }
+        
+        /* One syscall for the whole batch */
+        int sent = sendmmsg(fd, msgs, g_batch, send_flags);
+        if (sent < 0) {
+            if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR) {
+                /* Nothing left the socket: retry the same sequence numbers */
+                stats.send_blocked++;
+                sched_yield();
+                continue;
+            }
+            if (errno == EMSGSIZE && segs > 1) {
+                /* Zero-copy pins every iovec as its own skb fragment, so a */
+                /* full GSO send can exceed the fragment limit: halve it */
+                segs /= 2;
+                per_batch = g_batch * segs;
+                iov_per_entry = segs * (NUM_FIELDS + 1);
+                layout_entries(msgs, iov, iov_per_entry);
+                printf("[Thread %d] GSO send too large, now %d datagrams per entry\n",
+                       thread_id, segs);
+                continue;
+            }
+            if (errno == ECONNREFUSED) {
+                printf("[Thread %d] Client port unreachable, ending session\n", thread_id);
+            } else {
+                perror("sendmmsg error");
+            }
+            break;
+        }
+        
+        /* A short batch restamps the unsent datagrams with the same numbers next time */
+        seq += (uint64_t)sent * segs;
+        stats.send_calls++;
+        stats.datagrams_sent += (unsigned long long)sent * segs;
+        stats.bytes_sent += (unsigned long long)sent * segs * datagram_size;
+        
+        if (send_flags) {
+            stats.zc_sends += sent;
+            slot_ids[slot] = stats.zc_sends;
+            slot = (slot + 1) % slots;
+            reap_completions(fd, &stats, 0);
+        }
+    }
+    
+    /* The headers and payload stay referenced until every send has completed, */
+    /* so wait for all notifications before freeing them. If they stop coming, */
+    /* keep the buffers rather than free memory the kernel may still read */
+    int idle = 0;
+    while (send_flags && stats.zc_completed < stats.zc_sends && idle < ZC_DRAIN_IDLE) {
+        unsigned long long before = stats.zc_completed;
+        reap_completions(fd, &stats, 10);
+        idle = stats.zc_completed > before ? 0 : idle + 1;
+    }
+    int in_flight = stats.zc_completed < stats.zc_sends;
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats.elapsed_time = (end.tv_sec - start.tv_sec) +
+                         (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    /* Print statistics */
+    double throughput_gbps = (stats.bytes_sent * 8.0) / (stats.elapsed_time * 1e9);
+    printf("[Thread %d] Stats: %.2f GB sent, %.2f Gbps, %llu datagrams (%.0f pkt/s) in %.2f seconds\n",
+           thread_id,
+           stats.bytes_sent / 1e9,
+           throughput_gbps,
+           stats.datagrams_sent,
+           stats.datagrams_sent / stats.elapsed_time,
+           stats.elapsed_time);
+    printf("[Thread %d] sendmmsg calls: %llu, %.1f datagrams per call, %llu blocked (ENOBUFS/EAGAIN)\n",
+           thread_id, stats.send_calls,
+           stats.send_calls > 0 ? (double)stats.datagrams_sent / stats.send_calls : 0,
+           stats.send_blocked);
+    if (send_flags) {
+        printf("[Thread %d] MSG_ZEROCOPY: %llu sends, %llu completions, %.1f%% copied by kernel\n",
+               thread_id, stats.zc_sends, stats.zc_completed,
+               stats.zc_completed > 0 ? 100.0 * stats.zc_copied / stats.zc_completed : 0);
+    }
+    
+    /* Cleanup */
+    if (in_flight) {
+        fprintf(stderr, "[Thread %d] %llu zerocopy sends never completed, leaking their buffers\n",
+                thread_id, stats.zc_sends - stats.zc_completed);
+    } else {
+        free(headers);
+        destroy_message(msg);
+    }
+    free(iov);
+    free(msgs);
+    close(fd);
+    free(targ);
+    
+    return NULL;
+}
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-p port] [-s message_size] [-b batch] [-G] [-z] [-c cpus] [-P spread|pack] [-N same|cross]\n", prog);
+    fprintf(stderr, "  -p port         : Server UDP port (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -s message_size : Message bytes per datagram, after a %zu byte header\n",
+            sizeof(FrameHeader));
+    fprintf(stderr, "                    (default: %d, at most %zu)\n",
+            DEFAULT_MSG_SIZE, UDP_MAX_PAYLOAD - sizeof(FrameHeader));
+    fprintf(stderr, "  -b batch        : sendmmsg() entries per call (default: %d, max %d)\n",
+            DEFAULT_BATCH, MAX_BATCH);
+    fprintf(stderr, "  -G              : UDP_SEGMENT (GSO): each entry carries up to %d datagrams\n",
+            GSO_MAX_SEGMENTS);
+    fprintf(stderr, "  -z              : Send with MSG_ZEROCOPY\n");
+    fprintf(stderr, "  -c cpus         : Pin session threads round-robin to a CPU list\n");
+    fprintf(stderr, "                    such as 0-3,8 (default: unpinned)\n");
+    fprintf(stderr, "  -P policy       : spread (one per physical core first) or pack (SMT siblings)\n");
+    fprintf(stderr, "  -N node         : same or cross: message buffers on the thread's NUMA node\n");
+    fprintf(stderr, "                    or on the next node\n");
+}
+
+int main(int argc, char *argv[]) {
+    int port = DEFAULT_PORT;
+    int opt;
+    const char *cpu_list = NULL;
+    
+    while ((opt = getopt(argc, argv, "p:s:b:Gzc:P:N:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 's':
+                g_message_size = atoi(optarg);
+                break;
+            case 'b':
+                g_batch = atoi(optarg);
+                break;
+            case 'G':
+                g_gso = 1;
+                break;
+            case 'z':
+                g_zerocopy = 1;
+                break;
+            case 'c':
+                cpu_list = optarg;
+                break;
+            case 'P':
+                if (strcmp(optarg, "spread") == 0) {
+                    g_place_policy = PLACE_SPREAD;
+                } else if (strcmp(optarg, "pack") == 0) {
+                    g_place_policy = PLACE_PACK;
+                } else {
+                    fprintf(stderr, "Unknown placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'N':
+                if (strcmp(optarg, "same") == 0) {
+                    g_mem_policy = MEM_SAME;
+                } else if (strcmp(optarg, "cross") == 0) {
+                    g_mem_policy = MEM_CROSS;
+                } else {
+                    fprintf(stderr, "Unknown memory placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'h':
+            default:
+                print_usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    
+    if (setup_placement(cpu_list) < 0) return 1;
+    
+    if (g_message_size < NUM_FIELDS ||
+        g_message_size > UDP_MAX_PAYLOAD - (int)sizeof(FrameHeader)) {
+        fprintf(stderr, "-s must be between %d and %zu bytes to fit one datagram\n",
+                NUM_FIELDS, UDP_MAX_PAYLOAD - sizeof(FrameHeader));
+        return 1;
+    }
+    
+    if (g_batch < 1 || g_batch > MAX_BATCH) {
+        fprintf(stderr, "-b must be between 1 and %d\n", MAX_BATCH);
+        return 1;
+    }
+    
+    /* Set up signal handlers */
+    signal(SIGINT, signal_handler);
+    
+    /* Sessions start with a HELLO datagram on this socket */
+    int server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (server_fd < 0) {
+        perror("socket creation failed");
+        return 1;
+    }
+    
+    int opt_val = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+    
+    /* Wake up periodically so Ctrl+C is noticed between HELLOs */
+    struct timeval tv = { 1, 0 };
+    setsockopt(server_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(port);
+    
+    if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("bind failed");
+        close(server_fd);
+        return 1;
+    }
+    
+    size_t datagram_size = sizeof(FrameHeader) + g_message_size;
+    int segs = segments_per_send(datagram_size);
+    printf("A5 Batched UDP Server started on port %d (message size: %d bytes)\n",
+           port, g_message_size);
+    printf("Using sendmmsg() with %d entries per call, %zu byte datagrams gathered from the fields\n",
+           g_batch, datagram_size);
+    if (g_gso) {
+        printf("UDP_SEGMENT (GSO): %d datagrams per entry, %d per sendmmsg() call\n",
+               segs, segs * g_batch);
+    }
+    if (g_zerocopy) {
+        printf("MSG_ZEROCOPY: %d header batches in flight per session\n", ZC_SLOTS);
+    }
+    if (g_cpu_count > 0) {
+        printf("Placement: %s over %d CPUs, %d NUMA node(s)\n",
+               g_placement, g_cpu_count, g_node_count);
+    }
+    printf("Press Ctrl+C to stop\n\n");
+    
+    int thread_id = 0;
+    
+    /* Receive HELLOs and spawn a session thread for each */
+    while (g_running) {
+        struct sockaddr_in client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        ControlMsg ctrl;
+        
+        ssize_t n = recvfrom(server_fd, &ctrl, sizeof(ctrl), 0,
+                             (struct sockaddr*)&client_addr, &addr_len);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            perror("recvfrom failed");
+            continue;
+        }
+        if (n != (ssize_t)sizeof(ctrl) || ctrl.magic != CTRL_MAGIC || ctrl.type != CTRL_HELLO) {
+            continue;
+        }
+        
+        /* Create thread argument */
+        ThreadArg *targ = (ThreadArg*)malloc(sizeof(ThreadArg));
+        if (!targ) {
+            perror("Failed to allocate thread argument");
+            continue;
+        }
+        
+        targ->thread_id = thread_id++;
+        targ->client_addr = client_addr;
+        
+        /* Spawn session handler thread */
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        
+        if (pthread_create(&thread, &attr, session_handler, targ) != 0) {
+            perror("Failed to create thread");
+            free(targ);
+        }
+        
+        pthread_attr_destroy(&attr);
+    }
+    
+    printf("\nServer shutting down...\n");
+    close(server_fd);
+    
+    return 0;
+}
+
+/* This code was generated with the assistance of Claude Opus 4.5 by Anthropic. */
@@ -0,0 +1,1034 @@
+/*
+ * MT25057
+ * PA02: Analysis of Network I/O primitives using "perf" tool
+ * Part A6: Shared-Memory Ring Implementation - Client
+ *
+ * Each thread connects to the server's control socket, receives its
+ * ring (a memfd and two eventfds) with SCM_RIGHTS and maps it. Messages
+ * are then consumed straight from shared memory: the payload is copied
+ * out of the slot into a receive buffer, as recv() would deliver it,
+ * and the slot is released by advancing the tail.
+ *
+ * When the ring is empty the thread spins briefly on the head index,
+ * then announces that it is waiting and sleeps on the data eventfd; the
+ * server only writes the eventfd when it sees that announcement. The
+ * one-way latency comes from the frame header's send timestamp (both
+ * ends share CLOCK_MONOTONIC, the ring only works on one host anyway).
+ *
+ * Author: Aayush Amritesh (MT25057)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <linux/mempolicy.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <poll.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VERIFY_X86 1
+#endif
+
+#define DEFAULT_PORT 8086
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_DURATION 10
+#define DEFAULT_THREADS 1
+#define DEFAULT_MSG_SIZE 1024
+#define CACHE_LINE 64
+#define NUM_FIELDS 8
+#define RING_SPIN 1024          /* Index re-reads before sleeping on an empty ring */
+#define WAIT_TIMEOUT_MS 100     /* Sleep slice, to check the duration */
+
+/* Global configuration */
+static char g_host[256] = DEFAULT_HOST;
+static int g_port = DEFAULT_PORT;
+static int g_duration = DEFAULT_DURATION;
+static int g_message_size = DEFAULT_MSG_SIZE;
+static int g_interval_ms = 0;         /* 0 = no live reporting */
+static int g_verify = 0;
+static int g_spin = RING_SPIN;        /* 0 on a single CPU, where spinning only delays the other side */
+static volatile int g_running = 1;
+static volatile int g_reporter_done = 0;
+
+/* Latency histogram: log-bucketed (HDR-style), 32 linear sub-buckets per power of two */
+#define HIST_SUB_BITS 5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max_ns;
+} LatencyHistogram;
+
+/* Bucket index for a value in nanoseconds: one clz, no loops */
+int hist_index(uint64_t v) {
+    if (v < HIST_SUB_COUNT) return (int)v;
+    int shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB_COUNT + (int)((v >> shift) - HIST_SUB_COUNT);
+}
+
+/* Midpoint of the value range covered by a bucket, in nanoseconds */
+uint64_t hist_value(int index) {
+    if (index < HIST_SUB_COUNT) return index;
+    int shift = index / HIST_SUB_COUNT - 1;
+    uint64_t low = (uint64_t)(index % HIST_SUB_COUNT + HIST_SUB_COUNT) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+/* Record one latency sample given in microseconds */
+void hist_record(LatencyHistogram *h, double latency_us) {
+    uint64_t ns = latency_us > 0 ? (uint64_t)(latency_us * 1e3) : 0;
+    h->counts[hist_index(ns)]++;
+    h->total++;
+    if (ns > h->max_ns) h->max_ns = ns;
+}
+
+/* Add src into dst (called after the threads are joined, so no locking) */
+void hist_merge(LatencyHistogram *dst, const LatencyHistogram *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    if (src->max_ns > dst->max_ns) dst->max_ns = src->max_ns;
+}
+
+/* Latency at percentile p (0-100) in microseconds */
+double hist_percentile(const LatencyHistogram *h, double p) {
+    if (h->total == 0) return 0;
+    
+    uint64_t target = (uint64_t)(p / 100.0 * h->total + 0.5);
+    if (target < 1) target = 1;
+    
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= target) {
+            uint64_t v = hist_value(i);
+            return (v < h->max_ns ? v : h->max_ns) / 1e3;
+        }
+    }
+    return h->max_ns / 1e3;
+}
+
+/* Frame header: starts every ring slot, same layout as -F in A1-A3 */
+typedef struct {
+    uint32_t length;        /* Payload bytes following the header */
+    uint32_t flags;         /* FRAME_F_* (none used by the ring) */
+    uint64_t seq;           /* Message number in this session, from 0 */
+    uint64_t send_ts_ns;    /* Producer CLOCK_MONOTONIC time when the slot was filled */
+} FrameHeader;
+
+/* Shared ring header, at the start of the memfd and followed by the slots */
+/* Every field a side writes on the data path has a cache line to itself */
+#define RING_MAGIC 0x36474e52   /* "RNG6" */
+typedef struct {
+    uint64_t head __attribute__((aligned(CACHE_LINE)));     /* Messages published (server) */
+    uint64_t tail __attribute__((aligned(CACHE_LINE)));     /* Messages consumed (client) */
+    uint32_t consumer_waiting __attribute__((aligned(CACHE_LINE)));  /* Client asleep on data_efd */
+    uint64_t producer_wake_at __attribute__((aligned(CACHE_LINE)));  /* Server asleep on space_efd */
+                                                            /* until tail reaches this, 0 = awake */
+    uint32_t magic __attribute__((aligned(CACHE_LINE)));    /* Read-only after setup */
+    uint32_t slots;
+    uint32_t slot_size;     /* Frame header + message, rounded up to a cache line */
+    uint32_t msg_size;
+} RingHeader;
+
+/* Control message received with the memfd, data_efd and space_efd */
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t ring_bytes;    /* Size of the memfd */
+} RingHello;
+
+/* One thread's mapping of its ring */
+typedef struct {
+    int data_efd;           /* Server -> client: slots were published */
+    int space_efd;          /* Client -> server: slots were freed */
+    RingHeader *hdr;
+    const char *slots;
+    size_t map_size;
+} ClientRing;
+
+/* Thread statistics structure */
+/* Aligned to a cache line so no two threads' counters share one */
+typedef struct {
+    /* Updated on every message: kept together in the first cache line */
+    unsigned long long bytes_received;
+    unsigned long long messages_received;
+    double latency_sum;
+    unsigned long long latency_count;
+    unsigned long long seq_errors;          /* Slots whose sequence number was not the next one */
+    int thread_id;
+    double elapsed_time;
+    LatencyHistogram hist;      /* Per-message one-way latency distribution */
+    unsigned long long empty_spins;         /* Ring found empty, waited by re-reading the head */
+    unsigned long long empty_sleeps;        /* Ring stayed empty, slept on data_efd */
+    unsigned long long wakeups_sent;        /* space_efd writes for a sleeping server */
+    unsigned long long verify_bytes;        /* -V: payload bytes checked */
+    unsigned long long verify_corrupt;      /* -V: messages with a wrong byte */
+    double verify_ns;                       /* -V: time spent checking */
+} __attribute__((aligned(CACHE_LINE))) ThreadStats;
+
+/* Counters the -i reporter reads while the workers run: each has a single */
+/* writer, so a relaxed store of the new value keeps reads untorn without a */
+/* locked add on the receive path */
+static inline void stat_add(unsigned long long *c, unsigned long long n) {
+    __atomic_store_n(c, *c + n, __ATOMIC_RELAXED);
+}
+
+static inline void stat_add_double(double *c, double n) {
+    double v = *c + n;
+    __atomic_store(c, &v, __ATOMIC_RELAXED);
+}
+
+/* Global statistics */
+static ThreadStats *g_thread_stats;
+static int g_num_threads;
+
+/* Payload verification (-V): every field of a message is one repeated byte, */
+/* so checking a range is finding where a run of one byte value ends */
+
+/* Length of the run of byte c at the start of p (len if all of it matches) */
+size_t run_length_scalar(const char *p, size_t len, char c) {
+    uint64_t pattern = 0x0101010101010101ULL * (unsigned char)c;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        if (word != pattern) break;
+    }
+    while (i < len && p[i] == c) i++;
+    return i;
+}
+
+#ifdef VERIFY_X86
+/* 16 bytes per compare; SSE2 is part of the x86-64 baseline */
+__attribute__((target("sse2")))
+size_t run_length_sse2(const char *p, size_t len, char c) {
+    __m128i pattern = _mm_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+        if (mask != 0xffffu) return i + __builtin_ctz(~mask);
+    }
+    return i + run_length_scalar(p + i, len - i, c);
+}
+
+/* 64 bytes per iteration: two 32-byte compares folded into one movemask */
+__attribute__((target("avx2")))
+size_t run_length_avx2(const char *p, size_t len, char c) {
+    __m256i pattern = _mm256_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i)), pattern);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i + 32)), pattern);
+        if ((unsigned)_mm256_movemask_epi8(_mm256_and_si256(a, b)) != 0xffffffffu) break;
+    }
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+        if (mask != 0xffffffffu) return i + __builtin_ctz(~mask);
+    }
+    return i + run_length_sse2(p + i, len - i, c);
+}
+#endif
+
+/* Kernel picked once in main() from the CPU's feature flags */
+static size_t (*g_run_length)(const char*, size_t, char) = run_length_scalar;
+static const char *g_verify_isa = "scalar";
+
+void init_verify(void) {
+#ifdef VERIFY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        g_run_length = run_length_avx2;
+        g_verify_isa = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        g_run_length = run_length_sse2;
+        g_verify_isa = "sse2";
+    }
+#endif
+}
+
+/* Position in the expected byte stream of one connection */
+typedef struct {
+    size_t msg_size;        /* Length of the messages being checked */
+    size_t offset;          /* Bytes of the current message already checked */
+    int rotation;           /* A3 rotates the field bytes with its slot sequence */
+    int bad;                /* Current message already counted as corrupt */
+} PayloadVerifier;
+
+/* Check the next len bytes of a stream of msg_size messages */
+/* Field i of a message (split like the server's, the first msg_size % NUM_FIELDS */
+/* fields one byte longer) must be all 'A' + (i + rotation) % NUM_FIELDS, where */
+/* the rotation is taken from the message's first byte */
+void verify_payload(PayloadVerifier *v, const char *data, size_t len, ThreadStats *stats) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    stats->verify_bytes += len;
+    
+    size_t field_size = v->msg_size / NUM_FIELDS;
+    size_t remainder = v->msg_size % NUM_FIELDS;
+    size_t long_span = remainder * (field_size + 1);
+    while (len > 0) {
+        if (v->offset == 0) {
+            v->rotation = (unsigned char)(data[0] - 'A') % NUM_FIELDS;
+            v->bad = 0;
+        }
+        
+        int field;
+        size_t field_end;
+        if (v->offset < long_span) {
+            field = v->offset / (field_size + 1);
+            field_end = (field + 1) * (field_size + 1);
+        } else {
+            field = remainder + (v->offset - long_span) / field_size;
+            field_end = long_span + (field - remainder + 1) * field_size;
+        }
+        
+        size_t n = field_end - v->offset < len ? field_end - v->offset : len;
+        char expected = 'A' + (field + v->rotation) % NUM_FIELDS;
+        size_t run = g_run_length(data, n, expected);
+        if (run < n && !v->bad) {
+            v->bad = 1;
+            if (stats->verify_corrupt++ == 0) {
+                fprintf(stderr, "[Thread %d] Corrupt payload: byte %zu of a %zu byte message "
+                        "(field %d) is 0x%02x, expected '%c'\n",
+                        stats->thread_id, v->offset + run, v->msg_size, field,
+                        (unsigned char)data[run], expected);
+            }
+        }
+        
+        data += n;
+        len -= n;
+        v->offset += n;
+        if (v->offset == v->msg_size) v->offset = 0;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    stats->verify_ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+}
+
+/* Thread placement (-c / -P / -N) */
+#define PLACE_NONE 0
+#define PLACE_LIST 1        /* CPUs in the order given with -c */
+#define PLACE_SPREAD 2      /* One CPU per physical core before any SMT sibling */
+#define PLACE_PACK 3        /* Fill the SMT siblings of a core before the next core */
+#define MEM_ANY 0
+#define MEM_SAME 1          /* Buffers on the NUMA node of the thread's CPU */
+#define MEM_CROSS 2         /* Buffers on the next NUMA node, across the interconnect */
+#define MAX_NODES 64
+
+static int g_place_policy = PLACE_NONE;
+static int g_mem_policy = MEM_ANY;
+static int g_cpus[CPU_SETSIZE];     /* CPUs in placement order, used round-robin */
+static int g_cpu_count = 0;
+static int g_node_count = 1;
+static char g_placement[64] = "none";
+
+/* Parse a CPU list such as "0-3,8,10-11", returns the number of CPUs or -1 */
+int parse_cpu_list(const char *list, int *cpus, int max) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return -1;
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && count < max; c++) {
+            cpus[count++] = (int)c;
+        }
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+        else break;
+    }
+    return count;
+}
+
+/* Lowest-numbered SMT sibling of a CPU, identifying its physical core */
+int core_of_cpu(int cpu) {
+    char path[128], line[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return cpu;
+    int siblings[CPU_SETSIZE];
+    int n = fgets(line, sizeof(line), f) ? parse_cpu_list(line, siblings, CPU_SETSIZE) : -1;
+    fclose(f);
+    return n > 0 ? siblings[0] : cpu;
+}
+
+/* NUMA node a CPU belongs to (0 if the topology is not exported) */
+int node_of_cpu(int cpu) {
+    char path[128];
+    for (int node = 0; node < g_node_count; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+    return 0;
+}
+
+/* Build the CPU order from -c / -P and count NUMA nodes */
+int setup_placement(const char *cpu_list) {
+    char path[64];
+    g_node_count = 0;
+    while (g_node_count < MAX_NODES) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", g_node_count);
+        if (access(path, F_OK) != 0) break;
+        g_node_count++;
+    }
+    if (g_node_count == 0) g_node_count = 1;
+    
+    if (cpu_list) {
+        g_cpu_count = parse_cpu_list(cpu_list, g_cpus, CPU_SETSIZE);
+        if (g_cpu_count <= 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+            return -1;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    } else if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        /* Default to every CPU this process may run on */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) g_cpus[g_cpu_count++] = c;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    }
+    
+    if (g_place_policy == PLACE_SPREAD || g_place_policy == PLACE_PACK) {
+        /* Sort key: spread = (sibling rank, core), pack = (core, sibling rank) */
+        int core[CPU_SETSIZE], rank[CPU_SETSIZE];
+        for (int i = 0; i < g_cpu_count; i++) {
+            core[i] = core_of_cpu(g_cpus[i]);
+            rank[i] = 0;
+            for (int j = 0; j < i; j++) {
+                if (core[j] == core[i]) rank[i]++;
+            }
+        }
+        for (int i = 1; i < g_cpu_count; i++) {
+            for (int j = i; j > 0; j--) {
+                int a = j - 1, b = j;
+                int swap = g_place_policy == PLACE_SPREAD ?
+                    (rank[a] > rank[b] || (rank[a] == rank[b] && core[a] > core[b])) :
+                    (core[a] > core[b] || (core[a] == core[b] && rank[a] > rank[b]));
+                if (!swap) break;
+                int t;
+                t = g_cpus[a]; g_cpus[a] = g_cpus[b]; g_cpus[b] = t;
+                t = core[a]; core[a] = core[b]; core[b] = t;
+                t = rank[a]; rank[a] = rank[b]; rank[b] = t;
+            }
+        }
+    }
+    
+    if (g_mem_policy == MEM_CROSS && g_node_count < 2) {
+        fprintf(stderr, "Warning: only one NUMA node, -N cross places memory on the same node\n");
+    }
+    
+    static const char *place_names[] = { "none", "list", "spread", "pack" };
+    static const char *mem_names[] = { "any", "same", "cross" };
+    if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        snprintf(g_placement, sizeof(g_placement), "%s-%s",
+                 place_names[g_place_policy], mem_names[g_mem_policy]);
+    }
+    return 0;
+}
+
+/* CPU for the index-th thread, or -1 when placement is off */
+int placement_cpu(int index) {
+    return g_cpu_count > 0 ? g_cpus[index % g_cpu_count] : -1;
+}
+
+/* Prefer the -N node of a CPU for this thread's future page faults (-1 resets) */
+void bind_memory(int cpu) {
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+    memset(mask, 0, sizeof(mask));
+    
+    if (cpu < 0 || g_mem_policy == MEM_ANY) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        return;
+    }
+    
+    int node = node_of_cpu(cpu);
+    if (g_mem_policy == MEM_CROSS) node = (node + 1) % g_node_count;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    
+    /* MPOL_PREFERRED rather than BIND so a full node degrades instead of failing */
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0) {
+        perror("set_mempolicy failed");
+    }
+}
+
+/* Pin the calling thread to its CPU and place its allocations (first touch) */
+void place_thread(int index) {
+    int cpu = placement_cpu(index);
+    if (cpu < 0) return;
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Failed to pin thread %d to CPU %d\n", index, cpu);
+    }
+    bind_memory(cpu);
+}
+
+/* Signal handler for graceful shutdown */
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* Spin-wait hint between index re-reads */
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/* Abstract AF_UNIX name of the server's control socket; returns the address length */
+socklen_t control_address(int port, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    int n = snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "mt25057_a6_%d", port);
+    return offsetof(struct sockaddr_un, sun_path) + 1 + n;
+}
+
+/* Release a thread's ring */
+void close_ring(ClientRing *ring) {
+    if (ring->hdr) munmap(ring->hdr, ring->map_size);
+    if (ring->data_efd >= 0) close(ring->data_efd);
+    if (ring->space_efd >= 0) close(ring->space_efd);
+}
+
+/* Receive the ring from the control socket and map it */
+/* Returns 0, or -1 with everything released */
+int open_ring(int sockfd, ClientRing *ring, int thread_id) {
+    RingHello hello;
+    int fds[3] = { -1, -1, -1 };
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    
+    ring->hdr = NULL;
+    ring->data_efd = ring->space_efd = -1;
+    ssize_t n = recvmsg(sockfd, &mh, MSG_CMSG_CLOEXEC);
+    struct cmsghdr *cm = n > 0 ? CMSG_FIRSTHDR(&mh) : NULL;
+    if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS &&
+        cm->cmsg_len == CMSG_LEN(sizeof(fds))) {
+        memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+    }
+    ring->data_efd = fds[1];
+    ring->space_efd = fds[2];
+    if (n != (ssize_t)sizeof(hello) || hello.magic != RING_MAGIC || fds[0] < 0) {
+        fprintf(stderr, "[Thread %d] No ring from the server (is it A6?)\n", thread_id);
+        if (fds[0] >= 0) close(fds[0]);
+        close_ring(ring);
+        return -1;
+    }
+    
+    /* The server sealed the size, so the mapping can't be truncated under us */
+    struct stat st;
+    if (fstat(fds[0], &st) < 0 || (uint64_t)st.st_size != hello.ring_bytes ||
+        hello.ring_bytes < sizeof(RingHeader)) {
+        fprintf(stderr, "[Thread %d] Ring size does not match the server's\n", thread_id);
+        close(fds[0]);
+        close_ring(ring);
+        return -1;
+    }
+    
+    ring->map_size = hello.ring_bytes;
+    void *map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (map == MAP_FAILED) {
+        perror("ring mmap failed");
+        close_ring(ring);
+        return -1;
+    }
+    ring->hdr = (RingHeader*)map;
+    ring->slots = (const char*)map + sizeof(RingHeader);
+    
+    RingHeader *r = ring->hdr;
+    if (__atomic_load_n(&r->magic, __ATOMIC_ACQUIRE) != RING_MAGIC ||
+        r->slots == 0 || (r->slots & (r->slots - 1)) != 0 ||
+        r->slot_size < sizeof(FrameHeader) + r->msg_size ||
+        sizeof(RingHeader) + (uint64_t)r->slots * r->slot_size > ring->map_size) {
+        fprintf(stderr, "[Thread %d] Malformed ring header\n", thread_id);
+        close_ring(ring);
+        return -1;
+    }
+    return 0;
+}
+
+/* The ring is empty: spin on the server's head, then sleep on data_efd */
+/* Returns 1 once there is data, 0 on a timeout slice, -1 if the server went away */
+int wait_for_data(ClientRing *ring, uint64_t tail, uint64_t *head_cache,
+                  int sockfd, ThreadStats *stats) {
+    RingHeader *r = ring->hdr;
+    for (int i = 0; i < g_spin; i++) {
+        cpu_relax();
+        *head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (*head_cache != tail) {
+            stats->empty_spins++;
+            return 1;
+        }
+    }
+    
+    /* Announce the sleep, then look again: the server checks the flag after */
+    /* every publish, so either it sees the flag or this sees its new head */
+    stats->empty_sleeps++;
+    __atomic_store_n(&r->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+    *head_cache = __atomic_load_n(&r->head, __ATOMIC_SEQ_CST);
+    if (*head_cache != tail) {
+        __atomic_store_n(&r->consumer_waiting, 0, __ATOMIC_RELAXED);
+        return 1;
+    }
+    
+    /* The server never writes to the control socket again: readable means it closed */
+    struct pollfd pfd[2] = {
+        { ring->data_efd, POLLIN, 0 },
+        { sockfd, POLLIN, 0 },
+    };
+    int n = poll(pfd, 2, WAIT_TIMEOUT_MS);
+    __atomic_store_n(&r->consumer_waiting, 0, __ATOMIC_RELAXED);
+    if (n > 0 && (pfd[0].revents & POLLIN)) {
+        eventfd_t value;
+        eventfd_read(ring->data_efd, &value);
+    }
+    *head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    if (*head_cache != tail) return 1;
+    return n > 0 && pfd[1].revents ? -1 : 0;
+}
+
+/* Consume loop: copy each message out of its slot until the duration ends */
+void consume_ring(ClientRing *ring, int sockfd, ThreadStats *stats, struct timespec *start) {
+    RingHeader *r = ring->hdr;
+    uint32_t mask = r->slots - 1;
+    uint32_t msg_size = r->msg_size;
+    if (msg_size != (uint32_t)g_message_size) {
+        fprintf(stderr, "[Thread %d] Server sends %u byte messages, -s is %d\n",
+                stats->thread_id, msg_size, g_message_size);
+    }
+    
+    char *buffer = (char*)malloc(msg_size);
+    if (!buffer) {
+        perror("Failed to allocate buffer");
+        return;
+    }
+    
+    PayloadVerifier verifier = { msg_size, 0, 0, 0 };
+    uint64_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    uint64_t head_cache = tail;   /* Last head read; only refreshed when the ring looks empty */
+    struct timespec now;
+    
+    while (g_running) {
+        if (head_cache == tail) {
+            int ready = wait_for_data(ring, tail, &head_cache, sockfd, stats);
+            if (ready < 0) break;
+            if (ready == 0) {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                if ((now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9 >= g_duration) break;
+                continue;
+            }
+        }
+        
+        /* Copy the message out, then hand the slot straight back */
+        const char *slot = ring->slots + (size_t)(tail & mask) * r->slot_size;
+        FrameHeader hdr;
+        memcpy(&hdr, slot, sizeof(hdr));
+        uint32_t len = hdr.length <= msg_size ? hdr.length : msg_size;
+        memcpy(buffer, slot + sizeof(hdr), len);
+        
+        __atomic_store_n(&r->tail, ++tail, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        uint64_t wake_at = __atomic_load_n(&r->producer_wake_at, __ATOMIC_RELAXED);
+        if (wake_at && tail >= wake_at &&
+            __atomic_compare_exchange_n(&r->producer_wake_at, &wake_at, 0, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            eventfd_write(ring->space_efd, 1);
+            stats->wakeups_sent++;
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+        if (hdr.seq != tail - 1 || hdr.length != msg_size) stats->seq_errors++;
+        
+        double latency = now_ns > hdr.send_ts_ns ? (now_ns - hdr.send_ts_ns) / 1e3 : 0;
+        stat_add(&stats->bytes_received, len);
+        stat_add(&stats->messages_received, 1);
+        stat_add_double(&stats->latency_sum, latency);
+        stat_add(&stats->latency_count, 1);
+        hist_record(&stats->hist, latency);
+        
+        if (g_verify) {
+            verifier.offset = 0;
+            verify_payload(&verifier, buffer, len, stats);
+        }
+        
+        /* Check duration */
+        double elapsed = (now.tv_sec - start->tv_sec) +
+                        (now.tv_nsec - start->tv_nsec) / 1e9;
+        if (elapsed >= g_duration) {
+            break;
+        }
+    }
+    
+    free(buffer);
+}
+
+/* Live reporter (-i): snapshot every thread's counters each interval and print the delta */
+/* Counters are only read here, so the receive loops stay lock-free */
+void* reporter_thread(void *arg) {
+    (void)arg;
+    struct timespec interval = { g_interval_ms / 1000, (g_interval_ms % 1000) * 1000000L };
+    struct timespec start, last, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    last = start;
+    unsigned long long last_bytes = 0, last_msgs = 0, last_lat_count = 0;
+    double last_lat_sum = 0;
+    
+    while (!g_reporter_done) {
+        nanosleep(&interval, NULL);
+        
+        unsigned long long bytes = 0, msgs = 0, lat_count = 0;
+        double lat_sum = 0;
+        for (int i = 0; i < g_num_threads; i++) {
+            ThreadStats *s = &g_thread_stats[i];
+            bytes += __atomic_load_n(&s->bytes_received, __ATOMIC_RELAXED);
+            msgs += __atomic_load_n(&s->messages_received, __ATOMIC_RELAXED);
+            lat_count += __atomic_load_n(&s->latency_count, __ATOMIC_RELAXED);
+            double sum;
+            __atomic_load(&s->latency_sum, &sum, __ATOMIC_RELAXED);
+            lat_sum += sum;
+        }
+        
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double dt = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9;
+        double t = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+        double avg_latency = lat_count > last_lat_count ?
+            (lat_sum - last_lat_sum) / (lat_count - last_lat_count) : 0;
+        printf("[%7.2fs] %.4f Gbps, %.0f msg/s, avg latency %.2f us\n",
+               t, (bytes - last_bytes) * 8.0 / (dt * 1e9), (msgs - last_msgs) / dt, avg_latency);
+        fflush(stdout);
+        
+        last = now;
+        last_bytes = bytes;
+        last_msgs = msgs;
+        last_lat_count = lat_count;
+        last_lat_sum = lat_sum;
+    }
+    
+    return NULL;
+}
+
+/* Client thread function */
+void* client_thread(void *arg) {
+    int thread_id = *(int*)arg;
+    free(arg);
+    
+    /* Pin before allocating so receive buffers are first touched on the chosen node */
+    place_thread(thread_id);
+    
+    ThreadStats *stats = &g_thread_stats[thread_id];
+    stats->thread_id = thread_id;
+    
+    /* Connect to the control socket */
+    int sockfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sockfd < 0) {
+        perror("socket creation failed");
+        return NULL;
+    }
+    
+    struct sockaddr_un server_addr;
+    socklen_t addr_len = control_address(g_port, &server_addr);
+    if (connect(sockfd, (struct sockaddr*)&server_addr, addr_len) < 0) {
+        perror("Connection failed");
+        close(sockfd);
+        return NULL;
+    }
+    
+    ClientRing ring;
+    if (open_ring(sockfd, &ring, thread_id) < 0) {
+        close(sockfd);
+        return NULL;
+    }
+    
+    printf("[Thread %d] Ring mapped: %u slots of %u bytes\n",
+           thread_id, ring.hdr->slots, ring.hdr->slot_size);
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    consume_ring(&ring, sockfd, stats, &start);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats->elapsed_time = (end.tv_sec - start.tv_sec) +
+                         (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    /* Closing the control socket tells the server to stop once the ring is full */
+    close_ring(&ring);
+    close(sockfd);
+    
+    return NULL;
+}
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-h host] [-p port] [-t threads] [-d duration] [-s msg_size] [-i interval_ms] [-V] [-c cpus] [-P spread|pack] [-N same|cross]\n", prog);
+    fprintf(stderr, "  -h host     : Accepted for the common CLI; the ring is same-host only\n");
+    fprintf(stderr, "  -p port     : Server port, selects its control socket (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -t threads  : Number of client threads, one ring each (default: %d)\n",
+            DEFAULT_THREADS);
+    fprintf(stderr, "  -d duration : Test duration in seconds (default: %d)\n", DEFAULT_DURATION);
+    fprintf(stderr, "  -s msg_size : Server's message size, for the CSV row (default: %d)\n",
+            DEFAULT_MSG_SIZE);
+    fprintf(stderr, "  -i interval : Print throughput/latency every interval ms (default: off)\n");
+    fprintf(stderr, "  -V          : Verify every received payload byte against the servers'\n");
+    fprintf(stderr, "                field pattern (AVX2/SSE2 when available), timed separately\n");
+    fprintf(stderr, "  -c cpus     : Pin client threads round-robin to a CPU list such as 0-3,8\n");
+    fprintf(stderr, "  -P policy   : spread (one per physical core first) or pack (SMT siblings)\n");
+    fprintf(stderr, "  -N node     : same or cross: receive buffers on the thread's NUMA node\n");
+    fprintf(stderr, "                or on the next node\n");
+}
+
+int main(int argc, char *argv[]) {
+    g_num_threads = DEFAULT_THREADS;
+    int opt;
+    const char *cpu_list = NULL;
+    
+    while ((opt = getopt(argc, argv, "h:p:t:d:s:i:Vc:P:N:H")) != -1) {
+        switch (opt) {
+            case 'h':
+                strncpy(g_host, optarg, sizeof(g_host) - 1);
+                break;
+            case 'p':
+                g_port = atoi(optarg);
+                break;
+            case 't':
+                g_num_threads = atoi(optarg);
+                break;
+            case 'd':
+                g_duration = atoi(optarg);
+                break;
+            case 's':
+                g_message_size = atoi(optarg);
+                break;
+            case 'i':
+                g_interval_ms = atoi(optarg);
+                break;
+            case 'V':
+                g_verify = 1;
+                break;
+            case 'c':
+                cpu_list = optarg;
+                break;
+            case 'P':
+                if (strcmp(optarg, "spread") == 0) {
+                    g_place_policy = PLACE_SPREAD;
+                } else if (strcmp(optarg, "pack") == 0) {
+                    g_place_policy = PLACE_PACK;
+                } else {
+                    fprintf(stderr, "Unknown placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'N':
+                if (strcmp(optarg, "same") == 0) {
+                    g_mem_policy = MEM_SAME;
+                } else if (strcmp(optarg, "cross") == 0) {
+                    g_mem_policy = MEM_CROSS;
+                } else {
+                    fprintf(stderr, "Unknown memory placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'H':
+            default:
+                print_usage(argv[0]);
+                return (opt == 'H') ? 0 : 1;
+        }
+    }
+    
+    if (setup_placement(cpu_list) < 0) return 1;
+    if (g_verify) init_verify();
+    if (sysconf(_SC_NPROCESSORS_ONLN) == 1) g_spin = 0;
+    
+    signal(SIGINT, signal_handler);
+    
+    printf("A6 Shared-Memory Ring Client\n");
+    printf("Configuration: host=%s, port=%d, threads=%d, duration=%ds, msg_size=%d\n",
+           g_host, g_port, g_num_threads, g_duration, g_message_size);
+    if (strcmp(g_host, "127.0.0.1") != 0 && strcmp(g_host, "localhost") != 0) {
+        printf("Note: the ring is shared memory, -h %s is ignored\n", g_host);
+    }
+    printf("Consuming a memfd SPSC ring, eventfd wakeups only on an empty ring\n\n");
+    
+    if (g_cpu_count > 0) {
+        printf("Placement: %s over %d CPUs, %d NUMA node(s)\n",
+               g_placement, g_cpu_count, g_node_count);
+    }
+    
+    /* Allocate thread statistics array, one cache-line-aligned slot per thread */
+    g_thread_stats = (ThreadStats*)aligned_alloc(CACHE_LINE, g_num_threads * sizeof(ThreadStats));
+    if (!g_thread_stats) {
+        perror("Failed to allocate thread stats");
+        return 1;
+    }
+    memset(g_thread_stats, 0, g_num_threads * sizeof(ThreadStats));
+    
+    /* Create threads */
+    pthread_t *threads = (pthread_t*)malloc(g_num_threads * sizeof(pthread_t));
+    if (!threads) {
+        perror("Failed to allocate threads array");
+        free(g_thread_stats);
+        return 1;
+    }
+    
+    struct timespec global_start, global_end;
+    clock_gettime(CLOCK_MONOTONIC, &global_start);
+    
+    for (int i = 0; i < g_num_threads; i++) {
+        int *tid = (int*)malloc(sizeof(int));
+        *tid = i;
+        if (pthread_create(&threads[i], NULL, client_thread, tid) != 0) {
+            perror("Failed to create thread");
+            free(tid);
+        }
+    }
+    
+    pthread_t reporter;
+    int reporting = 0;
+    if (g_interval_ms > 0) {
+        printf("\n--- Live Statistics (every %d ms) ---\n", g_interval_ms);
+        reporting = pthread_create(&reporter, NULL, reporter_thread, NULL) == 0;
+    }
+    
+    /* Wait for all threads to complete */
+    for (int i = 0; i < g_num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &global_end);
+    
+    if (reporting) {
+        g_reporter_done = 1;
+        pthread_join(reporter, NULL);
+    }
+    double global_elapsed = (global_end.tv_sec - global_start.tv_sec) +
+                           (global_end.tv_nsec - global_start.tv_nsec) / 1e9;
+    
+    /* Aggregate statistics */
+    unsigned long long total_bytes = 0;
+    unsigned long long total_messages = 0;
+    double total_latency = 0;
+    unsigned long long total_latency_count = 0;
+    LatencyHistogram total_hist;
+    memset(&total_hist, 0, sizeof(total_hist));
+    unsigned long long total_verify_bytes = 0, total_corrupt = 0;
+    double total_verify_ns = 0, total_thread_time = 0, unchecked_gbps = 0;
+    unsigned long long total_seq_errors = 0, total_spins = 0, total_sleeps = 0, total_wakeups = 0;
+    
+    printf("\n--- Per-Thread Statistics ---\n");
+    for (int i = 0; i < g_num_threads; i++) {
+        ThreadStats *s = &g_thread_stats[i];
+        double throughput = (s->bytes_received * 8.0) / (s->elapsed_time * 1e9);
+        double avg_latency = s->latency_count > 0 ? s->latency_sum / s->latency_count : 0;
+        
+        printf("[Thread %d] Received: %.2f MB, Throughput: %.2f Gbps, Avg Latency: %.2f us, p99: %.2f us\n",
+               i, s->bytes_received / 1e6, throughput, avg_latency, hist_percentile(&s->hist, 99.0));
+        printf("[Thread %d] Ring empty: %llu spin waits, %llu sleeps; %llu server wakeups sent\n",
+               i, s->empty_spins, s->empty_sleeps, s->wakeups_sent);
+        
+        total_bytes += s->bytes_received;
+        total_messages += s->messages_received;
+        total_latency += s->latency_sum;
+        total_latency_count += s->latency_count;
+        hist_merge(&total_hist, &s->hist);
+        total_verify_bytes += s->verify_bytes;
+        total_corrupt += s->verify_corrupt;
+        total_verify_ns += s->verify_ns;
+        total_thread_time += s->elapsed_time;
+        if (s->elapsed_time > s->verify_ns / 1e9) {
+            unchecked_gbps += s->bytes_received * 8.0 / ((s->elapsed_time - s->verify_ns / 1e9) * 1e9);
+        }
+        total_seq_errors += s->seq_errors;
+        total_spins += s->empty_spins;
+        total_sleeps += s->empty_sleeps;
+        total_wakeups += s->wakeups_sent;
+    }
+    
+    /* Print aggregate statistics */
+    double total_throughput = (total_bytes * 8.0) / (global_elapsed * 1e9);
+    double avg_latency = total_latency_count > 0 ? total_latency / total_latency_count : 0;
+    double p50 = hist_percentile(&total_hist, 50.0);
+    double p99 = hist_percentile(&total_hist, 99.0);
+    double p999 = hist_percentile(&total_hist, 99.9);
+    double max_latency = total_hist.max_ns / 1e3;
+    
+    printf("\n--- Aggregate Statistics ---\n");
+    printf("Total bytes received: %.2f MB\n", total_bytes / 1e6);
+    printf("Total messages: %llu\n", total_messages);
+    printf("Total throughput: %.4f Gbps\n", total_throughput);
+    printf("Average latency: %.2f us (one-way, from the server's send timestamp)\n", avg_latency);
+    printf("Latency percentiles: p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us\n",
+           p50, p99, p999, max_latency);
+    printf("Elapsed time: %.2f seconds\n", global_elapsed);
+    printf("Ring: %llu messages, %llu out of sequence, %llu empty spin waits, %llu sleeps, "
+           "%llu server wakeups (%.4f syscalls per message)\n",
+           total_messages, total_seq_errors, total_spins, total_sleeps, total_wakeups,
+           total_messages > 0 ? (double)(total_sleeps + total_wakeups) / total_messages : 0);
+    
+    if (g_verify) {
+        /* Checks run inline, so also show the rate with their time taken out */
+        printf("Verification (%s): %.2f MB checked, %llu corrupt messages, %.3f s in checks "
+               "(%.1f%% of receive time, %.2f GB/s), %.4f Gbps excluding checks\n",
+               g_verify_isa, total_verify_bytes / 1e6, total_corrupt, total_verify_ns / 1e9,
+               total_thread_time > 0 ? 100.0 * total_verify_ns / 1e9 / total_thread_time : 0,
+               total_verify_ns > 0 ? total_verify_bytes / total_verify_ns : 0,
+               unchecked_gbps);
+    }
+    
+    /* Output CSV-friendly format */
+    printf("\n--- CSV Output ---\n");
+    printf("implementation,threads,msg_size,throughput_gbps,latency_us,bytes_total,elapsed_s,p50_us,p99_us,p999_us,max_us,placement\n");
+    printf("%s%s,%d,%d,%.4f,%.2f,%llu,%.2f,%.2f,%.2f,%.2f,%.2f,%s\n",
+           "shm_ring", g_verify ? "_verified" : "", g_num_threads, g_message_size, total_throughput, avg_latency,
+           total_bytes, global_elapsed,
+           p50, p99, p999, max_latency, g_placement);
+    
+    free(threads);
+    free(g_thread_stats);
+    
+    return 0;
+}
+
+/* This code was generated with the assistance of Claude Opus 4.5 by Anthropic. */
@@ -0,0 +1,745 @@
+/*
+ * MT25057
+ * PA02: Analysis of Network I/O primitives using "perf" tool
+ * Part A6: Shared-Memory Ring Implementation - Server
+ *
+ * Same-host baseline without a socket on the data path. Each client
+ * connects to a control socket (an abstract AF_UNIX name derived from
+ * the port, so nothing is left on disk) and receives, with SCM_RIGHTS,
+ * a memfd holding a single-producer/single-consumer ring plus two
+ * eventfds. The session thread then writes every message straight into
+ * the next ring slot: a frame header (same layout as -F in A1-A3)
+ * followed by the 8 fields, copied once like A1's serialization.
+ *
+ * The head and tail indices live on their own cache lines and each side
+ * caches the other's index, so in steady state a message costs one copy
+ * and no syscalls. The eventfds are only written when the other side has
+ * gone to sleep on an empty (client) or full (server) ring.
+ *
+ * Author: Aayush Amritesh (MT25057)
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#define DEFAULT_PORT 8086
+#define NUM_FIELDS 8
+#define DEFAULT_MSG_SIZE 1024
+#define CACHE_LINE 64
+#define DEFAULT_SLOTS 256       /* Ring slots, a power of two */
+#define MAX_SLOTS 65536
+#define MAX_RING_BYTES (1UL << 30)
+#define RING_SPIN 1024          /* Index re-reads before sleeping on a full ring */
+#define WAIT_TIMEOUT_MS 100     /* Sleep slice, to notice Ctrl+C and a closed client */
+#define BACKLOG 128
+
+/* Global configuration */
+static int g_message_size = DEFAULT_MSG_SIZE;
+static int g_slots = DEFAULT_SLOTS;
+static int g_spin = RING_SPIN;        /* 0 on a single CPU, where spinning only delays the other side */
+static volatile int g_running = 1;
+
+/* Message structure with 8 dynamically allocated string fields */
+typedef struct {
+    char *fields[NUM_FIELDS];
+    size_t field_sizes[NUM_FIELDS];
+} Message;
+
+/* Frame header: starts every ring slot, same layout as -F in A1-A3 */
+typedef struct {
+    uint32_t length;        /* Payload bytes following the header */
+    uint32_t flags;         /* FRAME_F_* (none used by the ring) */
+    uint64_t seq;           /* Message number in this session, from 0 */
+    uint64_t send_ts_ns;    /* Producer CLOCK_MONOTONIC time when the slot was filled */
+} FrameHeader;
+
+/* Shared ring header, at the start of the memfd and followed by the slots */
+/* Every field a side writes on the data path has a cache line to itself */
+#define RING_MAGIC 0x36474e52   /* "RNG6" */
+typedef struct {
+    uint64_t head __attribute__((aligned(CACHE_LINE)));     /* Messages published (server) */
+    uint64_t tail __attribute__((aligned(CACHE_LINE)));     /* Messages consumed (client) */
+    uint32_t consumer_waiting __attribute__((aligned(CACHE_LINE)));  /* Client asleep on data_efd */
+    uint64_t producer_wake_at __attribute__((aligned(CACHE_LINE)));  /* Server asleep on space_efd */
+                                                            /* until tail reaches this, 0 = awake */
+    uint32_t magic __attribute__((aligned(CACHE_LINE)));    /* Read-only after setup */
+    uint32_t slots;
+    uint32_t slot_size;     /* Frame header + message, rounded up to a cache line */
+    uint32_t msg_size;
+} RingHeader;
+
+/* Control message sent with the memfd, data_efd and space_efd */
+typedef struct {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t ring_bytes;    /* Size of the memfd */
+} RingHello;
+
+/* One session's ring as the server sees it */
+typedef struct {
+    int memfd;
+    int data_efd;           /* Server -> client: slots were published */
+    int space_efd;          /* Client -> server: slots were freed */
+    RingHeader *hdr;
+    char *slots;
+    size_t map_size;
+} SharedRing;
+
+/* Thread argument structure */
+typedef struct {
+    int client_fd;
+    int thread_id;
+} ThreadArg;
+
+/* Statistics structure */
+typedef struct {
+    unsigned long long bytes_sent;
+    unsigned long long messages_sent;
+    unsigned long long wakeups_sent;    /* data_efd writes for a sleeping client */
+    unsigned long long full_spins;      /* Ring found full, waited by re-reading the tail */
+    unsigned long long full_sleeps;     /* Ring stayed full, slept on space_efd */
+    double elapsed_time;
+} Stats;
+
+/* Thread placement (-c / -P / -N) */
+#define PLACE_NONE 0
+#define PLACE_LIST 1        /* CPUs in the order given with -c */
+#define PLACE_SPREAD 2      /* One CPU per physical core before any SMT sibling */
+#define PLACE_PACK 3        /* Fill the SMT siblings of a core before the next core */
+#define MEM_ANY 0
+#define MEM_SAME 1          /* Buffers on the NUMA node of the thread's CPU */
+#define MEM_CROSS 2         /* Buffers on the next NUMA node, across the interconnect */
+#define MAX_NODES 64
+
+static int g_place_policy = PLACE_NONE;
+static int g_mem_policy = MEM_ANY;
+static int g_cpus[CPU_SETSIZE];     /* CPUs in placement order, used round-robin */
+static int g_cpu_count = 0;
+static int g_node_count = 1;
+static char g_placement[64] = "none";
+
+/* Parse a CPU list such as "0-3,8,10-11", returns the number of CPUs or -1 */
+int parse_cpu_list(const char *list, int *cpus, int max) {
+    int count = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) return -1;
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && count < max; c++) {
+            cpus[count++] = (int)c;
+        }
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+        else break;
+    }
+    return count;
+}
+
+/* Lowest-numbered SMT sibling of a CPU, identifying its physical core */
+int core_of_cpu(int cpu) {
+    char path[128], line[256];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (!f) return cpu;
+    int siblings[CPU_SETSIZE];
+    int n = fgets(line, sizeof(line), f) ? parse_cpu_list(line, siblings, CPU_SETSIZE) : -1;
+    fclose(f);
+    return n > 0 ? siblings[0] : cpu;
+}
+
+/* NUMA node a CPU belongs to (0 if the topology is not exported) */
+int node_of_cpu(int cpu) {
+    char path[128];
+    for (int node = 0; node < g_node_count; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) return node;
+    }
+    return 0;
+}
+
+/* Build the CPU order from -c / -P and count NUMA nodes */
+int setup_placement(const char *cpu_list) {
+    char path[64];
+    g_node_count = 0;
+    while (g_node_count < MAX_NODES) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", g_node_count);
+        if (access(path, F_OK) != 0) break;
+        g_node_count++;
+    }
+    if (g_node_count == 0) g_node_count = 1;
+    
+    if (cpu_list) {
+        g_cpu_count = parse_cpu_list(cpu_list, g_cpus, CPU_SETSIZE);
+        if (g_cpu_count <= 0) {
+            fprintf(stderr, "Invalid CPU list: %s\n", cpu_list);
+            return -1;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    } else if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        /* Default to every CPU this process may run on */
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) g_cpus[g_cpu_count++] = c;
+        }
+        if (g_place_policy == PLACE_NONE) g_place_policy = PLACE_LIST;
+    }
+    
+    if (g_place_policy == PLACE_SPREAD || g_place_policy == PLACE_PACK) {
+        /* Sort key: spread = (sibling rank, core), pack = (core, sibling rank) */
+        int core[CPU_SETSIZE], rank[CPU_SETSIZE];
+        for (int i = 0; i < g_cpu_count; i++) {
+            core[i] = core_of_cpu(g_cpus[i]);
+            rank[i] = 0;
+            for (int j = 0; j < i; j++) {
+                if (core[j] == core[i]) rank[i]++;
+            }
+        }
+        for (int i = 1; i < g_cpu_count; i++) {
+            for (int j = i; j > 0; j--) {
+                int a = j - 1, b = j;
+                int swap = g_place_policy == PLACE_SPREAD ?
+                    (rank[a] > rank[b] || (rank[a] == rank[b] && core[a] > core[b])) :
+                    (core[a] > core[b] || (core[a] == core[b] && rank[a] > rank[b]));
+                if (!swap) break;
+                int t;
+                t = g_cpus[a]; g_cpus[a] = g_cpus[b]; g_cpus[b] = t;
+                t = core[a]; core[a] = core[b]; core[b] = t;
+                t = rank[a]; rank[a] = rank[b]; rank[b] = t;
+            }
+        }
+    }
+    
+    if (g_mem_policy == MEM_CROSS && g_node_count < 2) {
+        fprintf(stderr, "Warning: only one NUMA node, -N cross places memory on the same node\n");
+    }
+    
+    static const char *place_names[] = { "none", "list", "spread", "pack" };
+    static const char *mem_names[] = { "any", "same", "cross" };
+    if (g_place_policy != PLACE_NONE || g_mem_policy != MEM_ANY) {
+        snprintf(g_placement, sizeof(g_placement), "%s-%s",
+                 place_names[g_place_policy], mem_names[g_mem_policy]);
+    }
+    return 0;
+}
+
+/* CPU for the index-th thread, or -1 when placement is off */
+int placement_cpu(int index) {
+    return g_cpu_count > 0 ? g_cpus[index % g_cpu_count] : -1;
+}
+
+/* Prefer the -N node of a CPU for this thread's future page faults (-1 resets) */
+void bind_memory(int cpu) {
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+    memset(mask, 0, sizeof(mask));
+    
+    if (cpu < 0 || g_mem_policy == MEM_ANY) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+        return;
+    }
+    
+    int node = node_of_cpu(cpu);
+    if (g_mem_policy == MEM_CROSS) node = (node + 1) % g_node_count;
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    
+    /* MPOL_PREFERRED rather than BIND so a full node degrades instead of failing */
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0) {
+        perror("set_mempolicy failed");
+    }
+}
+
+/* Pin the calling thread to its CPU and place its allocations (first touch) */
+void place_thread(int index) {
+    int cpu = placement_cpu(index);
+    if (cpu < 0) return;
+    
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        fprintf(stderr, "Failed to pin thread %d to CPU %d\n", index, cpu);
+    }
+    bind_memory(cpu);
+}
+
+/* Signal handler for graceful shutdown */
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+/* Allocate and initialize message structure */
+Message* create_message(size_t total_size) {
+    Message *msg = (Message*)malloc(sizeof(Message));
+    if (!msg) {
+        perror("Failed to allocate message structure");
+        return NULL;
+    }
+    
+    /* Distribute size among 8 fields */
+    size_t field_size = total_size / NUM_FIELDS;
+    size_t remainder = total_size % NUM_FIELDS;
+    
+    for (int i = 0; i < NUM_FIELDS; i++) {
+        size_t size = field_size + (i < (int)remainder ? 1 : 0);
+        msg->field_sizes[i] = size;
+        msg->fields[i] = (char*)malloc(size);
+        if (!msg->fields[i]) {
+            perror("Failed to allocate message field");
+            for (int j = 0; j < i; j++) {
+                free(msg->fields[j]);
+            }
+            free(msg);
+            return NULL;
+        }
+        /* Initialize with pattern data */
+        memset(msg->fields[i], 'A' + i, size);
+    }
+    
+    return msg;
+}
+
+/* Free message structure */
+void destroy_message(Message *msg) {
+    if (msg) {
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            free(msg->fields[i]);
+        }
+        free(msg);
+    }
+}
+
+/* Fill in the frame header of a session's next message */
+void frame_stamp(FrameHeader *hdr, uint32_t length, uint64_t seq, uint32_t flags) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    hdr->length = length;
+    hdr->flags = flags;
+    hdr->seq = seq;
+    hdr->send_ts_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+
+/* Spin-wait hint between index re-reads */
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/* Slot size for a message: frame header + payload, a whole number of cache lines */
+size_t ring_slot_size(size_t msg_size) {
+    return (sizeof(FrameHeader) + msg_size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+}
+
+/* Abstract AF_UNIX name of the control socket for a port; returns the address length */
+socklen_t control_address(int port, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    int n = snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "mt25057_a6_%d", port);
+    return offsetof(struct sockaddr_un, sun_path) + 1 + n;
+}
+
+/* Free a session's ring */
+void destroy_ring(SharedRing *ring) {
+    if (ring->hdr) munmap(ring->hdr, ring->map_size);
+    if (ring->memfd >= 0) close(ring->memfd);
+    if (ring->data_efd >= 0) close(ring->data_efd);
+    if (ring->space_efd >= 0) close(ring->space_efd);
+}
+
+/* Create a session's ring in a sealed memfd, plus its two eventfds */
+/* Returns 0, or -1 with everything released */
+int create_ring(SharedRing *ring) {
+    size_t slot_size = ring_slot_size(g_message_size);
+    ring->map_size = sizeof(RingHeader) + (size_t)g_slots * slot_size;
+    ring->hdr = NULL;
+    ring->memfd = memfd_create("mt25057_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    ring->data_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ring->space_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ring->memfd < 0 || ring->data_efd < 0 || ring->space_efd < 0) {
+        perror("memfd_create/eventfd failed");
+        destroy_ring(ring);
+        return -1;
+    }
+    
+    /* The client maps the whole size: keep it from changing under either side */
+    if (ftruncate(ring->memfd, ring->map_size) < 0 ||
+        fcntl(ring->memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        perror("memfd setup failed");
+        destroy_ring(ring);
+        return -1;
+    }
+    
+    /* MAP_POPULATE: fault the ring in here, on this thread's node, not on the first lap */
+    void *map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring->memfd, 0);
+    if (map == MAP_FAILED) {
+        perror("ring mmap failed");
+        destroy_ring(ring);
+        return -1;
+    }
+    ring->hdr = (RingHeader*)map;
+    ring->slots = (char*)map + sizeof(RingHeader);
+    
+    ring->hdr->slots = g_slots;
+    ring->hdr->slot_size = slot_size;
+    ring->hdr->msg_size = g_message_size;
+    __atomic_store_n(&ring->hdr->magic, RING_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Hand the ring to the client: a RingHello carrying memfd, data_efd and space_efd */
+int send_ring(int client_fd, const SharedRing *ring) {
+    RingHello hello = { RING_MAGIC, 0, ring->map_size };
+    int fds[3] = { ring->memfd, ring->data_efd, ring->space_efd };
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+    
+    if (sendmsg(client_fd, &mh, MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) {
+        perror("sending ring to client failed");
+        return -1;
+    }
+    return 0;
+}
+
+/* The ring is full: spin on the client's tail, then sleep on space_efd until */
+/* half of the ring is free, so a slow client wakes the server once per half lap */
+/* Returns 1 once there is space, 0 if the client went away or Ctrl+C */
+int wait_for_space(SharedRing *ring, uint64_t head, uint64_t *tail_cache,
+                   int client_fd, Stats *stats) {
+    RingHeader *r = ring->hdr;
+    for (int i = 0; i < g_spin; i++) {
+        cpu_relax();
+        *tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (head - *tail_cache < r->slots) {
+            stats->full_spins++;
+            return 1;
+        }
+    }
+    
+    stats->full_sleeps++;
+    uint64_t wake_at = head - r->slots / 2;
+    while (g_running) {
+        /* Announce the sleep, then look again: the client checks the mark after */
+        /* every release, so either it sees the mark or this sees its new tail */
+        __atomic_store_n(&r->producer_wake_at, wake_at, __ATOMIC_SEQ_CST);
+        *tail_cache = __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST);
+        if (*tail_cache >= wake_at) break;
+        
+        /* The client never writes to the control socket: readable means it closed */
+        struct pollfd pfd[2] = {
+            { ring->space_efd, POLLIN, 0 },
+            { client_fd, POLLIN, 0 },
+        };
+        int n = poll(pfd, 2, WAIT_TIMEOUT_MS);
+        if (n > 0 && pfd[1].revents) break;
+        if (n > 0 && (pfd[0].revents & POLLIN)) {
+            eventfd_t value;
+            eventfd_read(ring->space_efd, &value);
+        }
+        *tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (*tail_cache >= wake_at) break;
+    }
+    __atomic_store_n(&r->producer_wake_at, 0, __ATOMIC_RELAXED);
+    return g_running && head - *tail_cache < r->slots;
+}
+
+/* Session handler: fill ring slots until the client goes away */
+void* ring_handler(void *arg) {
+    ThreadArg *targ = (ThreadArg*)arg;
+    int client_fd = targ->client_fd;
+    int thread_id = targ->thread_id;
+    
+    /* Pin before allocating so the message and the ring are first touched on the chosen node */
+    place_thread(thread_id);
+    
+    printf("[Thread %d] Client connected\n", thread_id);
+    
+    Message *msg = create_message(g_message_size);
+    if (!msg) {
+        close(client_fd);
+        free(targ);
+        return NULL;
+    }
+    
+    SharedRing ring;
+    if (create_ring(&ring) < 0) {
+        destroy_message(msg);
+        close(client_fd);
+        free(targ);
+        return NULL;
+    }
+    if (send_ring(client_fd, &ring) < 0) {
+        destroy_ring(&ring);
+        destroy_message(msg);
+        close(client_fd);
+        free(targ);
+        return NULL;
+    }
+    
+    RingHeader *r = ring.hdr;
+    uint32_t mask = r->slots - 1;
+    uint64_t head = 0;
+    uint64_t tail_cache = 0;    /* Last tail read; only refreshed when the ring looks full */
+    
+    Stats stats;
+    memset(&stats, 0, sizeof(stats));
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    while (g_running) {
+        if (head - tail_cache == r->slots &&
+            !wait_for_space(&ring, head, &tail_cache, client_fd, &stats)) {
+            break;
+        }
+        
+        /* Serialize the fields into the slot: the only copy on the data path */
+        char *slot = ring.slots + (size_t)(head & mask) * r->slot_size;
+        frame_stamp((FrameHeader*)slot, g_message_size, head, 0);
+        char *p = slot + sizeof(FrameHeader);
+        for (int i = 0; i < NUM_FIELDS; i++) {
+            memcpy(p, msg->fields[i], msg->field_sizes[i]);
+            p += msg->field_sizes[i];
+        }
+        
+        /* Publish, then wake the client only if it went to sleep on an empty ring */
+        __atomic_store_n(&r->head, ++head, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&r->consumer_waiting, __ATOMIC_RELAXED) &&
+            __atomic_exchange_n(&r->consumer_waiting, 0, __ATOMIC_RELAXED)) {
+            eventfd_write(ring.data_efd, 1);
+            stats.wakeups_sent++;
+        }
+        
+        stats.bytes_sent += g_message_size;
+        stats.messages_sent++;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stats.elapsed_time = (end.tv_sec - start.tv_sec) +
+                         (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    /* Print statistics */
+    double throughput_gbps = (stats.bytes_sent * 8.0) / (stats.elapsed_time * 1e9);
+    printf("[Thread %d] Stats: %.2f GB sent, %.2f Gbps, %llu messages in %.2f seconds\n",
+           thread_id,
+           stats.bytes_sent / 1e9,
+           throughput_gbps,
+           stats.messages_sent,
+           stats.elapsed_time);
+    printf("[Thread %d] Ring full: %llu spin waits, %llu sleeps; %llu client wakeups sent\n",
+           thread_id, stats.full_spins, stats.full_sleeps, stats.wakeups_sent);
+    
+    /* Cleanup */
+    destroy_ring(&ring);
+    destroy_message(msg);
+    close(client_fd);
+    free(targ);
+    
+    return NULL;
+}
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-p port] [-s message_size] [-k slots] [-c cpus] [-P spread|pack] [-N same|cross]\n", prog);
+    fprintf(stderr, "  -p port         : Selects the control socket, abstract AF_UNIX name\n");
+    fprintf(stderr, "                    mt25057_a6_<port> (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -s message_size : Message size in bytes (default: %d)\n", DEFAULT_MSG_SIZE);
+    fprintf(stderr, "  -k slots        : Ring slots per client, a power of two (default: %d)\n",
+            DEFAULT_SLOTS);
+    fprintf(stderr, "  -c cpus         : Pin session threads round-robin to a CPU list\n");
+    fprintf(stderr, "                    such as 0-3,8 (default: unpinned)\n");
+    fprintf(stderr, "  -P policy       : spread (one per physical core first) or pack (SMT siblings)\n");
+    fprintf(stderr, "  -N node         : same or cross: message and ring on the thread's NUMA node\n");
+    fprintf(stderr, "                    or on the next node\n");
+}
+
+int main(int argc, char *argv[]) {
+    int port = DEFAULT_PORT;
+    int opt;
+    const char *cpu_list = NULL;
+    
+    while ((opt = getopt(argc, argv, "p:s:k:c:P:N:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+            case 's':
+                g_message_size = atoi(optarg);
+                break;
+            case 'k':
+                g_slots = atoi(optarg);
+                break;
+            case 'c':
+                cpu_list = optarg;
+                break;
+            case 'P':
+                if (strcmp(optarg, "spread") == 0) {
+                    g_place_policy = PLACE_SPREAD;
+                } else if (strcmp(optarg, "pack") == 0) {
+                    g_place_policy = PLACE_PACK;
+                } else {
+                    fprintf(stderr, "Unknown placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'N':
+                if (strcmp(optarg, "same") == 0) {
+                    g_mem_policy = MEM_SAME;
+                } else if (strcmp(optarg, "cross") == 0) {
+                    g_mem_policy = MEM_CROSS;
+                } else {
+                    fprintf(stderr, "Unknown memory placement: %s\n", optarg);
+                    print_usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'h':
+            default:
+                print_usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    
+    if (setup_placement(cpu_list) < 0) return 1;
+    if (sysconf(_SC_NPROCESSORS_ONLN) == 1) g_spin = 0;
+    
+    if (g_slots < 2 || g_slots > MAX_SLOTS || (g_slots & (g_slots - 1)) != 0) {
+        fprintf(stderr, "-k must be a power of two between 2 and %d\n", MAX_SLOTS);
+        return 1;
+    }
+    
+    if (g_message_size < NUM_FIELDS ||
+        (size_t)g_slots * ring_slot_size(g_message_size) > MAX_RING_BYTES) {
+        fprintf(stderr, "-s must be at least %d bytes, and -k slots of it fit in %lu MB\n",
+                NUM_FIELDS, MAX_RING_BYTES >> 20);
+        return 1;
+    }
+    
+    /* Set up signal handlers */
+    signal(SIGINT, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+    
+    /* Clients connect here only to be handed their ring */
+    int server_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (server_fd < 0) {
+        perror("socket creation failed");
+        return 1;
+    }
+    
+    /* Wake up periodically so Ctrl+C is noticed between connections */
+    struct timeval tv = { 1, 0 };
+    setsockopt(server_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    
+    struct sockaddr_un server_addr;
+    socklen_t addr_len = control_address(port, &server_addr);
+    if (bind(server_fd, (struct sockaddr*)&server_addr, addr_len) < 0) {
+        perror("bind failed");
+        close(server_fd);
+        return 1;
+    }
+    
+    if (listen(server_fd, BACKLOG) < 0) {
+        perror("listen failed");
+        close(server_fd);
+        return 1;
+    }
+    
+    printf("A6 Shared-Memory Ring Server started on port %d (message size: %d bytes)\n",
+           port, g_message_size);
+    printf("Control socket: abstract AF_UNIX @%s\n", server_addr.sun_path + 1);
+    printf("Using a memfd SPSC ring per client: %d slots of %zu bytes (%zu KB), eventfd wakeups\n",
+           g_slots, ring_slot_size(g_message_size),
+           (sizeof(RingHeader) + (size_t)g_slots * ring_slot_size(g_message_size)) / 1024);
+    if (g_cpu_count > 0) {
+        printf("Placement: %s over %d CPUs, %d NUMA node(s)\n",
+               g_placement, g_cpu_count, g_node_count);
+    }
+    printf("Press Ctrl+C to stop\n\n");
+    
+    int thread_id = 0;
+    
+    /* Accept connections and spawn a session thread for each */
+    while (g_running) {
+        int client_fd = accept4(server_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            perror("accept failed");
+            continue;
+        }
+        
+        /* Create thread argument */
+        ThreadArg *targ = (ThreadArg*)malloc(sizeof(ThreadArg));
+        if (!targ) {
+            perror("Failed to allocate thread argument");
+            close(client_fd);
+            continue;
+        }
+        
+        targ->client_fd = client_fd;
+        targ->thread_id = thread_id++;
+        
+        /* Spawn session handler thread */
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        
+        if (pthread_create(&thread, &attr, ring_handler, targ) != 0) {
+            perror("Failed to create thread");
+            close(client_fd);
+            free(targ);
+        }
+        
+        pthread_attr_destroy(&attr);
+    }
+    
+    printf("\nServer shutting down...\n");
+    close(server_fd);
+    
+    return 0;
+}
+
+/* This code was generated with the assistance of Claude Opus 4.5 by Anthropic. */
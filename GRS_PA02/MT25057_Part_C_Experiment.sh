@@ -28,10 +28,15 @@ DURATION=5  # seconds per experiment
 PORT_A1=8081
 PORT_A2=8082
 PORT_A3=8083
+PORT_A4=8084
+PORT_A5=8085  # UDP
+PORT_A6=8086  # Selects A6's control socket, an abstract AF_UNIX name
 
 # Output CSV files
 CSV_MAIN="MT25057_Part_B_Results.csv"
 CSV_PERF="MT25057_Part_B_Perf.csv"
+CSV_RATE="MT25057_Part_B_Rate.csv"   # Open-loop rate sweep (Step 3f)
+CSV_UDP="MT25057_Part_B_UDP.csv"     # A5 datagram loss (Step 3h)
 
 # Colors for output
 RED='\033[0;31m'
@@ -55,19 +60,34 @@ log_error() {
 cleanup() {
     log_info "Cleaning up..."
     # Kill any remaining server processes
-    pkill -f "MT25057_Part_A[123]_Server" 2>/dev/null || true
+    pkill -f "MT25057_Part_A[1-6]_Server" 2>/dev/null || true
     wait 2>/dev/null || true
 }
 
 trap cleanup EXIT
 
+# A6 listens on the abstract AF_UNIX name @mt25057_a6_<port>, A5 on UDP,
+# the others on TCP
+server_listening() {
+    local port=$1
+    local impl_num=$2
+    if [ "$impl_num" = "A6" ]; then
+        grep -q "@mt25057_a6_${port}\$" /proc/net/unix
+    elif [ "$impl_num" = "A5" ]; then
+        grep -q ":$(printf '%04X' $port) " /proc/net/udp
+    else
+        nc -z localhost $port 2>/dev/null
+    fi
+}
+
 # Function to wait for server to be ready
 wait_for_server() {
     local port=$1
+    local impl_num=${2:-}
     local max_attempts=30
     local attempt=0
     
-    while ! nc -z localhost $port 2>/dev/null; do
+    while ! server_listening $port "$impl_num"; do
         attempt=$((attempt + 1))
         if [ $attempt -ge $max_attempts ]; then
             log_error "Server on port $port did not start in time"
@@ -81,22 +101,26 @@ wait_for_server() {
 # Function to run a single experiment
 run_experiment() {
     local impl=$1       # Implementation name (two_copy, one_copy, zero_copy)
-    local impl_num=$2   # A1, A2, A3
+    local impl_num=$2   # A1, A2, A3, A4
     local port=$3
     local msg_size=$4
     local threads=$5
+    local server_args=${6:-}            # Extra server options
+    local client_args=${7:-}            # Extra client options
+    local client_num=${8:-$impl_num}    # Client binary, if different from server
+    local offered_rate=${9:-}           # Open-loop -R rate, also logged to CSV_RATE
     
     local server_bin="./MT25057_Part_${impl_num}_Server"
-    local client_bin="./MT25057_Part_${impl_num}_Client"
+    local client_bin="./MT25057_Part_${client_num}_Client"
     
     log_info "Running: $impl, msg_size=$msg_size, threads=$threads"
     
     # Start server in background
-    $server_bin -p $port -s $msg_size > /dev/null 2>&1 &
+    $server_bin -p $port -s $msg_size $server_args > /dev/null 2>&1 &
     local server_pid=$!
     
     # Wait for server to be ready
-    if ! wait_for_server $port; then
+    if ! wait_for_server $port $impl_num; then
         kill $server_pid 2>/dev/null || true
         return 1
     fi
@@ -108,7 +132,7 @@ run_experiment() {
     # Run client with perf stat
     perf stat -e cycles,instructions,cache-references,cache-misses,L1-dcache-loads,L1-dcache-load-misses,LLC-loads,LLC-load-misses,context-switches \
         -o "$perf_output" \
-        $client_bin -h 127.0.0.1 -p $port -t $threads -d $DURATION -s $msg_size > "$client_output" 2>&1 || true
+        $client_bin -h 127.0.0.1 -p $port -t $threads -d $DURATION -s $msg_size $client_args > "$client_output" 2>&1 || true
     
     # Stop server
     kill $server_pid 2>/dev/null || true
@@ -119,12 +143,28 @@ run_experiment() {
     local latency=$(grep "^${impl}," "$client_output" | tail -1 | cut -d',' -f5)
     local bytes_total=$(grep "^${impl}," "$client_output" | tail -1 | cut -d',' -f6)
     local elapsed=$(grep "^${impl}," "$client_output" | tail -1 | cut -d',' -f7)
+    local percentiles=$(grep "^${impl}," "$client_output" | tail -1 | cut -d',' -f8-11)
+    local placement=$(grep "^${impl}," "$client_output" | tail -1 | cut -d',' -f12)
+    local achieved_rate=$(grep "^Open loop: offered" "$client_output" | tail -1 | sed 's/.*achieved \([0-9]*\) .*/\1/')
+    local datagrams=$(grep "^Datagrams:" "$client_output" | tail -1)
     
     # Default values if parsing fails
     throughput=${throughput:-0}
     latency=${latency:-0}
     bytes_total=${bytes_total:-0}
     elapsed=${elapsed:-0}
+    percentiles=${percentiles:-0,0,0,0}
+    placement=${placement:-none}
+    achieved_rate=${achieved_rate:-0}
+    
+    # A5 only: "Datagrams: N received, M lost (P%), R reordered, ..."
+    local received=0 lost=0 loss_pct=0 reordered=0
+    if [ -n "$datagrams" ]; then
+        received=$(echo "$datagrams" | sed 's/^Datagrams: \([0-9]*\) received.*/\1/')
+        lost=$(echo "$datagrams" | sed 's/.* \([0-9]*\) lost.*/\1/')
+        loss_pct=$(echo "$datagrams" | sed 's/.* lost (\([0-9.]*\)%).*/\1/')
+        reordered=$(echo "$datagrams" | sed 's/.* \([0-9]*\) reordered.*/\1/')
+    fi
     
     # Parse perf output
     local cycles=$(grep "cycles" "$perf_output" | head -1 | awk '{gsub(/,/,"",$1); print $1}')
@@ -155,11 +195,21 @@ run_experiment() {
     fi
     
     # Append to main CSV
-    echo "$impl,$threads,$msg_size,$throughput,$latency,$bytes_total,$elapsed" >> "$CSV_MAIN"
+    echo "$impl,$threads,$msg_size,$throughput,$latency,$bytes_total,$elapsed,$percentiles,$placement" >> "$CSV_MAIN"
     
     # Append to perf CSV
     echo "$impl,$threads,$msg_size,$cycles,$instructions,$cache_refs,$cache_misses,$l1_loads,$l1_misses,$llc_loads,$llc_misses,$ctx_switches,$cycles_per_byte" >> "$CSV_PERF"
     
+    # Append to rate CSV: one point of the latency-vs-throughput curve
+    if [ -n "$offered_rate" ]; then
+        echo "$impl,$threads,$msg_size,$offered_rate,$achieved_rate,$latency,$percentiles" >> "$CSV_RATE"
+    fi
+    
+    # Append to UDP CSV: throughput alone hides what the receiver dropped
+    if [ -n "$datagrams" ]; then
+        echo "$impl,$threads,$msg_size,$throughput,$received,$lost,$loss_pct,$reordered" >> "$CSV_UDP"
+    fi
+    
     # Clean up temp files
     rm -f "$client_output" "$perf_output"
     
@@ -211,8 +261,10 @@ log_info "Compilation successful!"
 # Step 2: Initialize CSV files
 log_info "Step 2: Initializing CSV files..."
 
-echo "implementation,threads,msg_size,throughput_gbps,latency_us,bytes_total,elapsed_s" > "$CSV_MAIN"
+echo "implementation,threads,msg_size,throughput_gbps,latency_us,bytes_total,elapsed_s,p50_us,p99_us,p999_us,max_us,placement" > "$CSV_MAIN"
 echo "implementation,threads,msg_size,cycles,instructions,cache_refs,cache_misses,l1_loads,l1_misses,llc_loads,llc_misses,ctx_switches,cycles_per_byte" > "$CSV_PERF"
+echo "implementation,threads,msg_size,offered_rps,achieved_rps,latency_us,p50_us,p99_us,p999_us,max_us" > "$CSV_RATE"
+echo "implementation,threads,msg_size,throughput_gbps,received,lost,loss_pct,reordered" > "$CSV_UDP"
 
 # Step 3: Run experiments
 log_info "Step 3: Running experiments..."
@@ -220,7 +272,7 @@ log_info "Message sizes: ${MESSAGE_SIZES[*]}"
 log_info "Thread counts: ${THREAD_COUNTS[*]}"
 log_info "Duration per test: ${DURATION}s"
 
-total_experiments=$(( ${#MESSAGE_SIZES[@]} * ${#THREAD_COUNTS[@]} * 3 ))
+total_experiments=$(( ${#MESSAGE_SIZES[@]} * ${#THREAD_COUNTS[@]} * 5 ))
 current_experiment=0
 
 for msg_size in "${MESSAGE_SIZES[@]}"; do
@@ -239,6 +291,116 @@ for msg_size in "${MESSAGE_SIZES[@]}"; do
         current_experiment=$((current_experiment + 1))
         log_info "Progress: $current_experiment / $total_experiments"
         run_experiment "zero_copy" "A3" $PORT_A3 $msg_size $threads || true
+        
+        # A4: io_uring (both send engines)
+        current_experiment=$((current_experiment + 1))
+        log_info "Progress: $current_experiment / $total_experiments"
+        run_experiment "uring_sendmsg" "A4" $PORT_A4 $msg_size $threads "-m sendmsg" "-m sendmsg" || true
+        
+        current_experiment=$((current_experiment + 1))
+        log_info "Progress: $current_experiment / $total_experiments"
+        run_experiment "uring_zc" "A4" $PORT_A4 $msg_size $threads "-m zc" "-m zc" || true
+    done
+done
+
+# Step 3b: Receive-side batching for small messages
+# The A4 client's io_uring multishot receive (-M) against the A1-A3 servers
+MSHOT_SIZES=(256 1024)
+log_info "Step 3b: io_uring multishot receive for ${MSHOT_SIZES[*]} byte messages..."
+
+for msg_size in "${MSHOT_SIZES[@]}"; do
+    for threads in "${THREAD_COUNTS[@]}"; do
+        run_experiment "two_copy_mshot" "A1" $PORT_A1 $msg_size $threads "" "-M -m two_copy" "A4" || true
+        run_experiment "one_copy_mshot" "A2" $PORT_A2 $msg_size $threads "" "-M -m one_copy" "A4" || true
+        run_experiment "zero_copy_mshot" "A3" $PORT_A3 $msg_size $threads "" "-M -m zero_copy" "A4" || true
+    done
+done
+
+# Step 3c: Request/response round trips
+# The client sends a timestamped request and waits for the echoed response
+log_info "Step 3c: Request/response round-trip mode..."
+
+for msg_size in "${MESSAGE_SIZES[@]}"; do
+    for threads in "${THREAD_COUNTS[@]}"; do
+        run_experiment "two_copy_rr" "A1" $PORT_A1 $msg_size $threads "-r" "-r" || true
+        run_experiment "one_copy_rr" "A2" $PORT_A2 $msg_size $threads "-r" "-r" || true
+        run_experiment "zero_copy_rr" "A3" $PORT_A3 $msg_size $threads "-r" "-r" || true
+    done
+done
+
+# Step 3d: Thread placement
+# Server and client threads pinned one per physical core, with message buffers
+# on the local NUMA node versus the next node (recorded in the placement column)
+PLACEMENT_SIZES=(4096 65536)
+PLACEMENTS=("-P spread -N same" "-P spread -N cross")
+log_info "Step 3d: CPU/NUMA placement for ${PLACEMENT_SIZES[*]} byte messages..."
+
+for placement in "${PLACEMENTS[@]}"; do
+    for msg_size in "${PLACEMENT_SIZES[@]}"; do
+        for threads in "${THREAD_COUNTS[@]}"; do
+            run_experiment "two_copy" "A1" $PORT_A1 $msg_size $threads "$placement" "$placement" || true
+            run_experiment "one_copy" "A2" $PORT_A2 $msg_size $threads "$placement" "$placement" || true
+            run_experiment "zero_copy" "A3" $PORT_A3 $msg_size $threads "$placement" "$placement" || true
+        done
+    done
+done
+
+# Step 3e: Shared-memory ring baseline
+# Same host, no socket on the data path: the upper bound for A1-A4
+log_info "Step 3e: Shared-memory SPSC ring (A6) baseline..."
+
+for msg_size in "${MESSAGE_SIZES[@]}"; do
+    for threads in "${THREAD_COUNTS[@]}"; do
+        run_experiment "shm_ring" "A6" $PORT_A6 $msg_size $threads || true
+    done
+done
+
+# Step 3f: Open-loop rate sweep
+# Requests leave on a Poisson schedule at a fixed offered rate, whether or not
+# responses came back, and latency counts from the scheduled send time. Each
+# rate is one point of a latency-vs-throughput curve; past saturation the
+# achieved rate flattens and the percentiles climb
+RATE_SIZE=4096
+RATE_THREADS=4
+OFFERED_RATES=(5000 10000 20000 50000 100000 200000 400000)   # requests/s, all threads
+log_info "Step 3f: Open-loop rate sweep at ${OFFERED_RATES[*]} requests/s..."
+
+for rate in "${OFFERED_RATES[@]}"; do
+    run_experiment "two_copy_rr_poisson" "A1" $PORT_A1 $RATE_SIZE $RATE_THREADS "-r" "-r -R $rate:poisson" "A1" $rate || true
+    run_experiment "one_copy_rr_poisson" "A2" $PORT_A2 $RATE_SIZE $RATE_THREADS "-r" "-r -R $rate:poisson" "A2" $rate || true
+    run_experiment "zero_copy_rr_poisson" "A3" $PORT_A3 $RATE_SIZE $RATE_THREADS "-r" "-r -R $rate:poisson" "A3" $rate || true
+done
+
+# Step 3g: Connection scaling
+# Event-loop servers against the event-driven client: each of CONN_THREADS
+# client threads drives total/CONN_THREADS non-blocking connections with epoll
+# (CSV label suffix _c<total>). Both sides raise their open file limit to the
+# hard limit, which must cover the largest count
+CONN_SIZE=1024
+CONN_THREADS=4
+CONN_COUNTS=(1000 5000 10000 50000)
+log_info "Step 3g: Connection scaling at ${CONN_COUNTS[*]} connections..."
+
+for conns in "${CONN_COUNTS[@]}"; do
+    per_thread=$((conns / CONN_THREADS))
+    run_experiment "two_copy_c$conns" "A1" $PORT_A1 $CONN_SIZE $CONN_THREADS "-e $CONN_THREADS" "-e $per_thread" || true
+    run_experiment "one_copy_c$conns" "A2" $PORT_A2 $CONN_SIZE $CONN_THREADS "-e $CONN_THREADS" "-e $per_thread" || true
+    run_experiment "zero_copy_c$conns" "A3" $PORT_A3 $CONN_SIZE $CONN_THREADS "-e $CONN_THREADS" "-e $per_thread" || true
+done
+
+# Step 3h: UDP (A5)
+# sendmmsg() batches, then with UDP_SEGMENT/UDP_GRO, then with MSG_ZEROCOPY.
+# The client's label names the offloads (udp, udp_gso_gro, udp_zc); UDP has
+# no flow control, so received/lost datagrams go to CSV_UDP next to throughput.
+# A datagram carries at most 65483 message bytes, so the largest size is smaller
+UDP_SIZES=(256 1024 4096 16384 32768)
+log_info "Step 3h: UDP sendmmsg (A5): plain, GSO/GRO and MSG_ZEROCOPY..."
+
+for msg_size in "${UDP_SIZES[@]}"; do
+    for threads in "${THREAD_COUNTS[@]}"; do
+        run_experiment "udp" "A5" $PORT_A5 $msg_size $threads || true
+        run_experiment "udp_gso_gro" "A5" $PORT_A5 $msg_size $threads "-G" "-G" || true
+        run_experiment "udp_zc" "A5" $PORT_A5 $msg_size $threads "-z" || true
     done
 done
 
@@ -248,6 +410,8 @@ log_info "Experiment completed!"
 log_info "Results saved to:"
 log_info "  - $CSV_MAIN"
 log_info "  - $CSV_PERF"
+log_info "  - $CSV_RATE"
+log_info "  - $CSV_UDP"
 log_info "================================================"
 
 # Display summary statistics
@@ -259,6 +423,12 @@ echo ""
 echo "=== Perf Results (first 10 rows) ==="
 head -11 "$CSV_PERF"
 echo ""
+echo "=== Open-Loop Rate Sweep ==="
+cat "$CSV_RATE"
+echo ""
+echo "=== UDP Datagram Loss ==="
+cat "$CSV_UDP"
+echo ""
 
 log_info "Done!"
 